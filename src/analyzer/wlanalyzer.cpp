@@ -26,31 +26,79 @@
 #include <string>
 #include <string.h>
 #include "../wlanalyzer_base/common.h"
+#include "../wlanalyzer_base/decoder.h"
 #include "../wlanalyzer_base/parser.h"
+#include "../wlanalyzer_base/shm.h"
+#include "../wlanalyzer_base/stats.h"
 
 using namespace std;
 
 struct options_t
 {
-    options_t() : coreProtocol(""), analyze(false) {}
+    options_t() : coreProtocol(""), analyze(false), threads(0), start(0), time_range(false),
+        has_to(false)
+    {
+        from.tv_sec = from.tv_usec = 0;
+        to.tv_sec = to.tv_usec = 0;
+    }
 
     string coreProtocol;
     vector<string> extensions;
     bool analyze;
     string address;
+    string capture; // decode this file instead
+    unsigned int threads;
+    uint32_t start;
+    bool time_range; // decode only from..to, with the index
+    bool has_to;
+    timeval from;
+    timeval to;
+    string filter;
+    string json_stats;       // write the statistics here
+    string prometheus_stats; // and here, in the Prometheus text format
+};
+
+struct stats_output_t
+{
+    WldStats *stats;
+    const options_t *options;
 };
 
 static void usage()
 {
     fprintf(stderr, "wlanalyzer is a wayland protocol analyzer\n"
-            "Usage:\twlanalyzer [OPTIONS] -- <ip address>\n\n"
+            "Usage:\twlanalyzer [OPTIONS] -- <ip address:port | shm:socket path>\n"
+            "\twlanalyzer [OPTIONS] -f <dump file>\n\n"
             "Options:\n"
-            "\t-c <file_path> - set the core protocol specification file\n"
+            "\t-c <file_path> - set the core protocol specification file, or the name of a built in one\n"
             "\t-e <file_paths> - provide extensions of the protocol file. "
             "Use only with -c option\n"
+            "\t-f <file_path> - decode a dump file on all cores\n"
+            "\t-j <threads> - decode on that many threads instead. Use only with -f option\n"
+            "\t-s <seq> - start decoding at that record. Use only with -f option\n"
+            "\t-t [<from>][,<to>] - only decode the records taken in that time range, in seconds "
+            "since the epoch. Use only with -f option on a record dump file\n"
+            "\t-a <interface>[.<message>][:<argument><op><value>] - only show the matching messages, "
+            "op is one of = != < >\n"
+            "\t-S <file_path> - write message statistics as JSON, when done decoding or on SIGUSR1\n"
+            "\t-P <file_path> - write them in the Prometheus text format\n"
             "\t-h - this help screen\n");
 }
 
+// seconds since the epoch, with a fraction if need be
+static bool parse_time(const char *str, timeval *time)
+{
+    char *end;
+    double sec = strtod(str, &end);
+    if (end == str || sec < 0)
+        return false;
+
+    time->tv_sec = (time_t)sec;
+    time->tv_usec = (suseconds_t)((sec - time->tv_sec) * 1000000);
+
+    return true;
+}
+
 static int parse_cmdline(int argc, char **argv, options_t *opt)
 {
     if (argc < 3)
@@ -96,6 +144,79 @@ static int parse_cmdline(int argc, char **argv, options_t *opt)
 
             i--;
         }
+        else if (!strcmp(argv[i], "-f"))
+        {
+            i++;
+            if (i == argc)
+            {
+                Logger::getInstance()->log("Dump file not specified\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->capture = argv[i];
+        }
+        else if (!strcmp(argv[i], "-j"))
+        {
+            i++;
+            if (i == argc || atoi(argv[i]) <= 0)
+            {
+                Logger::getInstance()->log("Thread count not specified\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->threads = atoi(argv[i]);
+        }
+        else if (!strcmp(argv[i], "-s"))
+        {
+            i++;
+            if (i == argc)
+            {
+                Logger::getInstance()->log("Start record not specified\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->start = strtoul(argv[i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "-t"))
+        {
+            i++;
+            const char *to = i < argc ? strchr(argv[i], ',') : NULL;
+            if (i == argc || (argv[i][0] != ',' && !parse_time(argv[i], &opt->from)) ||
+                    (to && !parse_time(to + 1, &opt->to)))
+            {
+                Logger::getInstance()->log("Time range not specified\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->time_range = true;
+            opt->has_to = to != NULL;
+        }
+        else if (!strcmp(argv[i], "-a"))
+        {
+            i++;
+            if (i == argc)
+            {
+                Logger::getInstance()->log("Filter not specified\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->filter = argv[i];
+        }
+        else if (!strcmp(argv[i], "-S") || !strcmp(argv[i], "-P"))
+        {
+            bool json = argv[i][1] == 'S';
+            i++;
+            if (i == argc)
+            {
+                Logger::getInstance()->log("Statistics file not specified\n");
+                exit(EXIT_FAILURE);
+            }
+
+            if (json)
+                opt->json_stats = argv[i];
+            else
+                opt->prometheus_stats = argv[i];
+        }
         else if (!strcmp(argv[i], "--"))
         {
             i++;
@@ -120,15 +241,38 @@ static int parse_cmdline(int argc, char **argv, options_t *opt)
         exit(EXIT_FAILURE);
     }
 
-    if (opt->address.empty())
+    if (opt->address.empty() && opt->capture.empty())
     {
         Logger::getInstance()->log("No address specified\n");
         exit(EXIT_FAILURE);
     }
 
+    if (opt->time_range && (opt->capture.empty() || opt->start))
+    {
+        Logger::getInstance()->log("A time range needs -f and can't be combined with -s\n");
+        exit(EXIT_FAILURE);
+    }
+
     return 0;
 }
 
+static void save_stats(const stats_output_t &output)
+{
+    const options_t *options = output.options;
+    if (!options->json_stats.empty() &&
+            output.stats->save(options->json_stats, WldStats::FORMAT_JSON))
+        Logger::getInstance()->log("Failed to write %s\n", options->json_stats.c_str());
+
+    if (!options->prometheus_stats.empty() &&
+            output.stats->save(options->prometheus_stats, WldStats::FORMAT_PROMETHEUS))
+        Logger::getInstance()->log("Failed to write %s\n", options->prometheus_stats.c_str());
+}
+
+static void stats_signal(ev::sig &watcher, int revents)
+{
+    save_stats(*static_cast<stats_output_t *>(watcher.data));
+}
+
 int main(int argc, char **argv)
 {
     options_t options;
@@ -140,13 +284,6 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    WldNetParser parser;
-    if (parser.openResource(options.address))
-    {
-        Logger::getInstance()->log("Failed to connecto to %s\n", options.address.c_str());
-        exit(EXIT_FAILURE);
-    }
-
     WldProtocolAnalyzer *analyzer = new WldProtocolAnalyzer;
     analyzer->coreProtocol(options.coreProtocol);
 
@@ -160,9 +297,91 @@ int main(int argc, char **argv)
         }
     }
 
-    parser.attachAnalyzer(analyzer);
+    WldArgFilter filter;
+    if (!options.filter.empty() && (filter.parse(options.filter) || analyzer->setFilter(&filter)))
+    {
+        Logger::getInstance()->log("Invalid filter %s\n", options.filter.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    WldStats stats(analyzer->getProtocol());
+    stats_output_t stats_output = { &stats, &options };
+    bool has_stats = !options.json_stats.empty() || !options.prometheus_stats.empty();
+    if (has_stats && !analyzer->getProtocol())
+    {
+        Logger::getInstance()->log("No protocol to gather statistics for\n");
+        exit(EXIT_FAILURE);
+    }
+    if (has_stats)
+        analyzer->setStats(&stats);
+
+    // the index finds where the range starts, what's in it is decoded here
+    if (options.time_range)
+    {
+        WlaBinParser parser;
+        parser.attachAnalyzer(analyzer);
+        if (parser.openResource(options.capture))
+        {
+            Logger::getInstance()->log("Failed to open %s\n", options.capture.c_str());
+            exit(EXIT_FAILURE);
+        }
+
+        if (parser.seekTime(options.from))
+        {
+            Logger::getInstance()->log("Time ranges can only be decoded from record dump files\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (options.has_to)
+            parser.setEndTime(options.to);
+        parser.parse();
+
+        if (has_stats)
+            save_stats(stats_output);
+        return 0;
+    }
+
+    if (!options.capture.empty())
+    {
+        WldParallelDecoder decoder(analyzer, options.threads);
+        decoder.setStart(options.start);
+        if (decoder.open(options.capture))
+        {
+            Logger::getInstance()->log("Failed to open %s\n", options.capture.c_str());
+            exit(EXIT_FAILURE);
+        }
+
+        int ret = decoder.decode();
+        if (has_stats)
+            save_stats(stats_output);
+        return ret;
+    }
+
+    ev::sig sigwtch;
+    if (has_stats)
+    {
+        sigwtch.set<stats_signal>(&stats_output);
+        sigwtch.start(SIGUSR1);
+    }
+
+    // shm: addresses read the dumper's ring in place, on the same host
+    WldParser *parser;
+    if (!options.address.compare(0, sizeof(WLD_SHM_PREFIX) - 1, WLD_SHM_PREFIX))
+        parser = new WldShmParser;
+    else
+        parser = new WldNetParser;
+
+    if (parser->openResource(options.address))
+    {
+        Logger::getInstance()->log("Failed to connecto to %s\n", options.address.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    parser->attachAnalyzer(analyzer);
 
     loop.run();
 
+    delete parser;
+
     return 0;
 }
@@ -0,0 +1,202 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include "bench.h"
+
+double benchNow()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+size_t benchMessage(char *buf, uint32_t object, uint16_t opcode, const uint32_t *words, int count)
+{
+    uint32_t size = PAYLOAD_OFFSET + count * sizeof(uint32_t);
+    uint32_t size_opcode = (size << 16) | opcode;
+
+    memcpy(buf + CLIENT_ID_OFFSET, &object, sizeof(object));
+    memcpy(buf + OPCODE_OFFSET, &size_opcode, sizeof(size_opcode));
+    if (count)
+        memcpy(buf + PAYLOAD_OFFSET, words, count * sizeof(uint32_t));
+
+    return size;
+}
+
+static void appendRecord(WlaMessageBuffer &msg, uint32_t seq, std::vector<char> &records)
+{
+    size_t pos = records.size();
+    records.resize(pos + msg.getRecordSize());
+    msg.serializeRecord(seq, &records[pos], msg.getRecordSize());
+}
+
+void benchGenerateTrace(uint32_t frames, std::vector<char> &records, uint32_t *count)
+{
+    static const uint32_t SURFACE = 5;
+    static const uint32_t FIRST_CALLBACK = 100;
+
+    WlaMessageBuffer msg;
+    msg.getHeader()->cmsg_len = 0;
+    timeval ts = { 1400000000, 0 };
+    uint32_t seq = 0;
+    char buf[256];
+
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        uint32_t callback = FIRST_CALLBACK + i % 50;
+        uint32_t attach[] = { 7, 0, 0 };
+        uint32_t damage[] = { 0, 0, 64, 64 };
+        uint32_t done[] = { i * 16 };
+
+        size_t len = benchMessage(buf, SURFACE, 1, attach, 3);
+        len += benchMessage(buf + len, SURFACE, 2, damage, 4);
+        len += benchMessage(buf + len, SURFACE, 3, &callback, 1);
+        len += benchMessage(buf + len, SURFACE, 6, NULL, 0);
+
+        msg.getHeader()->flags = 0;
+        msg.setType(WlaMessageBuffer::REQUEST_TYPE);
+        msg.getHeader()->timestamp = ts;
+        msg.setMsg(buf, len);
+        msg.getHeader()->msg_len = len;
+        appendRecord(msg, seq++, records);
+
+        ts.tv_usec += 1000;
+        len = benchMessage(buf, callback, 0, done, 1);
+        len += benchMessage(buf + len, 1, 1, &callback, 1);
+
+        msg.getHeader()->flags = 0;
+        msg.setType(WlaMessageBuffer::EVENT_TYPE);
+        msg.getHeader()->timestamp = ts;
+        msg.setMsg(buf, len);
+        msg.getHeader()->msg_len = len;
+        appendRecord(msg, seq++, records);
+
+        ts.tv_usec += 15666;
+        if (ts.tv_usec >= 1000000)
+        {
+            ts.tv_sec++;
+            ts.tv_usec -= 1000000;
+        }
+    }
+
+    *count = seq;
+}
+
+bool benchLoadCapture(const std::string &path, std::vector<char> &records, uint32_t *count)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    records.resize(st.st_size);
+    size_t done = 0;
+    while (done < records.size())
+    {
+        ssize_t ret = read(fd, &records[done], records.size() - done);
+        if (ret <= 0)
+            break;
+        done += ret;
+    }
+    close(fd);
+    records.resize(done);
+
+    // cut off whatever follows the last complete record
+    size_t pos = 0;
+    *count = 0;
+    while (pos < records.size())
+    {
+        size_t len = WlaMessageView::getRecordSize(&records[pos], records.size() - pos);
+        if (!len || pos + len > records.size())
+            break;
+        pos += len;
+        (*count)++;
+    }
+    records.resize(pos);
+
+    return *count > 0;
+}
+
+void benchSplitBlocks(const std::vector<char> &records, size_t block_size,
+                      std::vector<size_t> &blocks, std::vector<uint32_t> &counts)
+{
+    size_t pos = 0;
+    blocks.push_back(0);
+    counts.push_back(0);
+    while (pos < records.size())
+    {
+        size_t len = WlaMessageView::getRecordSize(&records[pos], records.size() - pos);
+        if (pos != blocks.back() && pos + len - blocks.back() > block_size)
+        {
+            blocks.push_back(pos);
+            counts.push_back(0);
+        }
+
+        counts.back()++;
+        pos += len;
+    }
+    blocks.push_back(pos);
+}
+
+double benchCpuTime()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+            (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+}
+
+long benchMaxRss()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+long benchRss()
+{
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (!statm)
+        return 0;
+
+    long size, resident = 0;
+    if (fscanf(statm, "%ld %ld", &size, &resident) != 2)
+        resident = 0;
+    fclose(statm);
+
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
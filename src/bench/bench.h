@@ -0,0 +1,61 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "message.h"
+
+// Helpers shared by the benchmark programs
+
+// monotonic clock in seconds
+double benchNow();
+
+// Builds one wire message: object id, size and opcode, then the words
+size_t benchMessage(char *buf, uint32_t object, uint16_t opcode, const uint32_t *words, int count);
+
+// Records of a client drawing frames the way a simple one does: attach,
+// damage, frame and commit in one request record, then the frame callback
+// done and wl_display.delete_id in one event record, 60 frames a second.
+// The surface is object 5 and the callbacks cycle through 50 ids.
+void benchGenerateTrace(uint32_t frames, std::vector<char> &records, uint32_t *count);
+
+// Loads a record capture as written by wldump -o, false if it can't be read
+bool benchLoadCapture(const std::string &path, std::vector<char> &records, uint32_t *count);
+
+// Splits records into runs of at most block_size bytes, the way
+// WldBlockDumper cuts blocks; blocks holds the start offsets and the end
+void benchSplitBlocks(const std::vector<char> &records, size_t block_size,
+                      std::vector<size_t> &blocks, std::vector<uint32_t> &counts);
+
+// getrusage user and system time in seconds, resident set peak in KB
+double benchCpuTime();
+long benchMaxRss();
+// resident set right now in KB, 0 without /proc
+long benchRss();
+
+#endif // BENCH_H
@@ -0,0 +1,174 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "codec.h"
+
+// Compression ratio and speed of every codec over the blocks the block
+// dumper would write, for a generated trace and optionally a capture:
+//
+//     wldbench_codec [-n <frames>] [-b <block KB>] [<record capture>]
+
+static const double MIN_RUN_TIME = 1.0; // seconds per codec and direction
+
+struct trace_t
+{
+    const char *name;
+    std::vector<char> records;
+    uint32_t count;
+    std::vector<size_t> blocks;
+    std::vector<uint32_t> counts;
+};
+
+static void usage()
+{
+    printf("Usage: wldbench_codec [-n <frames>] [-b <block KB>] [<record capture>]\n"
+           "\t-n <frames> - frames of the generated trace, 100000 by default\n"
+           "\t-b <block KB> - block size, 256 by default\n");
+}
+
+static bool runCodec(const WldCodec *codec, const trace_t &trace)
+{
+    const std::vector<size_t> &blocks = trace.blocks;
+    size_t raw = blocks.back();
+    std::vector<char> packed(codec->getMaxCompressedSize(raw) + blocks.size() * 16);
+    std::vector<size_t> lens(blocks.size() - 1);
+
+    double start = benchNow();
+    int passes = 0;
+    size_t total = 0;
+    do
+    {
+        char *out = &packed[0];
+        total = 0;
+        for (size_t i = 0; i + 1 < blocks.size(); i++)
+        {
+            size_t len = blocks[i + 1] - blocks[i];
+            long ret = codec->compress(&trace.records[blocks[i]], len, out,
+                                       codec->getMaxCompressedSize(len));
+            if (ret < 0)
+            {
+                printf("%s failed to compress block %lu\n", codec->getName(), i);
+                return false;
+            }
+
+            lens[i] = ret;
+            out += ret;
+            total += ret;
+        }
+        passes++;
+    } while (benchNow() - start < MIN_RUN_TIME);
+    double compress_time = (benchNow() - start) / passes;
+
+    std::vector<char> unpacked(raw);
+    start = benchNow();
+    passes = 0;
+    do
+    {
+        const char *in = &packed[0];
+        for (size_t i = 0; i + 1 < blocks.size(); i++)
+        {
+            size_t len = blocks[i + 1] - blocks[i];
+            if (codec->decompress(in, lens[i], &unpacked[blocks[i]], len) != (long)len)
+            {
+                printf("%s failed to decompress block %lu\n", codec->getName(), i);
+                return false;
+            }
+            in += lens[i];
+        }
+        passes++;
+    } while (benchNow() - start < MIN_RUN_TIME);
+    double decompress_time = (benchNow() - start) / passes;
+
+    if (memcmp(&unpacked[0], &trace.records[0], raw))
+    {
+        printf("%s didn't give the records back\n", codec->getName());
+        return false;
+    }
+
+    double mb = raw / (1024.0 * 1024.0);
+    printf("%-10s %-6s %10.1f %8.2f %12.1f %12.1f\n", trace.name, codec->getName(), mb,
+           (double)raw / total, mb / compress_time, mb / decompress_time);
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = 100000;
+    size_t block_size = 256 * 1024;
+    const char *capture = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            frames = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            block_size = strtoul(argv[++i], NULL, 10) * 1024;
+        else if (argv[i][0] != '-' && !capture)
+            capture = argv[i];
+        else
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!frames || !block_size)
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    std::vector<trace_t> traces(capture ? 2 : 1);
+    traces[0].name = "generated";
+    benchGenerateTrace(frames, traces[0].records, &traces[0].count);
+    if (capture)
+    {
+        traces[1].name = "capture";
+        if (!benchLoadCapture(capture, traces[1].records, &traces[1].count))
+        {
+            printf("Failed to load records from %s\n", capture);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("%-10s %-6s %10s %8s %12s %12s\n", "trace", "codec", "MB", "ratio",
+           "comp MB/s", "decomp MB/s");
+    int ret = EXIT_SUCCESS;
+    for (size_t t = 0; t < traces.size(); t++)
+    {
+        benchSplitBlocks(traces[t].records, block_size, traces[t].blocks, traces[t].counts);
+        for (int i = 0; i < WLD_CODEC_COUNT; i++)
+        {
+            const WldCodec *codec = WldCodec::get((WldCodecType)i);
+            if (codec && !runCodec(codec, traces[t]))
+                ret = EXIT_FAILURE;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,338 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <ev++.h>
+#include "bench.h"
+#include "dumper.h"
+
+// Messages per second and CPU time per message of WldNetDumper streaming
+// to one analyzer over loopback, for a range of batch sizes with and
+// without corking. Every setting runs flat out and at a steady rate:
+//
+//     wldbench_net [-n <messages>] [-r <messages/s>] [-l <usec>] [-p <port>]
+
+static const unsigned int BURST = 64;    // records dumped per loop iteration
+static const unsigned int TICKS = 1000;  // per second when pacing
+
+struct run_t
+{
+    // settings
+    const char *port;
+    size_t batch_size;
+    unsigned int batch_delay;
+    bool corking;
+    uint32_t total;
+    unsigned int rate;
+
+    // producer, on the loop thread
+    WldNetDumper *dumper;
+    std::vector<WlaMessageBuffer *> *messages;
+    uint32_t dumped;
+    double start;
+    double cpu_start;
+    ev::timer start_timer;
+    ev::timer pace_timer;
+    ev::idle idle;
+    ev::async done;
+
+    // analyzer, on its own thread
+    uint64_t received;
+    uint64_t dropped;
+    double end;
+    double cpu;
+    bool failed;
+};
+
+static double threadCpuTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static bool recvAll(int fd, char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t ret = recv(fd, buf, len, 0);
+        if (ret <= 0)
+            return false;
+        buf += ret;
+        len -= ret;
+    }
+
+    return true;
+}
+
+static void *analyzerThread(void *arg)
+{
+    run_t *run = static_cast<run_t *>(arg);
+    run->failed = true;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(atoi(run->port));
+
+    uint32_t hello[] = { htonl(0), htonl(0) };
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) || send(fd, hello, sizeof(hello), 0) != sizeof(hello))
+    {
+        printf("Failed to connect to port %s\n", run->port);
+        close(fd);
+        run->done.send();
+        return NULL;
+    }
+
+    double cpu_start = threadCpuTime();
+    std::vector<char> frame;
+    uint64_t next = 0;
+    while (next < run->total)
+    {
+        uint32_t header[3];
+        if (!recvAll(fd, (char *)header, sizeof(header)) || ntohl(header[0]) != WLD_NET_FRAME_MAGIC)
+            break;
+
+        frame.resize(ntohl(header[1]));
+        if (!frame.empty() && !recvAll(fd, &frame[0], frame.size()))
+            break;
+
+        WlaMessageView msg;
+        size_t pos = 0;
+        int len;
+        while (pos < frame.size() && (len = msg.parseRecord(&frame[pos], frame.size() - pos)) > 0)
+        {
+            if (msg.isGap())
+                run->dropped += msg.getGapCount();
+            else
+                run->received++;
+            next = msg.getSeq() + (msg.isGap() ? msg.getGapCount() : 1);
+            pos += len;
+        }
+    }
+
+    run->end = benchNow();
+    run->cpu = threadCpuTime() - cpu_start;
+    run->failed = next < run->total;
+    close(fd);
+    run->done.send();
+
+    return NULL;
+}
+
+static void produce(run_t *run, uint32_t count)
+{
+    for (uint32_t i = 0; i < count && run->dumped < run->total; i++, run->dumped++)
+        run->dumper->dump(*(*run->messages)[run->dumped % run->messages->size()]);
+
+    if (run->dumped == run->total)
+    {
+        run->idle.stop();
+        run->pace_timer.stop();
+        // the tail of a batch waits for the delay otherwise
+        run->dumper->flush();
+    }
+}
+
+static void idleEvent(ev::idle &watcher, int revents)
+{
+    produce(static_cast<run_t *>(watcher.data), BURST);
+}
+
+static void paceEvent(ev::timer &watcher, int revents)
+{
+    run_t *run = static_cast<run_t *>(watcher.data);
+    uint32_t due = (uint32_t)((benchNow() - run->start) * run->rate);
+    if (due > run->dumped)
+        produce(run, due - run->dumped);
+}
+
+static void startEvent(ev::timer &watcher, int revents)
+{
+    run_t *run = static_cast<run_t *>(watcher.data);
+    run->start = benchNow();
+    run->cpu_start = threadCpuTime();
+
+    if (run->rate)
+    {
+        run->pace_timer.set<paceEvent>(run);
+        run->pace_timer.start(0.0, 1.0 / TICKS);
+    }
+    else
+    {
+        run->idle.set<idleEvent>(run);
+        run->idle.start();
+    }
+}
+
+static void doneEvent(ev::async &watcher, int revents)
+{
+    ev::get_default_loop().break_loop(ev::ALL);
+}
+
+static void runDumper(run_t *run)
+{
+    run->dumper = new WldNetDumper;
+    run->dumper->setBatching(run->batch_size, run->batch_delay);
+    run->dumper->setCorking(run->corking);
+    if (run->dumper->open(run->port))
+    {
+        printf("Failed to listen on port %s\n", run->port);
+        delete run->dumper;
+        run->failed = true;
+        return;
+    }
+
+    run->dumped = 0;
+    run->received = run->dropped = 0;
+    run->done.set<doneEvent>(run);
+    run->done.start();
+
+    pthread_t analyzer;
+    pthread_create(&analyzer, NULL, analyzerThread, run);
+
+    // let the analyzer connect and say hello first
+    run->start_timer.set<startEvent>(run);
+    run->start_timer.start(0.1, 0.0);
+    ev::get_default_loop().run(0);
+
+    double cpu = threadCpuTime() - run->cpu_start;
+    pthread_join(analyzer, NULL);
+    run->start_timer.stop();
+    run->pace_timer.stop();
+    run->idle.stop();
+    run->done.stop();
+    delete run->dumper;
+
+    if (run->failed)
+    {
+        printf("%8lu %6s %5s  analyzer got %lu of %u messages\n", run->batch_size / 1024,
+               run->corking ? "yes" : "no", run->rate ? "paced" : "flat", run->received, run->total);
+        return;
+    }
+
+    double elapsed = run->end - run->start;
+    printf("%8lu %6s %5s %12.0f %8.2f %12.0f %12.0f\n", run->batch_size / 1024,
+           run->corking ? "yes" : "no", run->rate ? "paced" : "flat",
+           run->received / elapsed, 100.0 * run->dropped / run->total,
+           cpu * 1000000000.0 / run->total, run->cpu * 1000000000.0 / run->total);
+}
+
+static void usage()
+{
+    printf("Usage: wldbench_net [-n <messages>] [-r <messages/s>] [-l <usec>] [-p <port>]\n"
+           "\t-n <messages> - records dumped flat out, 2000000 by default, paced runs take 2 s\n"
+           "\t-r <messages/s> - rate of the paced runs, 20000 by default\n"
+           "\t-l <usec> - batch delay, 1000 by default\n"
+           "\t-p <port> - loopback port to use, 15555 by default\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t total = 2000000;
+    unsigned int rate = 20000;
+    unsigned int delay = 1000;
+    const char *port = "15555";
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 == argc)
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+
+        if (!strcmp(argv[i], "-n"))
+            total = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-r"))
+            rate = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-l"))
+            delay = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-p"))
+            port = argv[++i];
+        else
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!total || !rate)
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    // a few hundred different records, dumped over and over
+    std::vector<char> records;
+    uint32_t count;
+    benchGenerateTrace(100, records, &count);
+    std::vector<WlaMessageBuffer *> messages;
+    for (size_t pos = 0; pos < records.size();)
+    {
+        WlaMessageBuffer *msg = new WlaMessageBuffer;
+        msg->deserializeRecord(&records[pos], records.size() - pos);
+        pos += msg->getRecordSize();
+        messages.push_back(msg);
+    }
+
+    static const size_t batch_sizes[] = { 0, 4, 16, 64, 256 };
+    printf("%8s %6s %5s %12s %8s %12s %12s\n", "batch KB", "cork", "mode", "msgs/s", "drop %",
+           "dump ns/msg", "recv ns/msg");
+    int ret = EXIT_SUCCESS;
+    for (int paced = 0; paced < 2; paced++)
+    {
+        for (size_t i = 0; i < sizeof(batch_sizes) / sizeof(batch_sizes[0]); i++)
+        {
+            for (int corking = 0; corking < 2; corking++)
+            {
+                run_t run;
+                run.port = port;
+                run.batch_size = batch_sizes[i] * 1024;
+                run.batch_delay = delay;
+                run.corking = corking;
+                run.rate = paced ? rate : 0;
+                run.total = paced ? rate * 2 : total;
+                run.messages = &messages;
+                runDumper(&run);
+                if (run.failed)
+                    ret = EXIT_FAILURE;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < messages.size(); i++)
+        delete messages[i];
+
+    return ret;
+}
@@ -0,0 +1,197 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "analyzer.h"
+#include "bench.h"
+#include "filter.h"
+
+// Object creation throughput and memory of WldProtocolAnalyzer::lookup. A
+// client binds wl_compositor and creates the surfaces, then keeps
+// destroying one and creating it again, the server confirming every
+// destruction with wl_display.delete_id:
+//
+//     wldbench_objects [-n <live objects>[,...]] [-c <cycles>] <core protocol>
+//
+// Shown formats every message the way wlanalyzer prints it, filtered has
+// a filter that matches none of them so that only the objects are followed.
+
+static const uint32_t COMPOSITOR = 3;
+static const uint32_t FIRST_SURFACE = 4;
+
+struct result_t
+{
+    double create_ns;   // per create_surface
+    double cycle_ns;    // per destroy, delete_id and create_surface
+    long rss_kb;        // grown while creating the objects
+};
+
+static void usage()
+{
+    printf("Usage: wldbench_objects [-n <live objects>[,...]] [-c <cycles>] <core protocol>\n"
+           "\t-n <live objects> - surfaces alive at once, 1000,100000,1000000 by default\n"
+           "\t-c <cycles> - surfaces destroyed and created again, 1000000 by default\n"
+           "\t<core protocol> - wayland.xml or the name of a built in protocol\n");
+}
+
+static void createSurface(WldProtocolAnalyzer *analyzer, uint32_t id)
+{
+    analyzer->lookup(COMPOSITOR, 0, WLD_MSG_REQUEST, (const char *)&id, sizeof(id));
+}
+
+static void bindCompositor(WldProtocolAnalyzer *analyzer)
+{
+    // name, interface, version and id of an untyped new_id
+    static const char intf[] = "wl_compositor";
+    uint32_t payload[8];
+    memset(payload, 0, sizeof(payload));
+    payload[0] = 1;
+    payload[1] = sizeof(intf);
+    memcpy(&payload[2], intf, sizeof(intf));
+    payload[6] = 4;
+    payload[7] = COMPOSITOR;
+
+    analyzer->lookup(2, 0, WLD_MSG_REQUEST, (const char *)payload, sizeof(payload));
+}
+
+static bool run(const char *protocol, bool filtered, uint32_t objects, uint32_t cycles,
+                result_t *result)
+{
+    WldProtocolAnalyzer *analyzer = new WldProtocolAnalyzer;
+    WldArgFilter filter;
+    if (analyzer->coreProtocol(protocol) ||
+            (filtered && (filter.parse("wl_region") || analyzer->setFilter(&filter))))
+    {
+        delete analyzer;
+        return false;
+    }
+
+    // the output goes nowhere, but is formatted all the same
+    std::string output;
+    Logger::setThreadBuffer(&output);
+
+    bindCompositor(analyzer);
+    bool ok = analyzer->getObject(COMPOSITOR) != NULL;
+
+    long rss = benchRss();
+    double start = benchNow();
+    for (uint32_t i = 0; ok && i < objects; i++)
+    {
+        createSurface(analyzer, FIRST_SURFACE + i);
+        output.clear();
+    }
+    result->create_ns = (benchNow() - start) * 1e9 / objects;
+    result->rss_kb = benchRss() - rss;
+    ok = ok && analyzer->getObjectCount() >= objects;
+
+    start = benchNow();
+    for (uint32_t i = 0; ok && i < cycles; i++)
+    {
+        uint32_t id = FIRST_SURFACE + i % objects;
+        analyzer->lookup(id, 0, WLD_MSG_REQUEST, NULL, 0);
+        analyzer->lookup(1, 1, WLD_MSG_EVENT, (const char *)&id, sizeof(id));
+        createSurface(analyzer, id);
+        output.clear();
+    }
+    result->cycle_ns = (benchNow() - start) * 1e9 / cycles;
+    ok = ok && analyzer->getObjectCount() >= objects;
+
+    Logger::setThreadBuffer(NULL);
+    delete analyzer;
+
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<uint32_t> sizes;
+    uint32_t cycles = 1000000;
+    const char *protocol = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+        {
+            char *p = argv[++i];
+            while (*p)
+            {
+                sizes.push_back(strtoul(p, &p, 10));
+                if (*p == ',')
+                    p++;
+                else if (*p)
+                    sizes.push_back(0);
+            }
+        }
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+            cycles = strtoul(argv[++i], NULL, 10);
+        else if (argv[i][0] != '-' && !protocol)
+            protocol = argv[i];
+        else
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (sizes.empty())
+    {
+        sizes.push_back(1000);
+        sizes.push_back(100000);
+        sizes.push_back(1000000);
+    }
+
+    for (size_t i = 0; i < sizes.size(); i++)
+    {
+        if (!sizes[i] || !cycles || !protocol)
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("%-9s %10s %10s %10s %12s %10s %10s\n", "mode", "objects", "create ns",
+           "create/s", "cycle ns", "RSS MB", "bytes/obj");
+    for (int filtered = 0; filtered < 2; filtered++)
+    {
+        for (size_t i = 0; i < sizes.size(); i++)
+        {
+            result_t result;
+            if (!run(protocol, filtered, sizes[i], cycles, &result))
+            {
+                printf("Failed to follow the objects with the %s protocol\n", protocol);
+                return EXIT_FAILURE;
+            }
+
+            printf("%-9s %10u %10.1f %10.0f %12.1f %10.1f %10.1f\n",
+                   filtered ? "filtered" : "shown", sizes[i], result.create_ns,
+                   1e9 / result.create_ns, result.cycle_ns, result.rss_kb / 1024.0,
+                   result.rss_kb * 1024.0 / sizes[i]);
+        }
+    }
+
+    printf("RSS peak %.1f MB\n", benchMaxRss() / 1024.0);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,199 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <tr1/unordered_map>
+#include "analyzer.h"
+#include "bench.h"
+
+// Insert and lookup speed of WldObjectTable against the unordered_map it
+// replaced, with that many live objects:
+//
+//     wldbench_table [-n <live objects>[,...]]
+//
+// Objects get client ids from 1 up, the way a client hands them out, and
+// are looked up in random order.
+
+static const double MIN_RUN_TIME = 0.5; // seconds per table and operation
+
+typedef std::tr1::unordered_map<uint32_t, WldObjectTable::Object> map_t;
+
+struct result_t
+{
+    double insert_ns;
+    double lookup_ns;
+};
+
+static void usage()
+{
+    printf("Usage: wldbench_table [-n <live objects>[,...]]\n"
+           "\t-n <live objects> - 1000,100000,1000000 by default\n");
+}
+
+static void randomIds(uint32_t objects, std::vector<uint32_t> &ids)
+{
+    uint32_t state = 12345;
+    ids.resize(1 << 20);
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        state = state * 1103515245 + 12345;
+        ids[i] = 1 + (state >> 8) % objects;
+    }
+}
+
+static result_t runTable(uint32_t objects, const std::vector<uint32_t> &ids,
+                         const WldInterface *intf)
+{
+    result_t result;
+    uint64_t inserted = 0;
+    double start = benchNow();
+    do
+    {
+        WldObjectTable table;
+        for (uint32_t id = 1; id <= objects; id++)
+            table.insert(id, intf, 1, id);
+        inserted += objects;
+    } while (benchNow() - start < MIN_RUN_TIME);
+    result.insert_ns = (benchNow() - start) * 1e9 / inserted;
+
+    WldObjectTable table;
+    for (uint32_t id = 1; id <= objects; id++)
+        table.insert(id, intf, 1, id);
+
+    uint64_t found = 0;
+    uint64_t looked = 0;
+    start = benchNow();
+    do
+    {
+        for (size_t i = 0; i < ids.size(); i++)
+            found += table.find(ids[i]) != NULL;
+        looked += ids.size();
+    } while (benchNow() - start < MIN_RUN_TIME);
+    result.lookup_ns = (benchNow() - start) * 1e9 / looked;
+
+    if (found != looked)
+        printf("WldObjectTable lost objects\n");
+
+    return result;
+}
+
+static result_t runMap(uint32_t objects, const std::vector<uint32_t> &ids,
+                       const WldInterface *intf)
+{
+    WldObjectTable::Object obj = { intf, 1, 1, 0 };
+    result_t result;
+    uint64_t inserted = 0;
+    double start = benchNow();
+    do
+    {
+        map_t map;
+        for (uint32_t id = 1; id <= objects; id++)
+        {
+            obj.created = id;
+            map[id] = obj;
+        }
+        inserted += objects;
+    } while (benchNow() - start < MIN_RUN_TIME);
+    result.insert_ns = (benchNow() - start) * 1e9 / inserted;
+
+    map_t map;
+    for (uint32_t id = 1; id <= objects; id++)
+        map[id] = obj;
+
+    uint64_t found = 0;
+    uint64_t looked = 0;
+    start = benchNow();
+    do
+    {
+        for (size_t i = 0; i < ids.size(); i++)
+            found += map.find(ids[i]) != map.end();
+        looked += ids.size();
+    } while (benchNow() - start < MIN_RUN_TIME);
+    result.lookup_ns = (benchNow() - start) * 1e9 / looked;
+
+    if (found != looked)
+        printf("unordered_map lost objects\n");
+
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<uint32_t> sizes;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+        {
+            char *p = argv[++i];
+            while (*p)
+            {
+                sizes.push_back(strtoul(p, &p, 10));
+                if (*p == ',')
+                    p++;
+                else if (*p)
+                    sizes.push_back(0);
+            }
+        }
+        else
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (sizes.empty())
+    {
+        sizes.push_back(1000);
+        sizes.push_back(100000);
+        sizes.push_back(1000000);
+    }
+
+    for (size_t i = 0; i < sizes.size(); i++)
+    {
+        if (!sizes[i])
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    WldInterface intf;
+    printf("%-14s %10s %12s %12s\n", "table", "objects", "insert ns", "lookup ns");
+    for (size_t i = 0; i < sizes.size(); i++)
+    {
+        std::vector<uint32_t> ids;
+        randomIds(sizes[i], ids);
+
+        result_t table = runTable(sizes[i], ids, &intf);
+        result_t map = runMap(sizes[i], ids, &intf);
+        printf("%-14s %10u %12.1f %12.1f\n", "WldObjectTable", sizes[i], table.insert_ns,
+               table.lookup_ns);
+        printf("%-14s %10u %12.1f %12.1f\n", "unordered_map", sizes[i], map.insert_ns,
+               map.lookup_ns);
+    }
+
+    return EXIT_SUCCESS;
+}
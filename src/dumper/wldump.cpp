@@ -31,7 +31,12 @@
 #include <sys/wait.h>
 
 #include "../wlanalyzer_base/common.h"
+#include "../wlanalyzer_base/block.h"
+#include "../wlanalyzer_base/columns.h"
 #include "../wlanalyzer_base/proxy.h"
+#include "../wlanalyzer_base/queue.h"
+#include "../wlanalyzer_base/recorder.h"
+#include "../wlanalyzer_base/shm.h"
 #include "../wlanalyzer_base/logger.h"
 #include "../wlanalyzer_base/xml/protocol_parser.h"
 
@@ -39,12 +44,26 @@ using namespace std;
 
 struct options_t
 {
-    options_t() : coreProtocol(""), analyze(false), exec(NULL) {}
+    options_t() : coreProtocol(""), analyze(false), analysis_thread(false), analysis_threads(0),
+        recorder_size(0), latency_threshold(0), columns(false), net_buffer_size(16), drop_oldest(false),
+        net_batch_size(64), net_batch_delay(1000), exec(NULL) {}
 
     std::string coreProtocol;
     std::vector<std::string> extensions;
     bool analyze;
+    bool analysis_thread; // analyze on a thread of its own
+    unsigned int analysis_threads; // analyze each connection on its own, on that many threads
+    std::string output; // write the dump file here
     std::string port_number; // used when the dumper is launched in server mode
+    std::string shm_socket; // serve the traffic over shared memory
+    unsigned int recorder_size; // in MB, used in flight recorder mode
+    unsigned int latency_threshold; // in ms
+    std::string codec; // compress the dump file with this codec
+    bool columns; // split the dump file blocks into columns
+    unsigned int net_buffer_size; // in MB, used in server mode
+    bool drop_oldest; // what to drop when the analyzer can't keep up
+    unsigned int net_batch_size; // in KB, used in server mode
+    unsigned int net_batch_delay; // in us, used in server mode
     char **exec;
 };
 
@@ -61,10 +80,33 @@ static void usage()
     fprintf(stderr, "wldump is a wayland protocol dumper\n"
             "Usage:\twldump [OPTIONS] -- <wayland_client>\n\n"
             "Options:\n"
-            "\t-c <file_path> - set the core protocol specification file\n"
+            "\t-c <file_path> - set the core protocol specification file, or the name of a built in one\n"
             "\t-e <file_paths> - provide extensions of the protocol file. "
             "Use only with -c option\n"
+            "\t-T - run the analysis on a separate thread. Use only with -c option\n"
+            "\t-j <threads> - analyze each connection on its own, on that many threads. "
+            "Use only with -c option\n"
+            "\t-o <file_path> - write the dump file\n"
+            "\t-z <lz|zlib> - write the dump file in compressed blocks. "
+            "Use only with -o option\n"
+            "\t-k - write the dump file in columnar blocks, compressed with the -z codec "
+            "if given. Use only with -o option\n"
             "\t-n <port number> - launch in server mode\n"
+            "\t-s <socket path> - share the traffic with analyzers on this host, "
+            "connect with wlanalyzer -- shm:<socket path>\n"
+            "\t-b <size in MB> - buffer that much traffic for the analyzer, 16 by default. "
+            "Use only with -n or -s option\n"
+            "\t-p <oldest|newest> - which messages to drop when the buffer is full, "
+            "newest by default. Use only with -n option\n"
+            "\t-f <size in KB> - send the messages to the analyzer in batches of that "
+            "size, 64 by default. Use only with -n option\n"
+            "\t-l <microseconds> - but don't hold a message back longer than that, "
+            "1000 by default, 0 sends each message right away. Use only with -n option\n"
+            "\t-r <size in MB> - keep only the last traffic in memory and write it to\n"
+            "\t\tdump.<n> on SIGUSR1, on a \"dump\" command sent to the\n"
+            "\t\t" WLA_RECORDER_SOCKETNAME " socket or on wl_display.error\n"
+            "\t-t <milliseconds> - also dump when an event takes longer than that "
+            "to follow a request. Use only with -r option\n"
             "\t-h - this help screen\n");
 }
 
@@ -128,6 +170,124 @@ static int parse_cmdline(int argc, char **argv, options_t *opt)
 
             opt->port_number = argv[i];
         }
+        else if (!strcmp(argv[i], "-T"))
+        {
+            opt->analysis_thread = true;
+        }
+        else if (!strcmp(argv[i], "-j"))
+        {
+            i++;
+            if (i == argc || atoi(argv[i]) <= 0)
+            {
+                Logger::getInstance()->log("Thread count not specified\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->analysis_threads = atoi(argv[i]);
+        }
+        else if (!strcmp(argv[i], "-o"))
+        {
+            i++;
+            if (i == argc)
+            {
+                Logger::getInstance()->log("Dump file not specified\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->output = argv[i];
+        }
+        else if (!strcmp(argv[i], "-z"))
+        {
+            i++;
+            if (i == argc || !WldCodec::get(argv[i]))
+            {
+                Logger::getInstance()->log("Unknown or unavailable codec\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->codec = argv[i];
+        }
+        else if (!strcmp(argv[i], "-k"))
+        {
+            opt->columns = true;
+        }
+        else if (!strcmp(argv[i], "-r"))
+        {
+            i++;
+            if (i == argc || atoi(argv[i]) <= 0)
+            {
+                Logger::getInstance()->log("Flight recorder size not specified\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->recorder_size = atoi(argv[i]);
+        }
+        else if (!strcmp(argv[i], "-s"))
+        {
+            i++;
+            if (i == argc)
+            {
+                Logger::getInstance()->log("socket path not specified\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->shm_socket = argv[i];
+        }
+        else if (!strcmp(argv[i], "-b"))
+        {
+            i++;
+            if (i == argc || atoi(argv[i]) <= 0)
+            {
+                Logger::getInstance()->log("Buffer size not specified\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->net_buffer_size = atoi(argv[i]);
+        }
+        else if (!strcmp(argv[i], "-p"))
+        {
+            i++;
+            if (i == argc || (strcmp(argv[i], "oldest") && strcmp(argv[i], "newest")))
+            {
+                Logger::getInstance()->log("Drop policy must be oldest or newest\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->drop_oldest = !strcmp(argv[i], "oldest");
+        }
+        else if (!strcmp(argv[i], "-f"))
+        {
+            i++;
+            if (i == argc || atoi(argv[i]) <= 0)
+            {
+                Logger::getInstance()->log("Batch size not specified\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->net_batch_size = atoi(argv[i]);
+        }
+        else if (!strcmp(argv[i], "-l"))
+        {
+            i++;
+            if (i == argc || atoi(argv[i]) < 0)
+            {
+                Logger::getInstance()->log("Batch delay not specified\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->net_batch_delay = atoi(argv[i]);
+        }
+        else if (!strcmp(argv[i], "-t"))
+        {
+            i++;
+            if (i == argc || atoi(argv[i]) <= 0)
+            {
+                Logger::getInstance()->log("Latency threshold not specified\n");
+                exit(EXIT_FAILURE);
+            }
+
+            opt->latency_threshold = atoi(argv[i]);
+        }
         else if (!strcmp(argv[i], "-e"))
         {
             i++;
@@ -203,7 +363,28 @@ int main(int argc, char *argv[])
     WlaProxyServer proxy;
     proxy.init(WLA_SOCKETNAME);
 
-    if (options.coreProtocol.size())
+    // every mode is a sink of its own, any of them can be combined
+    WldTeeDumper *tee = new WldTeeDumper;
+
+    if (options.recorder_size)
+    {
+        WldFlightRecorder *recorder = new WldFlightRecorder(options.recorder_size * 1024 * 1024);
+        if (recorder->open("dump"))
+        {
+            Logger::getInstance()->log("Failed to start the flight recorder\n");
+            exit(EXIT_FAILURE);
+        }
+
+        std::string controlPath = std::string(getenv("XDG_RUNTIME_DIR")) +
+                "/" + WLA_RECORDER_SOCKETNAME;
+        if (recorder->setControlSocket(controlPath))
+            DEBUG_LOG("Failed to open the control socket %s", controlPath.c_str());
+
+        recorder->setLatencyThreshold(options.latency_threshold / 1000.0);
+        tee->addDumper(recorder);
+    }
+
+    if (options.analyze)
     {
         WldProtocolAnalyzer *analyzer = new WldProtocolAnalyzer;
         analyzer->coreProtocol(options.coreProtocol);
@@ -217,28 +398,71 @@ int main(int argc, char *argv[])
             }
         }
 
-        WldIODumper *dumper = new WldIODumper;
-        dumper->open("dump");
-        proxy.setDumper(dumper);
+        if (options.analysis_threads)
+        {
+            WldShardedParser *parser = new WldShardedParser(options.analysis_threads);
+            parser->attachAnalyzer(analyzer);
+            if (parser->startThreads())
+                Logger::getInstance()->log("Failed to start the analysis threads, "
+                                           "analyzing on the main loop\n");
+            tee->addDumper(new WldQueueDumper(parser));
+            proxy.setParser(parser);
+        }
+        else
+        {
+            WldQueueParser *parser = new WldQueueParser;
+            parser->attachAnalyzer(analyzer);
+            if (options.analysis_thread && parser->startThread())
+                Logger::getInstance()->log("Failed to start the analysis thread, "
+                                           "analyzing on the main loop\n");
+            tee->addDumper(new WldQueueDumper(parser));
+            proxy.setParser(parser);
+        }
+    }
 
-//        WldNetDumper *netDump = new WldNetDumper;
-//        if (netDump->open("5000"))
-//            DEBUG_LOG("Failed to open port 5000");
-//        proxy.setDumper(netDump);
+    if (options.output.size())
+    {
+        WldDumper *dumper;
+        if (options.columns)
+            dumper = new WldColumnDumper(options.codec.empty() ? WLD_CODEC_NONE :
+                                         WldCodec::get(options.codec)->getType());
+        else if (!options.codec.empty())
+            dumper = new WldBlockDumper(WldCodec::get(options.codec)->getType());
+        else
+            dumper = new WldIODumper;
 
-        WlaBinParser *parser = new WlaBinParser;
-        parser->openResource("dump");
-        parser->attachAnalyzer(analyzer);
-        proxy.setParser(parser);
+        if (dumper->open(options.output) < 0)
+        {
+            Logger::getInstance()->log("Failed to create %s\n", options.output.c_str());
+            delete dumper;
+        }
+        else
+        {
+            tee->addDumper(dumper);
+        }
     }
-    else if (options.port_number.size())
+
+    if (options.port_number.size())
     {
-        WldNetDumper *netDump = new WldNetDumper;
+        WldNetDumper::DropPolicy policy = options.drop_oldest ?
+                    WldNetDumper::DROP_OLDEST : WldNetDumper::DROP_NEWEST;
+        WldNetDumper *netDump = new WldNetDumper(options.net_buffer_size * 1024 * 1024, policy);
+        netDump->setBatching(options.net_batch_size * 1024, options.net_batch_delay);
         if (netDump->open(options.port_number))
             DEBUG_LOG("Failed to open port %s", options.port_number.c_str());
-        proxy.setDumper(netDump);
+        tee->addDumper(netDump);
+    }
+
+    if (options.shm_socket.size())
+    {
+        WldShmDumper *shmDump = new WldShmDumper(options.net_buffer_size * 1024 * 1024);
+        if (shmDump->open(options.shm_socket))
+            Logger::getInstance()->log("Failed to share the ring on %s\n", options.shm_socket.c_str());
+        tee->addDumper(shmDump);
     }
 
+    proxy.setDumper(tee);
+
     if ((ppid = fork()) == 0)
     {
         modify_environment();
@@ -0,0 +1,228 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "block.h"
+#include "columns.h"
+#include "dumper.h"
+#include "reader.h"
+
+// Writes the same messages in every capture format and reads them back
+
+static const uint32_t RECORDS = 5000;
+
+struct expected_t
+{
+    timeval time;
+    bool event;
+    uint32_t object;
+    uint16_t opcode;
+    std::vector<char> payload;
+    uint32_t cmsg_len;
+};
+
+// never splits a block into columns, the way a failing encoder doesn't
+class WldPlainColumnDumper : public WldColumnDumper
+{
+public:
+    WldPlainColumnDumper(WldCodecType codec) : WldColumnDumper(codec) {}
+    virtual ~WldPlainColumnDumper() { close(); }
+
+protected:
+    virtual bool encodeBlock(const std::vector<char> &records, uint32_t count,
+                             std::vector<char> &out)
+    {
+        return false;
+    }
+};
+
+// Records of one to three messages with growing payloads, every tenth
+// with a control message
+static void makeRecord(uint32_t i, WlaMessageBuffer &msg, std::vector<expected_t> &expected)
+{
+    char buf[512];
+    size_t len = 0;
+    timeval ts = { 1400000000 + i / 100, (i % 100) * 10000 };
+
+    for (uint32_t m = 0; m <= i % 3; m++)
+    {
+        expected_t e;
+        e.time = ts;
+        e.event = i % 2;
+        e.object = 1 + (i + m) % 40;
+        e.opcode = (i + m) % 7;
+        e.payload.resize(4 * ((i + m) % 24));
+        for (size_t b = 0; b < e.payload.size(); b++)
+            e.payload[b] = (char)(i * 31 + b);
+        e.cmsg_len = i % 10 ? 0 : 16;
+
+        uint32_t size_opcode = ((PAYLOAD_OFFSET + e.payload.size()) << 16) | e.opcode;
+        memcpy(buf + len + CLIENT_ID_OFFSET, &e.object, sizeof(e.object));
+        memcpy(buf + len + OPCODE_OFFSET, &size_opcode, sizeof(size_opcode));
+        if (!e.payload.empty())
+            memcpy(buf + len + PAYLOAD_OFFSET, &e.payload[0], e.payload.size());
+        len += PAYLOAD_OFFSET + e.payload.size();
+
+        expected.push_back(e);
+    }
+
+    msg.getHeader()->flags = 0;
+    msg.setType(i % 2 ? WlaMessageBuffer::EVENT_TYPE : WlaMessageBuffer::REQUEST_TYPE);
+    msg.getHeader()->timestamp = ts;
+    msg.setMsg(buf, len);
+    msg.getHeader()->msg_len = len;
+
+    char cmsg[16];
+    memset(cmsg, i, sizeof(cmsg));
+    msg.setControlMsg(cmsg, i % 10 ? 0 : sizeof(cmsg));
+    msg.getHeader()->cmsg_len = i % 10 ? 0 : sizeof(cmsg);
+}
+
+static bool check(const char *name, const std::string &path, const std::vector<expected_t> &expected)
+{
+    WldCaptureReader reader;
+    if (reader.open(path))
+    {
+        printf("%s: failed to open %s\n", name, path.c_str());
+        return false;
+    }
+
+    size_t n = 0;
+    for (WldCaptureReader::iterator it = reader.begin(); it != reader.end(); ++it, n++)
+    {
+        if (n >= expected.size())
+        {
+            printf("%s: more than %lu messages\n", name, expected.size());
+            return false;
+        }
+
+        const expected_t &e = expected[n];
+        if (it->getTimeStamp()->tv_sec != e.time.tv_sec ||
+                it->getTimeStamp()->tv_usec != e.time.tv_usec ||
+                (it->getType() == WLD_MSG_EVENT) != e.event ||
+                it->getObjectId() != e.object || it->getOpcode() != e.opcode ||
+                it->getPayloadSize() != e.payload.size() ||
+                (!e.payload.empty() && memcmp(it->getPayload(), &e.payload[0], e.payload.size())) ||
+                it->getRecord().getControlMsgSize() != e.cmsg_len)
+        {
+            printf("%s: message %lu differs\n", name, n);
+            return false;
+        }
+    }
+
+    if (n != expected.size())
+    {
+        printf("%s: read %lu of %lu messages\n", name, n, expected.size());
+        return false;
+    }
+
+    return true;
+}
+
+static bool checkColumns(const char *name, const std::string &path, size_t messages)
+{
+    WldColumnReader reader;
+    if (reader.open(path))
+    {
+        printf("%s: failed to open %s\n", name, path.c_str());
+        return false;
+    }
+
+    size_t n = 0;
+    WldColumnBlock *block;
+    while ((block = reader.nextBlock()))
+        n += block->getMessageCount();
+
+    if (n != messages)
+    {
+        printf("%s: column reader saw %lu of %lu messages\n", name, n, messages);
+        return false;
+    }
+
+    return true;
+}
+
+// the dumper is destroyed without a flush, its destructor has to write
+// out everything
+static bool roundTrip(const char *name, WldDumper *dumper, bool columns)
+{
+    char path[] = "/tmp/wld_format_test_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+    {
+        printf("%s: can't create a temporary file\n", name);
+        delete dumper;
+        return false;
+    }
+    close(fd);
+
+    std::vector<expected_t> expected;
+    bool ok = dumper->open(path) >= 0;
+    if (ok)
+    {
+        WlaMessageBuffer msg;
+        for (uint32_t i = 0; i < RECORDS; i++)
+        {
+            makeRecord(i, msg, expected);
+            dumper->dump(msg);
+        }
+    }
+    else
+        printf("%s: failed to open the dumper\n", name);
+    delete dumper;
+
+    ok = ok && check(name, path, expected);
+    if (ok && columns)
+        ok = checkColumns(name, path, expected.size());
+
+    unlink(path);
+    printf("%s: %s\n", name, ok ? "ok" : "FAILED");
+
+    return ok;
+}
+
+int main()
+{
+    bool ok = roundTrip("records", new WldIODumper, false);
+
+    for (int i = 0; i < WLD_CODEC_COUNT; i++)
+    {
+        WldCodecType type = (WldCodecType)i;
+        const WldCodec *codec = WldCodec::get(type);
+        if (!codec)
+            continue;
+
+        std::string name = std::string("blocks ") + codec->getName();
+        ok = roundTrip(name.c_str(), new WldBlockDumper(type), false) && ok;
+        name = std::string("columns ") + codec->getName();
+        ok = roundTrip(name.c_str(), new WldColumnDumper(type), true) && ok;
+        name = std::string("plain columns ") + codec->getName();
+        ok = roundTrip(name.c_str(), new WldPlainColumnDumper(type), true) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include "analyzer.h"
+
+// WldObjectTable keeps ids near the ones handed out in arrays and the rest
+// in a map, an id has to be found wherever it went and the objects that had
+// it told apart
+
+static bool check(const char *name, bool ok)
+{
+    printf("%s: %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static bool findsAll(const WldObjectTable &table, uint32_t first, uint32_t last,
+                     const WldInterface *intf)
+{
+    for (uint32_t id = first; id <= last; id++)
+    {
+        const WldObjectTable::Object *obj = table.find(id);
+        if (!obj || obj->intf != intf)
+            return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    WldInterface surface, region, bogus;
+    bool ok = true;
+
+    // ids far ahead land in the map and move to the array once it gets there
+    WldObjectTable table;
+    table.insert(1, &surface, 1, 0);
+    table.insert(3000000, &bogus, 1, 1);
+    table.insert(0xff100000, &bogus, 1, 2);
+    table.insert(20000, &region, 1, 3);
+    for (uint32_t id = 2; id < 30000; id++)
+    {
+        if (id != 20000)
+            table.insert(id, &surface, 1, id);
+    }
+    ok = check("sparse ids", table.find(3000000) && table.find(3000000)->intf == &bogus &&
+               table.find(0xff100000) && table.find(0xff100000)->intf == &bogus) && ok;
+    ok = check("moved into the array", table.find(20000) && table.find(20000)->intf == &region &&
+               findsAll(table, 1, 19999, &surface) && findsAll(table, 20001, 29999, &surface)) && ok;
+    ok = check("count", table.size() == 30001) && ok;
+
+    // server ids
+    for (uint32_t id = 0xff000000; id < 0xff000100; id++)
+        table.insert(id, &region, 1, id);
+    ok = check("server ids", findsAll(table, 0xff000000, 0xff0000ff, &region) &&
+               !table.find(0xff000100)) && ok;
+
+    table.remove(20000);
+    table.remove(3000000);
+    ok = check("remove", !table.find(20000) && !table.find(3000000) &&
+               table.size() == 30001 + 256 - 2) && ok;
+
+    // an id destroyed and created again is another object
+    table.insert(40, &region, 1, 100);
+    uint32_t first = table.getGeneration(40);
+    table.remove(40);
+    ok = check("destroyed keeps its generation", !table.find(40) &&
+               table.getGeneration(40) == first) && ok;
+    table.insert(40, &region, 1, 200);
+    ok = check("reused id", table.find(40) && table.find(40)->generation == first + 1) && ok;
+    table.insert(5000000, &bogus, 1, 300);
+    table.remove(5000000);
+    table.insert(5000000, &bogus, 1, 400);
+    ok = check("reused sparse id", table.getGeneration(5000000) == 2) && ok;
+
+    // and the timeline tells which one a message at some point refers to
+    WldObjectTimeline timeline;
+    timeline.set(40, &region, first, 101);
+    timeline.set(40, NULL, first, 150);
+    timeline.set(40, &region, first + 1, 201);
+    uint32_t generation;
+    ok = check("timeline first", timeline.find(40, 120, &generation) == &region &&
+               generation == first) && ok;
+    ok = check("timeline destroyed", !timeline.find(40, 160, &generation) &&
+               generation == first) && ok;
+    ok = check("timeline reused", timeline.find(40, 300, &generation) == &region &&
+               generation == first + 1) && ok;
+    ok = check("timeline unused", !timeline.find(41, 300, &generation) && !generation) && ok;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "message.h"
+#include "shm.h"
+
+// WldShmDumper drops a reader that hung up, even when waking the readers up
+// just failed with EAGAIN
+
+static const char SOCKET_PATH[] = "/tmp/wldtest_shm";
+
+static bool check(const char *name, bool ok)
+{
+    printf("%s: %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// The eventfd the reader is woken up with, from the hello of the dumper
+static int receiveEventfd(WldSocket *reader)
+{
+    uint32_t hello[2];
+    iovec iov;
+    iov.iov_base = hello;
+    iov.iov_len = sizeof(hello);
+
+    int fds[2];
+    char control[CMSG_SPACE(sizeof(fds))];
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (recvmsg(reader->getSocketDescriptor(), &msg, 0) != sizeof(hello) || !cmsg ||
+            cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+        return -1;
+
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    close(fds[0]);
+
+    return fds[1];
+}
+
+static void runLoop()
+{
+    for (int i = 0; i < 10; i++)
+        ev::get_default_loop().run(ev::NOWAIT);
+}
+
+int main()
+{
+    bool ok = true;
+
+    WldShmDumper dumper(64 * 1024);
+    if (!check("open", !dumper.open(SOCKET_PATH)))
+        return 1;
+
+    WldSocket *reader = new WldSocket;
+    ok = check("connect", reader->connectToServer(SOCKET_PATH) == NoError) && ok;
+    runLoop();
+    ok = check("attached", dumper.getReaderCount() == 1) && ok;
+
+    int efd = receiveEventfd(reader);
+    ok = check("hello", efd != -1) && ok;
+
+    // a full eventfd fails the wake up with EAGAIN right before the hang up is read
+    uint64_t full = 0xfffffffffffffffeULL;
+    ok = check("fill eventfd", write(efd, &full, sizeof(full)) == sizeof(full)) && ok;
+    WlaMessageBuffer msg;
+    memset(msg.getHeader(), 0, sizeof(WlaMessageBufferHeader));
+    dumper.dump(msg);
+    delete reader;
+    runLoop();
+    ok = check("detached", dumper.getReaderCount() == 0) && ok;
+
+    close(efd);
+    unlink(SOCKET_PATH);
+
+    return ok ? 0 : 1;
+}
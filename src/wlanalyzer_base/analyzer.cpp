@@ -22,24 +22,207 @@
  * SOFTWARE.
  */
 
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <algorithm>
 #include "analyzer.h"
+#include "message.h"
 
-WldProtocolAnalyzer::WldProtocolAnalyzer() : protocol(NULL)
+void WldObjectTimeline::set(uint32_t id, const WldInterface *intf, uint32_t generation,
+                            uint64_t pos)
+{
+    std::vector<Entry> &list = entries[id];
+    if (!list.empty() && list.back().pos == pos)
+    {
+        list.back().intf = intf;
+        list.back().generation = generation;
+        return;
+    }
+
+    Entry entry = { pos, intf, generation };
+    list.push_back(entry);
+    changes++;
+}
+
+const WldInterface *WldObjectTimeline::find(uint32_t id, uint64_t pos, uint32_t *generation) const
+{
+    if (generation)
+        *generation = 0;
+
+    entries_t::const_iterator it = entries.find(id);
+    if (it == entries.end())
+        return NULL;
+
+    // the last change at or before pos
+    const std::vector<Entry> &list = it->second;
+    size_t lo = 0;
+    size_t hi = list.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (list[mid].pos <= pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (!lo)
+        return NULL;
+
+    if (generation)
+        *generation = list[lo - 1].generation;
+    return list[lo - 1].intf;
+}
+
+void WldObjectTable::insert(uint32_t id, const WldInterface *intf, uint32_t version, uint64_t created)
+{
+    Object *obj = getOrAddSlot(id);
+    if (obj->intf)
+        count--;
+
+    obj->generation++;
+    obj->intf = intf;
+    obj->version = version;
+    obj->created = created;
+    count++;
+    if (count > peak)
+        peak = count;
+}
+
+void WldObjectTable::setGeneration(uint32_t id, uint32_t generation)
+{
+    getOrAddSlot(id)->generation = generation;
+}
+
+WldObjectTable::Object *WldObjectTable::getOrAddSlot(uint32_t id)
+{
+    std::vector<Object> &range = id < SERVER_ID_BASE ? client : server;
+    uint32_t index = id < SERVER_ID_BASE ? id : id - SERVER_ID_BASE;
+
+    // a bogus id way past the others doesn't blow the array up
+    if (index < range.size() + MAX_DENSE_GAP)
+    {
+        if (index >= range.size())
+            grow(range, id - index, index + 1);
+        return &range[index];
+    }
+
+    sparse_t::iterator it = sparse.find(id);
+    if (it == sparse.end())
+    {
+        Object empty = { NULL, 0, 0, 0 };
+        it = sparse.insert(sparse_t::value_type(id, empty)).first;
+    }
+    return &it->second;
+}
+
+// Objects that were too far ahead move from the map once the array covers them
+void WldObjectTable::grow(std::vector<Object> &range, uint32_t base, uint32_t size)
+{
+    uint32_t old_size = range.size();
+    Object empty = { NULL, 0, 0, 0 };
+    range.resize(size, empty);
+
+    std::vector<uint32_t> moved;
+    sparse_t::iterator it = sparse.begin();
+    for (; it != sparse.end(); it++)
+    {
+        if (it->first - base >= old_size && it->first - base < size)
+        {
+            range[it->first - base] = it->second;
+            moved.push_back(it->first);
+        }
+    }
+
+    for (size_t i = 0; i < moved.size(); i++)
+        sparse.erase(moved[i]);
+}
+
+void WldObjectTable::remove(uint32_t id)
+{
+    Object *obj = const_cast<Object *>(getSlot(id));
+    if (!obj || !obj->intf)
+        return;
+
+    obj->intf = NULL;
+    count--;
+}
+
+void WldObjectTable::swap(WldObjectTable &other)
+{
+    client.swap(other.client);
+    server.swap(other.server);
+    sparse.swap(other.sparse);
+    std::swap(count, other.count);
+    std::swap(peak, other.peak);
+}
+
+void WldObjectTable::getIds(std::vector<uint32_t> &ids, bool freed) const
+{
+    ids.clear();
+    for (uint32_t i = 0; i < client.size(); i++)
+    {
+        if (client[i].intf || (freed && client[i].generation))
+            ids.push_back(i);
+    }
+
+    for (uint32_t i = 0; i < server.size(); i++)
+    {
+        if (server[i].intf || (freed && server[i].generation))
+            ids.push_back(SERVER_ID_BASE + i);
+    }
+
+    sparse_t::const_iterator it = sparse.begin();
+    for (; it != sparse.end(); it++)
+    {
+        if (it->second.intf || (freed && it->second.generation))
+            ids.push_back(it->first);
+    }
+}
+
+const WldObjectTable::Object *WldObjectTable::findSparse(uint32_t id) const
+{
+    sparse_t::const_iterator it = sparse.find(id);
+    return it == sparse.end() ? NULL : &it->second;
+}
+
+WldProtocolAnalyzer::WldProtocolAnalyzer() : protocol(NULL), owns_protocol(true),
+    recording(NULL), timeline(NULL), position(0), current(0), filter(NULL), stats(NULL),
+    counters(NULL)
+{
+    timestamp.tv_sec = 0;
+    timestamp.tv_usec = 0;
+    null_object.name = "NULL";
+    null_object.version = 0;
+}
+
+WldProtocolAnalyzer::WldProtocolAnalyzer(const WldProtocolAnalyzer &base,
+                                         const WldObjectTimeline *timeline) :
+    protocol(base.protocol), owns_protocol(false), null_object(base.null_object),
+    recording(NULL), timeline(timeline), position(0), current(0), filter(base.filter),
+    stats(base.stats), counters(NULL), timestamp(base.timestamp)
 {
 }
 
 WldProtocolAnalyzer::~WldProtocolAnalyzer()
 {
-    if (protocol)
+    if (counters)
+        stats->removeCounters(counters);
+
+    if (protocol && owns_protocol)
         delete protocol;
 }
 
 int WldProtocolAnalyzer::addProtocolSpec(const std::string &path)
 {
     WldProtocolScanner scanner;
-    if (!scanner.openProtocolFile(path))
-        return -1;
+    // protocols built in are picked by name, unless there is such a file
+    if (access(path.c_str(), F_OK) == 0 || !scanner.openBuiltinProtocol(path))
+    {
+        if (!scanner.openProtocolFile(path))
+            return -1;
+    }
 
     protocol = scanner.getProtocolDefinition(protocol);
     if (!protocol)
@@ -53,10 +236,6 @@ int WldProtocolAnalyzer::coreProtocol(const std::string &path)
     if (addProtocolSpec(path))
         return -1;
 
-    WldInterface dummy;
-    dummy.name = "NULL";
-    dummy.version = 0;
-
     const WldInterface *display = protocol->getInterface("wl_display");
     if (!display)
     {
@@ -72,229 +251,419 @@ int WldProtocolAnalyzer::coreProtocol(const std::string &path)
 
     DEBUG_LOG("");
 
-    objects[0] = dummy;
-    objects[1] = *display;
-    objects[2] = *proxy;
+    resetState();
 
     return 0;
 }
 
-void WldProtocolAnalyzer::lookup(uint32_t object_id, uint32_t opcode, WLD_MESSAGE_TYPE type, const char *payload)
+void WldProtocolAnalyzer::resetState()
 {
-    const WldMessage *msg = NULL;
+    WldObjectTable new_objects;
+    objects.swap(new_objects);
+    names.clear();
+    position = 0;
+
+    const WldInterface *display = protocol ? protocol->getInterface("wl_display") : NULL;
+    const WldInterface *proxy = protocol ? protocol->getInterface("wl_registry") : NULL;
+    if (!display || !proxy)
+        return;
 
-    objects_t::const_iterator it = objects.find(object_id);
-    if (it == objects.end())
-    {
-        Logger::getInstance()->log("Unknown message type @%u:%u\n", object_id, opcode);
+    objects.insert(0, &null_object, 0, 0);
+    objects.insert(1, display, 1, 0);
+    objects.insert(2, proxy, 1, 0);
+}
+
+void WldProtocolAnalyzer::recordTimeline(WldObjectTimeline *timeline)
+{
+    recording = timeline;
+    if (!recording)
         return;
+
+    std::vector<uint32_t> ids;
+    objects.getIds(ids, true);
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        const WldObjectTable::Object *obj = objects.find(ids[i]);
+        recording->set(ids[i], obj ? obj->intf : NULL, objects.getGeneration(ids[i]), position);
     }
+}
 
-    const WldInterface &intf = it->second;
+void WldProtocolAnalyzer::saveState(std::vector<char> &out) const
+{
+    out.clear();
+    putUInt64(out, position);
+
+    // destroyed objects have no interface, only their generation is kept
+    std::vector<uint32_t> ids;
+    objects.getIds(ids, true);
+    putUInt32(out, ids.size());
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        const WldObjectTable::Object *obj = objects.find(ids[i]);
+        putUInt32(out, ids[i]);
+        putString(out, obj ? obj->intf->name : std::string());
+        putUInt32(out, obj ? obj->version : 0);
+        putUInt32(out, objects.getGeneration(ids[i]));
+    }
 
-    if (type == WLD_MSG_REQUEST)
+    putUInt32(out, names.size());
+    names_t::const_iterator name = names.begin();
+    for (; name != names.end(); name++)
     {
-        if (opcode >= intf.requests.size())
-        {
-            DEBUG_LOG("The request %d/%d for %s interface is invalid", opcode, intf.requests.size(),
-                      intf.name.c_str());
-            return;
-        }
-        msg = &intf.requests[opcode];
+        putUInt32(out, name->first);
+        putString(out, name->second);
     }
-    else
+}
+
+int WldProtocolAnalyzer::restoreState(const char *data, size_t len)
+{
+    const char *p = data;
+    const char *end = data + len;
+    uint64_t pos;
+    uint32_t count;
+
+    if (!protocol || !getUInt64(p, end, &pos))
+        return -1;
+
+    WldObjectTable new_objects;
+    if (!getUInt32(p, end, &count))
+        return -1;
+    for (uint32_t i = 0; i < count; i++)
     {
-        if (opcode >= intf.events.size())
+        uint32_t id, version, generation;
+        std::string name;
+        if (!getUInt32(p, end, &id) || !getString(p, end, &name) || !getUInt32(p, end, &version) ||
+                !getUInt32(p, end, &generation))
+            return -1;
+
+        if (!name.empty())
         {
-            DEBUG_LOG("The event %d/%d for %s interface is invalid", opcode, intf.events.size(),
-                      intf.name.c_str());
-            return;
+            const WldInterface *intf = protocol->getInterface(name);
+            new_objects.insert(id, intf ? intf : &null_object, version, pos);
         }
-        msg = &intf.events[opcode];
+        new_objects.setGeneration(id, generation);
     }
 
-    if (!msg)
+    names_t new_names;
+    if (!getUInt32(p, end, &count))
+        return -1;
+    for (uint32_t i = 0; i < count; i++)
     {
-        DEBUG_LOG("Couldn't retrieve message %d:%d of %s", object_id, opcode, intf.name.c_str());
-        return;
+        uint32_t id;
+        std::string name;
+        if (!getUInt32(p, end, &id) || !getString(p, end, &name))
+            return -1;
+
+        new_names[id] = name;
     }
 
-    Logger::getInstance()->log("%s@%u.%s@%u()\n", intf.name.c_str(), object_id, msg->signature.c_str(), opcode);
-    analyzeMessage(intf, *msg, object_id, payload);
+    objects.swap(new_objects);
+    names.swap(new_names);
+    position = pos;
+
+    return 0;
 }
 
-int WldProtocolAnalyzer::analyzeMessage(const WldInterface &intf, const WldMessage &msg, uint32_t obj_id, const char *payload)
+const WldInterface *WldProtocolAnalyzer::findObject(uint32_t id, uint32_t *generation) const
 {
-    if (msg.type == WLD_MSG_EVENT && intf.name == "wl_registry" &&
-            msg.signature == "global")
-    {
-        const char *p = payload;
-
-        uint32_t id = byteArrToUInt32(p);
-        p += 4;
+    if (timeline)
+        return timeline->find(id, current, generation);
 
-        uint32_t name_len = byteArrToUInt32(p);
-        p += 4;
-        char *name = new char[name_len];
-        strncpy(name, p, name_len);
-
-        std::string strName = name;
-
-        delete [] name;
+    if (generation)
+        *generation = objects.getGeneration(id);
+    const WldObjectTable::Object *obj = objects.find(id);
+    return obj ? obj->intf : NULL;
+}
 
-        names[id] = strName;
+uint32_t WldProtocolAnalyzer::getGeneration(uint32_t id) const
+{
+    uint32_t generation;
+    findObject(id, &generation);
+    return generation;
+}
 
-        Logger::getInstance()->log("Found new name %d->%s\n", id, strName.c_str());
-    }
-    else if (intf.name == "wl_registry" &&
-             msg.signature == "bind")
-    {
-        const char *p = payload;
+void WldProtocolAnalyzer::addObject(uint32_t id, const WldInterface *intf, uint32_t version)
+{
+    // the timeline knows already
+    if (timeline)
+        return;
 
-        uint32_t id = byteArrToUInt32(p);
-        p += 4;
+    objects.insert(id, intf, version, current);
+    if (recording)
+        recording->set(id, intf, objects.getGeneration(id), current + 1);
+}
 
-        uint32_t name_len = byteArrToUInt32(p);
-        p += 4;
+void WldProtocolAnalyzer::removeObject(uint32_t id)
+{
+    if (timeline)
+        return;
 
-        char *name = new char[name_len];
-        strncpy(name, p, name_len);
-        p += name_len;
-        std::string strName = name;
-        delete [] name;
+    objects.remove(id);
+    if (recording)
+        recording->set(id, NULL, objects.getGeneration(id), current + 1);
+}
 
-        if ((uintptr_t)p % 4)
+const WldMessage *WldProtocolAnalyzer::findMessage(const WldInterface &intf, uint32_t opcode,
+                                                   WLD_MESSAGE_TYPE type) const
+{
+    if (type == WLD_MSG_REQUEST)
+    {
+        if (opcode >= intf.requests.size())
         {
-            p += 4 - ((uintptr_t)p % 4);
+            DEBUG_LOG("The request %d/%d for %s interface is invalid", opcode, intf.requests.size(),
+                      intf.name.c_str());
+            return NULL;
         }
+        return &intf.requests[opcode];
+    }
 
-        uint32_t ver = byteArrToUInt32(p);
-        p += 4;
+    if (opcode >= intf.events.size())
+    {
+        DEBUG_LOG("The event %d/%d for %s interface is invalid", opcode, intf.events.size(),
+                  intf.name.c_str());
+        return NULL;
+    }
+    return &intf.events[opcode];
+}
 
-        uint32_t new_id = byteArrToUInt32(p);
+void WldProtocolAnalyzer::lookup(uint32_t object_id, uint32_t opcode, WLD_MESSAGE_TYPE type,
+                                 const char *payload, uint32_t size)
+{
+    current = position++;
 
-        const WldInterface *prot_intf = protocol->getInterface(strName);
-        if (prot_intf)
-        {
-            objects[new_id] = *prot_intf;
+    uint32_t generation;
+    const WldInterface *intf = findObject(object_id, &generation);
+    if (!intf)
+    {
+        if (filter)
+            return;
 
-            Logger::getInstance()->log("%s.", msg.intf_name.c_str());
-            Logger::getInstance()->log("%s(", msg.signature.c_str());
-            Logger::getInstance()->log("%u, \"%s\", %u, new id@%u)\n", id, prot_intf->name.c_str(), ver, new_id);
-//            Logger::getInstance()->log("id %d, new_id %d, name %s, ver %d\n", id, new_id, intf->name.c_str(), ver);
-        }
+        if (generation)
+            Logger::getInstance()->log("Unknown message type @%u:%u, destroyed object #%u\n",
+                                       object_id, opcode, generation);
+        else
+            Logger::getInstance()->log("Unknown message type @%u:%u\n", object_id, opcode);
+        return;
+    }
 
-        // print available objects
-        /*
-        DEBUG_LOG("Available objects:");
-        objects_t::const_iterator it = objects.begin();
-        for (; it != objects.end(); it++)
-        {
-            DEBUG_LOG("%u: %s", it->first, it->second.name.c_str());
-        }
-        */
+    const WldMessage *msg = findMessage(*intf, opcode, type);
+    if (!msg)
+    {
+        DEBUG_LOG("Couldn't retrieve message %d:%d of %s", object_id, opcode, intf->name.c_str());
+        return;
+    }
+
+    // added on the first message, scanners and idle copies never count
+    if (stats)
+    {
+        if (!counters)
+            counters = stats->addCounters();
+        counters->add(*msg, *intf, object_id, size + PAYLOAD_OFFSET, timestamp);
     }
-    else if (msg.signature == "destroy")
+
+    if (!decodeArgs(*msg, payload, size))
     {
-        objects.erase(obj_id);
+        if (!filter)
+            Logger::getInstance()->log("%s@%u.%s@%u()\n", intf->name.c_str(), object_id,
+                                       msg->signature.c_str(), opcode);
+        return;
     }
-    else
+
+    bool show = !filter || filter->matches(*msg, args.empty() ? NULL : &args[0]);
+    if (show)
     {
-        extractArguments(msg, payload);
+        formatArgs(*msg);
+        Logger::getInstance()->log("%s@%u.%s@%u(%s)\n", intf->name.c_str(), object_id,
+                                   msg->signature.c_str(), opcode, line.c_str());
     }
+    analyzeMessage(*intf, *msg, object_id, show);
+}
 
+void WldProtocolAnalyzer::setStats(WldStats *stats)
+{
+    if (counters)
+        this->stats->removeCounters(counters);
+
+    this->stats = stats;
+    counters = NULL;
+}
+
+int WldProtocolAnalyzer::setFilter(WldArgFilter *filter)
+{
+    if (filter && (!protocol || filter->resolve(*protocol)))
+        return -1;
+
+    this->filter = filter;
     return 0;
 }
 
-void WldProtocolAnalyzer::extractArguments(const WldMessage &msg, const char *payload)
+void WldProtocolAnalyzer::scan(uint32_t object_id, uint32_t opcode, WLD_MESSAGE_TYPE type,
+                               const char *payload, uint32_t size)
 {
-    const char *p = payload;
+    current = position++;
 
-    std::vector<WldArg>::const_iterator it = msg.args.begin();
-    for (; it != msg.args.end(); it++)
-    {
-        if (it->type == WLD_ARG_NEWID)
-        {
-            const WldInterface *intf = protocol->getInterface(it->interface);
-            if (!intf)
-                continue;
+    const WldInterface *intf = findObject(object_id);
+    const WldMessage *msg = intf ? findMessage(*intf, opcode, type) : NULL;
+    if (!msg || msg->action == WLD_ACTION_NONE || msg->action == WLD_ACTION_GLOBAL)
+        return;
 
-            int id = byteArrToUInt32(p);
-            p += 4;
-            objects[id] = *intf;
-        }
-        else if (it->type == WLD_ARG_STRING)
-        {
-            int len = byteArrToUInt32(p);
-            p += 4;
-            p += len;
-        }
-        else if (it->type == WLD_ARG_ARRAY)
-        {
-            int len = byteArrToUInt32(p);
-            p += 4;
-            p += len;
-        }
-        else
-        {
-            p += 4;
-        }
-    }
+    if (decodeArgs(*msg, payload, size))
+        followObjects(*msg, object_id);
+}
+
+void WldProtocolAnalyzer::scanRecord(const WlaMessageView &record)
+{
+    WLD_MESSAGE_TYPE type = record.getType() == WlaMessageBuffer::EVENT_TYPE ?
+                WLD_MSG_EVENT : WLD_MSG_REQUEST;
+
+    WlaMessageIterator it(record);
+    while (it.next())
+        scan(it.getObjectId(), it.getOpcode(), type, it.getPayload(), it.getPayloadSize());
 }
 
-bool WldProtocolAnalyzer::createsObject(const WldMessage &msg)
+bool WldProtocolAnalyzer::decodeArgs(const WldMessage &msg, const char *payload, uint32_t size)
 {
-    std::vector<WldArg>::const_iterator it = msg.args.begin();
-    for (; it != msg.args.end(); it++)
+    if (args.size() < msg.args.size())
+        args.resize(msg.args.size());
+
+    if (msg.decodeArgs(payload, size, args.empty() ? NULL : &args[0]))
     {
-        if (it->type == WLD_ARG_NEWID)
-            return true;
+        DEBUG_LOG("The arguments of %s.%s are cut short", msg.intf_name.c_str(), msg.signature.c_str());
+        return false;
     }
 
-    return false;
+    return true;
 }
 
-WldProtocolAnalyzer::NewId WldProtocolAnalyzer::getNewId(const WldMessage &msg, const char *payload)
+void WldProtocolAnalyzer::formatArgs(const WldMessage &msg)
 {
-    NewId id = { 0, "" };
-    const char *p = payload;
-    std::vector<WldArg>::const_iterator it = msg.args.begin();
+    line.clear();
 
-    while (it != msg.args.end())
+    char buf[64];
+    for (size_t i = 0; i < msg.args.size(); i++)
     {
-        switch (it->type)
-        {
-        case WLD_ARG_ARRAY:
+        const WldArgVal &val = args[i];
+        if (i)
+            line += ", ";
+
+        switch (msg.args[i].type)
         {
-            int len = byteArrToUInt32(p);
-            p += 4;
-            p += len;
+        case WLD_ARG_INT:
+            snprintf(buf, sizeof(buf), "%d", val.i);
+            break;
+        case WLD_ARG_FIXED:
+            snprintf(buf, sizeof(buf), "%f", val.f / 256.0);
             break;
-        }
         case WLD_ARG_STRING:
+            if (val.s.data)
+            {
+                line += '"';
+                line.append(val.s.data, strnlen(val.s.data, val.s.len));
+                line += '"';
+            }
+            else
+            {
+                line += "nil";
+            }
+            continue;
+        case WLD_ARG_OBJECT:
         {
-            int len = byteArrToUInt32(p);
-            p += 4;
-            p += len;
+            uint32_t generation = 0;
+            const WldInterface *intf = val.o ? findObject(val.o, &generation) : NULL;
+            if (!val.o)
+                snprintf(buf, sizeof(buf), "nil");
+            else if (intf)
+                snprintf(buf, sizeof(buf), "%.40s@%u", intf->name.c_str(), val.o);
+            else if (generation)
+                snprintf(buf, sizeof(buf), "destroyed@%u#%u", val.o, generation);
+            else
+                snprintf(buf, sizeof(buf), "unknown@%u", val.o);
             break;
         }
         case WLD_ARG_NEWID:
-        {
-            int id = byteArrToUInt32(p);
-            p += 4;
-            int name = byteArrToUInt32(p);
-            p += 4;
-            int scheme = byteArrToUInt32(p);
-
-            DEBUG_LOG("%d %d %d", id, name, scheme);
-        }
+            if (!msg.args[i].interface.empty())
+                snprintf(buf, sizeof(buf), "new id %.40s@%u", val.n.interface, val.n.id);
+            else
+                snprintf(buf, sizeof(buf), "new id %.40s@%u, version %u",
+                         val.n.interface ? val.n.interface : "unknown", val.n.id, val.n.version);
+            break;
+        case WLD_ARG_ARRAY:
+            snprintf(buf, sizeof(buf), "array[%u]", val.a.size);
+            break;
+        case WLD_ARG_FD:
+            snprintf(buf, sizeof(buf), "fd %d", val.h);
+            break;
         default:
-            p += 4;
+            snprintf(buf, sizeof(buf), "%u", val.u);
             break;
         }
+        line += buf;
+    }
+}
+
+int WldProtocolAnalyzer::analyzeMessage(const WldInterface &intf, const WldMessage &msg, uint32_t obj_id,
+                                        bool show)
+{
+    if (msg.action == WLD_ACTION_GLOBAL)
+    {
+        uint32_t id = args[0].u;
+        std::string strName;
+        if (args[1].s.data)
+            strName.assign(args[1].s.data, strnlen(args[1].s.data, args[1].s.len));
+
+        names[id] = strName;
+
+        if (show)
+            Logger::getInstance()->log("Found new name %d->%s\n", id, strName.c_str());
+    }
+
+    followObjects(msg, obj_id);
+
+    return 0;
+}
 
-        it++;
+// Creates and destroys what the message does, its arguments decoded already
+void WldProtocolAnalyzer::followObjects(const WldMessage &msg, uint32_t obj_id)
+{
+    switch (msg.action)
+    {
+    case WLD_ACTION_BIND:
+    case WLD_ACTION_NEW_ID:
+        createObjects(msg, obj_id);
+        break;
+    case WLD_ACTION_DESTROY:
+        removeObject(obj_id);
+        break;
+    case WLD_ACTION_DELETE_ID:
+        removeObject(args[0].u);
+        break;
+    default:
+        break;
     }
+}
 
-    return id;
+void WldProtocolAnalyzer::createObjects(const WldMessage &msg, uint32_t obj_id)
+{
+    // new objects take the version of the one creating them, unless bound
+    const WldObjectTable::Object *parent = timeline ? NULL : objects.find(obj_id);
+
+    for (size_t i = 0; i < msg.args.size(); i++)
+    {
+        const WldArg &arg = msg.args[i];
+        if (arg.type != WLD_ARG_NEWID)
+            continue;
+
+        const WldArgVal &val = args[i];
+        if (!arg.interface.empty())
+        {
+            if (arg.new_intf)
+                addObject(val.n.id, arg.new_intf, parent ? parent->version : 1);
+        }
+        else if (val.n.interface)
+        {
+            const WldInterface *intf = protocol->getInterface(val.n.interface);
+            if (intf)
+                addObject(val.n.id, intf, val.n.version);
+        }
+    }
 }
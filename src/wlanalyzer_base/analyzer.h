@@ -29,34 +29,193 @@
 #include <vector>
 #include "common.h"
 #include "xml/protocol_parser.h"
+#include "filter.h"
+#include "stats.h"
+
+class WlaMessageView;
+
+// Which interface an object id stood for at any point of a capture, points
+// being message indices. Read only once built, so threads can share it.
+class WldObjectTimeline
+{
+public:
+    WldObjectTimeline() : changes(0) {}
+
+    // the object is intf from message pos onwards, NULL once destroyed,
+    // generation tells the objects that had the id apart
+    void set(uint32_t id, const WldInterface *intf, uint32_t generation, uint64_t pos);
+    const WldInterface *find(uint32_t id, uint64_t pos, uint32_t *generation = NULL) const;
+
+    size_t getChangeCount() const { return changes; }
+
+private:
+    struct Entry
+    {
+        uint64_t pos;
+        const WldInterface *intf;
+        uint32_t generation;
+    };
+
+    typedef std::tr1::unordered_map<uint32_t, std::vector<Entry> > entries_t;
+    entries_t entries;
+    size_t changes;
+};
+
+// Live objects by id. Wayland hands out ids densely from 1 for clients
+// and from 0xff000000 for the server, each range is an array indexed by
+// the id. Ids far beyond what was handed out so far end up in a map.
+class WldObjectTable
+{
+public:
+    struct Object
+    {
+        const WldInterface *intf; // NULL while the id is free
+        uint32_t version;
+        uint32_t generation; // objects that had the id, this one included
+        uint64_t created;    // message that created it
+    };
+
+    WldObjectTable() : count(0), peak(0) {}
+
+    const Object *find(uint32_t id) const
+    {
+        const Object *obj = getSlot(id);
+        return obj && obj->intf ? obj : NULL;
+    }
+
+    void insert(uint32_t id, const WldInterface *intf, uint32_t version, uint64_t created);
+    void remove(uint32_t id);
+    // of the object with the id, or of the last one once it is destroyed,
+    // 0 if the id was never used
+    uint32_t getGeneration(uint32_t id) const
+    {
+        const Object *obj = getSlot(id);
+        return obj ? obj->generation : 0;
+    }
+    void setGeneration(uint32_t id, uint32_t generation);
+    void swap(WldObjectTable &other);
+    size_t size() const { return count; }
+    // the most objects alive at once so far
+    size_t getPeak() const { return peak; }
+    // with freed also the ids whose objects were destroyed
+    void getIds(std::vector<uint32_t> &ids, bool freed = false) const;
+
+private:
+    const Object *getSlot(uint32_t id) const
+    {
+        if (id < SERVER_ID_BASE)
+        {
+            if (id < client.size())
+                return &client[id];
+        }
+        else if (id - SERVER_ID_BASE < server.size())
+        {
+            return &server[id - SERVER_ID_BASE];
+        }
+
+        return sparse.empty() ? NULL : findSparse(id);
+    }
+    const Object *findSparse(uint32_t id) const;
+    Object *getOrAddSlot(uint32_t id);
+    void grow(std::vector<Object> &range, uint32_t base, uint32_t size);
+
+private:
+    static const uint32_t SERVER_ID_BASE = 0xff000000;
+    // how far past the highest id of a range a new one stays in the array
+    static const uint32_t MAX_DENSE_GAP = 4096;
+
+    std::vector<Object> client;
+    std::vector<Object> server;
+    typedef std::tr1::unordered_map<uint32_t, Object> sparse_t;
+    sparse_t sparse;
+    size_t count;
+    size_t peak;
+};
 
 class WldProtocolAnalyzer
 {
 public:
     WldProtocolAnalyzer();
+    // Decodes with the protocol of base and the objects of its timeline,
+    // base has to outlive it
+    WldProtocolAnalyzer(const WldProtocolAnalyzer &base, const WldObjectTimeline *timeline);
     ~WldProtocolAnalyzer();
 
     int addProtocolSpec(const std::string &path);
     int coreProtocol(const std::string &path);
-    void lookup(uint32_t object_id, uint32_t opcode, WLD_MESSAGE_TYPE type, const char *payload);
+    const WldProtocolDefinition *getProtocol() const { return protocol; }
+    void lookup(uint32_t object_id, uint32_t opcode, WLD_MESSAGE_TYPE type, const char *payload,
+                uint32_t size);
+    // Only the messages matching filter are shown from then on, it is
+    // resolved against the protocols loaded so far and has to outlive
+    // the analyzer and those decoding with it
+    int setFilter(WldArgFilter *filter);
+    const WldArgFilter *getFilter() const { return filter; }
+    // Counts every message looked up from then on, stats has to outlive the
+    // analyzer and those decoding with it
+    void setStats(WldStats *stats);
+
+    // Only follows the objects created and destroyed by the message, and
+    // records that in the timeline set with recordTimeline
+    void scan(uint32_t object_id, uint32_t opcode, WLD_MESSAGE_TYPE type, const char *payload,
+              uint32_t size);
+    // scan every message of a record
+    void scanRecord(const WlaMessageView &record);
+    void recordTimeline(WldObjectTimeline *timeline);
+    // what the id stands for right now, NULL if nothing
+    const WldInterface *getObject(uint32_t id) const { return findObject(id); }
+    // of the object the id stands for, or stood for last, 0 if none ever did
+    uint32_t getGeneration(uint32_t id) const;
+    // objects alive, and the most that were at once
+    size_t getObjectCount() const { return objects.size(); }
+    size_t getPeakObjectCount() const { return objects.getPeak(); }
+
+    // index of the next message looked up or scanned
+    void setPosition(uint64_t pos) { position = pos; }
+    uint64_t getPosition() const { return position; }
+    // capture time of the next messages looked up
+    void setTimeStamp(const timeval &time) { timestamp = time; }
+
+    // The objects and names known so far, and the position, by interface
+    // name so that they can be restored with the same protocol loaded
+    void saveState(std::vector<char> &out) const;
+    int restoreState(const char *data, size_t len);
+    // back to the start of a capture, with only the core objects
+    void resetState();
 
 private:
-    struct NewId
-    {
-        uint32_t id;
-        std::string interface;
-    };
+    const WldInterface *findObject(uint32_t id, uint32_t *generation = NULL) const;
+    void addObject(uint32_t id, const WldInterface *intf, uint32_t version);
+    void removeObject(uint32_t id);
+    const WldMessage *findMessage(const WldInterface &intf, uint32_t opcode, WLD_MESSAGE_TYPE type) const;
+    bool decodeArgs(const WldMessage &msg, const char *payload, uint32_t size);
 
-    int analyzeMessage(const WldInterface &intf, const WldMessage &msg, uint32_t obj_id, const char *payload);
-    void extractArguments(const WldMessage &msg, const char *payload);
-    bool createsObject(const WldMessage &msg);
-    NewId getNewId(const WldMessage &msg, const char *payload);
+    void formatArgs(const WldMessage &msg);
+    int analyzeMessage(const WldInterface &intf, const WldMessage &msg, uint32_t obj_id, bool show);
+    void followObjects(const WldMessage &msg, uint32_t obj_id);
+    void createObjects(const WldMessage &msg, uint32_t obj_id);
 
 private:
     WldProtocolDefinition *protocol;
+    bool owns_protocol;
+    WldInterface null_object;
+
+    // set while recording a timeline, or decoding from one
+    WldObjectTimeline *recording;
+    const WldObjectTimeline *timeline;
+    uint64_t position; // of the next message
+    uint64_t current;  // of the message being analyzed
+    // the arguments of that message, reused from one to the next
+    std::vector<WldArgVal> args;
+    std::string line; // they are formatted into
+    const WldArgFilter *filter;
+    WldStats *stats;
+    WldStatsCounters *counters; // ours, in stats
+    timeval timestamp;
+
     typedef std::tr1::unordered_map<uint32_t, std::string> names_t;
-    typedef std::tr1::unordered_map<uint32_t, WldInterface> objects_t;
-    objects_t objects;
+    // the interfaces belong to the protocol, which never moves or changes them
+    WldObjectTable objects;
     names_t names;
 };
 
@@ -0,0 +1,594 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include "message.h"
+#include "ring.h"
+#include "columns.h"
+#include "block.h"
+
+static const double FLUSH_INTERVAL = 1.0;
+static const uint32_t MAX_BLOCK_SIZE = 64 * 1024 * 1024;
+
+static double monotonic_time()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static bool write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t ret = ::write(fd, data, len);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
+
+        data += ret;
+        len -= ret;
+    }
+
+    return true;
+}
+
+int WldBlockHeader::serializeToBuf(char *buf, size_t size) const
+{
+    if (size < getSerializeSize())
+    {
+        DEBUG_LOG("buffer too small");
+        return -1;
+    }
+
+    uint32_t fields[] = { htonl(codec), htonl(flags), htonl(raw_len), htonl(comp_len), htonl(records) };
+    memcpy(buf, fields, sizeof(fields));
+
+    return getSerializeSize();
+}
+
+int WldBlockHeader::deserializeFromBuf(const char *buf, size_t size)
+{
+    if (size < getSerializeSize())
+    {
+        DEBUG_LOG("buffer too small");
+        return -1;
+    }
+
+    uint32_t fields[5];
+    memcpy(fields, buf, sizeof(fields));
+    codec = ntohl(fields[0]);
+    flags = ntohl(fields[1]);
+    raw_len = ntohl(fields[2]);
+    comp_len = ntohl(fields[3]);
+    records = ntohl(fields[4]);
+
+    return getSerializeSize();
+}
+
+WldBlockDumper::WldBlockDumper(WldCodecType codec_type, size_t block_size) :
+    block_size(block_size), filefd(-1), seq(0), current(NULL), running(false),
+    writing(false), raw_bytes(0), compressed_bytes(0), compress_time(0.0)
+{
+    codec = WldCodec::get(codec_type);
+    if (!codec)
+    {
+        Logger::getInstance()->log("Codec %d is not available, blocks will be stored uncompressed\n",
+                                   codec_type);
+        codec = WldCodec::get(WLD_CODEC_NONE);
+    }
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cond, NULL);
+}
+
+WldBlockDumper::~WldBlockDumper()
+{
+    close();
+
+    delete current;
+    for (size_t i = 0; i < spare.size(); i++)
+        delete spare[i];
+
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&lock);
+}
+
+void WldBlockDumper::close()
+{
+    timer.stop();
+
+    if (running)
+    {
+        flush();
+
+        pthread_mutex_lock(&lock);
+        running = false;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&lock);
+
+        pthread_join(writer, NULL);
+    }
+
+    if (filefd != -1)
+    {
+        ::close(filefd);
+        filefd = -1;
+    }
+
+    if (raw_bytes > 0)
+    {
+        Logger::getInstance()->log("Compressed %.2f MB into %.2f MB with %s, ratio %.2f, %.1f MB/s\n",
+                                   raw_bytes / 1048576.0, compressed_bytes / 1048576.0,
+                                   codec->getName(), (double)raw_bytes / compressed_bytes,
+                                   compress_time > 0 ? raw_bytes / 1048576.0 / compress_time : 0.0);
+        raw_bytes = 0;
+    }
+}
+
+int WldBlockDumper::open(const std::string &resource)
+{
+    if (resource.empty())
+    {
+        DEBUG_LOG("failed: empty path");
+        return -1;
+    }
+
+    if (running)
+    {
+        DEBUG_LOG("dumper already opened");
+        return -1;
+    }
+
+    filefd = ::open(resource.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (filefd == -1)
+    {
+        DEBUG_LOG("Failed to create file %s", resource.c_str());
+        perror(NULL);
+        return -1;
+    }
+
+    uint32_t file_hdr[] = { htonl(getFileMagic()), htonl(WLD_BLOCK_FILE_VERSION) };
+    if (!write_all(filefd, (const char *)file_hdr, sizeof(file_hdr)))
+    {
+        DEBUG_LOG("Failed to write the file header");
+        return -1;
+    }
+
+    current = new Block;
+    current->data.reserve(block_size);
+    current->records = 0;
+
+    running = true;
+    if (pthread_create(&writer, NULL, writerThread, this))
+    {
+        DEBUG_LOG("failed to start the writer thread");
+        running = false;
+        return -1;
+    }
+
+    timer.set<WldBlockDumper, &WldBlockDumper::timerEvent>(this);
+    timer.start(FLUSH_INTERVAL, FLUSH_INTERVAL);
+
+    return 0;
+}
+
+int WldBlockDumper::dump(WlaMessageBuffer &msg)
+{
+    if (!running)
+        return -1;
+
+    size_t len = msg.getRecordSize();
+    if (!current->data.empty() && current->data.size() + len > block_size)
+        submitBlock();
+
+    size_t pos = current->data.size();
+    current->data.resize(pos + len);
+    msg.serializeRecord(seq++, &current->data[pos], len);
+    current->records++;
+
+    return 0;
+}
+
+void WldBlockDumper::flush()
+{
+    if (!running)
+        return;
+
+    submitBlock();
+
+    pthread_mutex_lock(&lock);
+    while (!pending.empty() || writing)
+        pthread_cond_wait(&cond, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+void WldBlockDumper::timerEvent(ev::timer &timer, int revents)
+{
+    if (revents & EV_ERROR)
+    {
+        DEBUG_LOG("error");
+        return;
+    }
+
+    // don't let a quiet connection keep records out of the file forever
+    submitBlock();
+}
+
+void WldBlockDumper::submitBlock()
+{
+    if (!current || current->data.empty())
+        return;
+
+    pthread_mutex_lock(&lock);
+    while (pending.size() >= MAX_PENDING_BLOCKS)
+        pthread_cond_wait(&cond, &lock);
+
+    pending.push_back(current);
+    if (!spare.empty())
+    {
+        current = spare.back();
+        spare.pop_back();
+    }
+    else
+    {
+        current = new Block;
+        current->data.reserve(block_size);
+    }
+
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+
+    current->data.clear();
+    current->records = 0;
+}
+
+void WldBlockDumper::writeBlock(const std::vector<char> &records, uint32_t count)
+{
+    double start = monotonic_time();
+
+    WldBlockHeader hdr;
+    hdr.flags = 0;
+
+    const std::vector<char> *raw = &records;
+    if (encodeBlock(records, count, encoded))
+        raw = &encoded;
+    else
+        hdr.flags |= WLD_BLOCK_RECORDS;
+
+    size_t hdr_size = WldBlockHeader::getSerializeSize();
+    compressed.resize(hdr_size + codec->getMaxCompressedSize(raw->size()));
+
+    hdr.codec = codec->getType();
+    hdr.raw_len = raw->size();
+    hdr.records = count;
+
+    long len = codec->compress(&(*raw)[0], raw->size(), &compressed[hdr_size],
+                               compressed.size() - hdr_size);
+    compress_time += monotonic_time() - start;
+
+    if (len < 0 || (size_t)len >= raw->size())
+    {
+        hdr.codec = WLD_CODEC_NONE;
+        compressed.resize(hdr_size + raw->size());
+        memcpy(&compressed[hdr_size], &(*raw)[0], raw->size());
+        len = raw->size();
+    }
+
+    hdr.comp_len = len;
+    hdr.serializeToBuf(&compressed[0], hdr_size);
+
+    if (!write_all(filefd, &compressed[0], hdr_size + len))
+    {
+        DEBUG_LOG("failed to write block");
+        perror(NULL);
+        return;
+    }
+
+    raw_bytes += records.size();
+    compressed_bytes += hdr_size + len;
+}
+
+void *WldBlockDumper::writerThread(void *arg)
+{
+    WldBlockDumper *dumper = static_cast<WldBlockDumper *>(arg);
+
+    pthread_mutex_lock(&dumper->lock);
+    while (true)
+    {
+        while (dumper->running && dumper->pending.empty())
+            pthread_cond_wait(&dumper->cond, &dumper->lock);
+
+        if (dumper->pending.empty())
+            break;
+
+        Block *block = dumper->pending.front();
+        dumper->pending.pop_front();
+        dumper->writing = true;
+        pthread_mutex_unlock(&dumper->lock);
+
+        dumper->writeBlock(block->data, block->records);
+
+        pthread_mutex_lock(&dumper->lock);
+        dumper->writing = false;
+        dumper->spare.push_back(block);
+        pthread_cond_broadcast(&dumper->cond);
+    }
+    pthread_mutex_unlock(&dumper->lock);
+
+    return NULL;
+}
+
+WldBlockReader::WldBlockReader(bool quiet) : file(-1), offset(0), columns(false), current_pos(0),
+    current_len(0), current_flags(0), current_offset(0), failed_offset(-1), job_offset(0),
+    job_state(JOB_IDLE), running(false), quiet(quiet), raw_bytes(0), compressed_bytes(0),
+    decompress_time(0.0)
+{
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cond, NULL);
+}
+
+WldBlockReader::~WldBlockReader()
+{
+    if (running)
+    {
+        pthread_mutex_lock(&lock);
+        running = false;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&lock);
+
+        pthread_join(worker, NULL);
+    }
+
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&lock);
+
+    if (!quiet && raw_bytes > 0)
+    {
+        Logger::getInstance()->log("Decompressed %.2f MB from %.2f MB, ratio %.2f, %.1f MB/s\n",
+                                   raw_bytes / 1048576.0, compressed_bytes / 1048576.0,
+                                   (double)raw_bytes / compressed_bytes,
+                                   decompress_time > 0 ? raw_bytes / 1048576.0 / decompress_time : 0.0);
+    }
+}
+
+void WldBlockReader::setFile(int fd, off_t offset, bool columns)
+{
+    // drop the block read ahead from the old position
+    if (job_state != JOB_IDLE)
+        finishJob();
+    current_pos = current_len = 0;
+
+    file = fd;
+    this->offset = offset;
+    this->columns = columns;
+}
+
+const char *WldBlockReader::nextRecord(size_t *len)
+{
+    size_t min_size = WldRecordRing::getRecordSize(NULL);
+
+    while (true)
+    {
+        if (current_pos + min_size <= current_len)
+        {
+            const char *record = &current[current_pos];
+            size_t size = WldRecordRing::getRecordSize(record);
+            if (current_pos + size > current_len)
+            {
+                DEBUG_LOG("record crosses the block boundary");
+                current_pos = current_len;
+                continue;
+            }
+
+            current_pos += size;
+            *len = size;
+            return record;
+        }
+
+        if (!loadBlock())
+            return NULL;
+    }
+}
+
+const char *WldBlockReader::nextBlock(size_t *len)
+{
+    while (current_pos >= current_len)
+    {
+        if (!loadBlock())
+            return NULL;
+    }
+
+    const char *block = &current[current_pos];
+    *len = current_len - current_pos;
+    current_pos = current_len;
+
+    return block;
+}
+
+bool WldBlockReader::loadBlock()
+{
+    if (job_state == JOB_IDLE)
+    {
+        if (!readBlock())
+            return false;
+        startJob();
+    }
+
+    bool ok = finishJob();
+
+    // decompress the following block while the caller parses this one
+    if (readBlock())
+        startJob();
+
+    if (!ok)
+    {
+        if (!quiet)
+            Logger::getInstance()->log("Failed to decode the block at %ld, skipping it\n", current_offset);
+        if (failed_offset == -1)
+            failed_offset = current_offset;
+    }
+
+    return true;
+}
+
+bool WldBlockReader::readBlock()
+{
+    if (file == -1)
+        return false;
+
+    size_t hdr_size = WldBlockHeader::getSerializeSize();
+    char buf[32];
+    if (pread(file, buf, hdr_size, offset) != (ssize_t)hdr_size)
+        return false;
+
+    job_hdr.deserializeFromBuf(buf, hdr_size);
+    if (job_hdr.raw_len > MAX_BLOCK_SIZE || job_hdr.comp_len > MAX_BLOCK_SIZE)
+    {
+        DEBUG_LOG("invalid block header at %ld", offset);
+        return false;
+    }
+
+    job_in.resize(job_hdr.comp_len);
+    if (job_hdr.comp_len > 0 &&
+            pread(file, &job_in[0], job_hdr.comp_len, offset + hdr_size) != (ssize_t)job_hdr.comp_len)
+        return false;
+
+    job_offset = offset;
+    offset += hdr_size + job_hdr.comp_len;
+
+    return true;
+}
+
+void WldBlockReader::startJob()
+{
+    if (!running)
+    {
+        running = true;
+        if (pthread_create(&worker, NULL, workerThread, this))
+        {
+            DEBUG_LOG("failed to start the worker thread");
+            running = false;
+        }
+    }
+
+    pthread_mutex_lock(&lock);
+    job_state = JOB_QUEUED;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+
+    // without a worker thread just do the work here
+    if (!running)
+        job_state = decodeJob() ? JOB_DONE : JOB_FAILED;
+}
+
+bool WldBlockReader::decodeJob()
+{
+    const WldCodec *codec = WldCodec::get((WldCodecType)job_hdr.codec);
+    if (!codec || job_hdr.raw_len == 0 || job_in.empty())
+        return false;
+
+    job_out.resize(job_hdr.raw_len);
+    long len = codec->decompress(&job_in[0], job_in.size(), &job_out[0], job_out.size());
+    if (len != (long)job_hdr.raw_len)
+        return false;
+
+    if (columns && !(job_hdr.flags & WLD_BLOCK_RECORDS))
+    {
+        WldColumnBlock block;
+        if (block.decode(&job_out[0], job_out.size()) || block.toRecords(job_records))
+            return false;
+
+        job_out.swap(job_records);
+        job_hdr.raw_len = job_out.size();
+    }
+
+    return true;
+}
+
+bool WldBlockReader::finishJob()
+{
+    pthread_mutex_lock(&lock);
+    while (job_state == JOB_QUEUED)
+        pthread_cond_wait(&cond, &lock);
+
+    bool ok = job_state == JOB_DONE;
+    job_state = JOB_IDLE;
+    pthread_mutex_unlock(&lock);
+
+    current_pos = 0;
+    current_len = 0;
+    current_offset = job_offset;
+    if (ok)
+    {
+        current.swap(job_out);
+        current_len = job_hdr.raw_len;
+        current_flags = job_hdr.flags;
+    }
+
+    return ok;
+}
+
+void *WldBlockReader::workerThread(void *arg)
+{
+    WldBlockReader *reader = static_cast<WldBlockReader *>(arg);
+
+    pthread_mutex_lock(&reader->lock);
+    while (true)
+    {
+        while (reader->running && reader->job_state != JOB_QUEUED)
+            pthread_cond_wait(&reader->cond, &reader->lock);
+
+        if (!reader->running)
+            break;
+        pthread_mutex_unlock(&reader->lock);
+
+        double start = monotonic_time();
+        bool ok = reader->decodeJob();
+        double elapsed = monotonic_time() - start;
+
+        pthread_mutex_lock(&reader->lock);
+        if (ok)
+        {
+            reader->job_state = JOB_DONE;
+            reader->raw_bytes += reader->job_hdr.raw_len;
+            reader->compressed_bytes += reader->job_hdr.comp_len;
+            reader->decompress_time += elapsed;
+        }
+        else
+            reader->job_state = JOB_FAILED;
+        pthread_cond_broadcast(&reader->cond);
+    }
+    pthread_mutex_unlock(&reader->lock);
+
+    return NULL;
+}
@@ -0,0 +1,205 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <pthread.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include <ev++.h>
+#include "codec.h"
+#include "dumper.h"
+
+// Block capture files start with the magic and version, followed by
+// blocks: a WldBlockHeader and the compressed bytes of a run of regular
+// dump records. All header fields are in network byte order.
+const uint32_t WLD_BLOCK_FILE_MAGIC = 0x574c4443; // "WLDC"
+const uint32_t WLD_COLUMN_FILE_MAGIC = 0x574c444b; // "WLDK", see columns.h
+const uint32_t WLD_BLOCK_FILE_VERSION = 3;
+const size_t WLD_BLOCK_FILE_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+// The block holds the records as they are, in a columnar file too
+const uint32_t WLD_BLOCK_RECORDS = 0x01;
+
+struct WldBlockHeader
+{
+    int serializeToBuf(char *buf, size_t size) const;
+    int deserializeFromBuf(const char *buf, size_t size);
+
+    static size_t getSerializeSize()
+    {
+        return sizeof(codec) + sizeof(flags) + sizeof(raw_len) + sizeof(comp_len) + sizeof(records);
+    }
+
+    uint32_t codec;
+    uint32_t flags;
+    uint32_t raw_len;
+    uint32_t comp_len;
+    uint32_t records;
+};
+
+// Collects records into blocks on the forwarding thread and leaves the
+// compression and the writing to a worker thread.
+class WldBlockDumper : public WldDumper
+{
+public:
+    WldBlockDumper(WldCodecType codec = WLD_CODEC_LZ, size_t block_size = DEFAULT_BLOCK_SIZE);
+    virtual ~WldBlockDumper();
+
+    virtual int open(const std::string &resource);
+    virtual int dump(WlaMessageBuffer &msg);
+    virtual void flush();
+
+    // Writes out the records left and stops the writer thread. Subclasses
+    // overriding encodeBlock() have to call it from their destructor, the
+    // writer can't use them anymore once the base destructor runs.
+    void close();
+
+protected:
+    // Called on the writer thread before compression. Returns false to
+    // store the records as they are.
+    virtual bool encodeBlock(const std::vector<char> &records, uint32_t count,
+                             std::vector<char> &out)
+    {
+        return false;
+    }
+    virtual uint32_t getFileMagic() const { return WLD_BLOCK_FILE_MAGIC; }
+
+private:
+    void timerEvent(ev::timer &timer, int revents);
+    void submitBlock();
+    void writeBlock(const std::vector<char> &raw, uint32_t records);
+    static void *writerThread(void *arg);
+
+private:
+    static const size_t DEFAULT_BLOCK_SIZE = 256 * 1024;
+    static const size_t MAX_PENDING_BLOCKS = 16;
+
+    struct Block
+    {
+        std::vector<char> data;
+        uint32_t records;
+    };
+
+    const WldCodec *codec;
+    size_t block_size;
+    int filefd;
+    uint32_t seq;
+
+    Block *current;
+    std::deque<Block *> pending;
+    std::vector<Block *> spare;
+    std::vector<char> encoded;
+    std::vector<char> compressed;
+
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool running;
+    bool writing;
+
+    ev::timer timer;
+
+    uint64_t raw_bytes;
+    uint64_t compressed_bytes;
+    double compress_time;
+};
+
+// Reads the blocks of a capture file and decompresses the next one on a
+// worker thread while the caller parses the records of the current one.
+class WldBlockReader
+{
+public:
+    // a quiet reader logs neither the blocks it fails to decode nor its
+    // decompression stats
+    explicit WldBlockReader(bool quiet = false);
+    ~WldBlockReader();
+
+    // Blocks of a columnar file are turned back into records on the worker
+    // thread when columns is set. It can be called again to read from
+    // another block on.
+    void setFile(int fd, off_t offset, bool columns = false);
+
+    // Return the next record or the rest of the current block, NULL when no
+    // complete block is available. The data stays valid until the next call.
+    const char *nextRecord(size_t *len);
+    const char *nextBlock(size_t *len);
+    // WldBlockHeader flags and file offset of the block returned last
+    uint32_t getBlockFlags() const { return current_flags; }
+    off_t getBlockOffset() const { return current_offset; }
+    // Where the next block would start: the size of a complete file once
+    // the last block was returned, a corrupt or truncated one stops earlier
+    off_t getOffset() const { return offset; }
+    // the first block that could not be decoded and was skipped, -1 if none
+    off_t getFailedOffset() const { return failed_offset; }
+
+private:
+    bool loadBlock();
+    bool readBlock();
+    void startJob();
+    bool finishJob();
+    bool decodeJob();
+    static void *workerThread(void *arg);
+
+private:
+    enum JobState
+    {
+        JOB_IDLE,
+        JOB_QUEUED,
+        JOB_DONE,
+        JOB_FAILED
+    };
+
+    int file;
+    off_t offset;
+    bool columns;
+
+    std::vector<char> current;
+    size_t current_pos;
+    size_t current_len;
+    uint32_t current_flags;
+    off_t current_offset;
+    off_t failed_offset;
+
+    WldBlockHeader job_hdr;
+    off_t job_offset;
+    std::vector<char> job_in;
+    std::vector<char> job_out;
+    std::vector<char> job_records;
+    JobState job_state;
+
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool running;
+
+    bool quiet;
+    uint64_t raw_bytes;
+    uint64_t compressed_bytes;
+    double decompress_time;
+};
+
+#endif // BLOCK_H
@@ -0,0 +1,122 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "checkpoint.h"
+
+int WldCheckpoints::load(const std::string &capture)
+{
+    checkpoints.clear();
+
+    uint32_t stamp[4];
+    std::vector<char> data;
+    std::string path = capture + WLD_CHECKPOINT_SUFFIX;
+    if (!getFileStamp(capture, stamp) || readFile(path, data))
+        return -1;
+
+    const char *p = data.empty() ? NULL : &data[0];
+    const char *end = p + data.size();
+    uint32_t val[7];
+    for (int i = 0; i < 7; i++)
+    {
+        if (!getUInt32(p, end, &val[i]))
+            return -1;
+    }
+
+    if (val[0] != WLD_CHECKPOINT_MAGIC || val[1] != WLD_CHECKPOINT_VERSION ||
+            memcmp(&val[2], stamp, sizeof(stamp)))
+    {
+        DEBUG_LOG("%s is outdated", path.c_str());
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < val[6]; i++)
+    {
+        uint32_t state_len;
+        Checkpoint checkpoint;
+        if (!getUInt64(p, end, &checkpoint.offset) || !getUInt32(p, end, &checkpoint.seq) ||
+                !getUInt32(p, end, &state_len) || (size_t)(end - p) < state_len)
+        {
+            checkpoints.clear();
+            return -1;
+        }
+
+        checkpoint.state.assign(p, p + state_len);
+        p += state_len;
+        checkpoints.push_back(checkpoint);
+    }
+
+    return 0;
+}
+
+int WldCheckpoints::save(const std::string &capture) const
+{
+    uint32_t stamp[4];
+    if (!getFileStamp(capture, stamp))
+        return -1;
+
+    std::vector<char> data;
+    putUInt32(data, WLD_CHECKPOINT_MAGIC);
+    putUInt32(data, WLD_CHECKPOINT_VERSION);
+    for (int i = 0; i < 4; i++)
+        putUInt32(data, stamp[i]);
+    putUInt32(data, checkpoints.size());
+
+    for (size_t i = 0; i < checkpoints.size(); i++)
+    {
+        const Checkpoint &checkpoint = checkpoints[i];
+        putUInt64(data, checkpoint.offset);
+        putUInt32(data, checkpoint.seq);
+        putUInt32(data, checkpoint.state.size());
+        data.insert(data.end(), checkpoint.state.begin(), checkpoint.state.end());
+    }
+
+    return writeFile(capture + WLD_CHECKPOINT_SUFFIX, data);
+}
+
+void WldCheckpoints::add(uint64_t offset, uint32_t seq, const std::vector<char> &state)
+{
+    Checkpoint checkpoint;
+    checkpoint.offset = offset;
+    checkpoint.seq = seq;
+    checkpoint.state = state;
+
+    checkpoints.push_back(checkpoint);
+}
+
+const WldCheckpoints::Checkpoint *WldCheckpoints::find(uint32_t seq) const
+{
+    size_t lo = 0;
+    size_t hi = checkpoints.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (checkpoints[mid].seq <= seq)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo ? &checkpoints[lo - 1] : NULL;
+}
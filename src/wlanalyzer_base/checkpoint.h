@@ -0,0 +1,64 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include "common.h"
+
+const uint32_t WLD_CHECKPOINT_MAGIC = 0x574c4450; // "WLDP"
+const uint32_t WLD_CHECKPOINT_VERSION = 4;
+const char WLD_CHECKPOINT_SUFFIX[] = ".ckpt";
+
+// Snapshots of the analyzer state taken every so often while scanning a
+// capture, kept next to it in <capture>.ckpt. Decoding from the middle of
+// a capture then only replays what follows the nearest one. The sidecar
+// is only used as long as the size and mtime of the capture match.
+// Offsets are into the file: of a record for record captures, of the block
+// the checkpoint was taken at for block captures.
+class WldCheckpoints
+{
+public:
+    struct Checkpoint
+    {
+        uint64_t offset;
+        uint32_t seq;
+        std::vector<char> state;
+    };
+
+    int load(const std::string &capture);
+    int save(const std::string &capture) const;
+
+    void add(uint64_t offset, uint32_t seq, const std::vector<char> &state);
+    // the last one taken at or before seq, NULL if none
+    const Checkpoint *find(uint32_t seq) const;
+    size_t size() const { return checkpoints.size(); }
+
+private:
+    std::vector<Checkpoint> checkpoints;
+};
+
+#endif // CHECKPOINT_H
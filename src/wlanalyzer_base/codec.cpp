@@ -0,0 +1,264 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include "common.h"
+#include "codec.h"
+
+static WldNullCodec null_codec;
+static WldLzCodec lz_codec;
+#ifdef HAVE_ZLIB
+static WldZlibCodec zlib_codec;
+#endif
+
+const WldCodec *WldCodec::get(WldCodecType type)
+{
+    switch (type)
+    {
+    case WLD_CODEC_NONE:
+        return &null_codec;
+    case WLD_CODEC_LZ:
+        return &lz_codec;
+#ifdef HAVE_ZLIB
+    case WLD_CODEC_ZLIB:
+        return &zlib_codec;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+const WldCodec *WldCodec::get(const std::string &name)
+{
+    for (int i = 0; i < WLD_CODEC_COUNT; i++)
+    {
+        const WldCodec *codec = get((WldCodecType)i);
+        if (codec && name == codec->getName())
+            return codec;
+    }
+
+    return NULL;
+}
+
+long WldNullCodec::compress(const char *src, size_t len, char *dst, size_t size) const
+{
+    if (len > size)
+        return -1;
+
+    memcpy(dst, src, len);
+
+    return len;
+}
+
+long WldNullCodec::decompress(const char *src, size_t len, char *dst, size_t size) const
+{
+    return compress(src, len, dst, size);
+}
+
+static inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t val;
+    memcpy(&val, p, sizeof(val));
+
+    return val;
+}
+
+static inline unsigned char *writeLength(unsigned char *op, size_t len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = len;
+
+    return op;
+}
+
+long WldLzCodec::compress(const char *src, size_t len, char *dst, size_t size) const
+{
+    if (size < getMaxCompressedSize(len))
+        return -1;
+
+    const unsigned char *in = (const unsigned char *)src;
+    unsigned char *op = (unsigned char *)dst;
+
+    // positions are stored off by one so that zero means empty
+    uint32_t table[1 << HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    size_t ip = 0;
+    size_t anchor = 0;
+    size_t limit = len > MIN_MATCH + LAST_LITERALS ? len - MIN_MATCH - LAST_LITERALS : 0;
+
+    while (ip < limit)
+    {
+        uint32_t seq = read32(in + ip);
+        uint32_t h = (seq * 2654435761U) >> (32 - HASH_BITS);
+        size_t ref = table[h];
+        table[h] = ip + 1;
+
+        if (!ref || ip - (ref - 1) > MAX_OFFSET || read32(in + ref - 1) != seq)
+        {
+            ip++;
+            continue;
+        }
+        ref--;
+
+        size_t match = MIN_MATCH;
+        while (ip + match < len - LAST_LITERALS && in[ref + match] == in[ip + match])
+            match++;
+
+        size_t literals = ip - anchor;
+        unsigned char *token = op++;
+        *token = (literals < 15 ? literals : 15) << 4;
+        if (literals >= 15)
+            op = writeLength(op, literals - 15);
+        memcpy(op, in + anchor, literals);
+        op += literals;
+
+        uint16_t offset = ip - ref;
+        *op++ = offset & 0xff;
+        *op++ = offset >> 8;
+
+        size_t extra = match - MIN_MATCH;
+        *token |= extra < 15 ? extra : 15;
+        if (extra >= 15)
+            op = writeLength(op, extra - 15);
+
+        ip += match;
+        anchor = ip;
+    }
+
+    size_t literals = len - anchor;
+    *op++ = (literals < 15 ? literals : 15) << 4;
+    if (literals >= 15)
+        op = writeLength(op, literals - 15);
+    memcpy(op, in + anchor, literals);
+    op += literals;
+
+    return op - (unsigned char *)dst;
+}
+
+long WldLzCodec::decompress(const char *src, size_t len, char *dst, size_t size) const
+{
+    const unsigned char *ip = (const unsigned char *)src;
+    const unsigned char *iend = ip + len;
+    unsigned char *op = (unsigned char *)dst;
+    unsigned char *oend = op + size;
+
+    while (ip < iend)
+    {
+        unsigned int token = *ip++;
+
+        size_t literals = token >> 4;
+        if (literals == 15)
+        {
+            unsigned char b;
+            do
+            {
+                if (ip >= iend)
+                    return -1;
+                b = *ip++;
+                literals += b;
+            } while (b == 255);
+        }
+
+        if (literals > (size_t)(iend - ip) || literals > (size_t)(oend - op))
+            return -1;
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+
+        // the last sequence carries literals only
+        if (ip >= iend)
+            break;
+
+        if (iend - ip < 2)
+            return -1;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - (unsigned char *)dst))
+            return -1;
+
+        size_t match = token & 15;
+        if (match == 15)
+        {
+            unsigned char b;
+            do
+            {
+                if (ip >= iend)
+                    return -1;
+                b = *ip++;
+                match += b;
+            } while (b == 255);
+        }
+        match += MIN_MATCH;
+
+        if (match > (size_t)(oend - op))
+            return -1;
+
+        const unsigned char *ref = op - offset;
+        if (offset >= match)
+        {
+            memcpy(op, ref, match);
+            op += match;
+        }
+        else
+        {
+            while (match--)
+                *op++ = *ref++;
+        }
+    }
+
+    return op - (unsigned char *)dst;
+}
+
+#ifdef HAVE_ZLIB
+size_t WldZlibCodec::getMaxCompressedSize(size_t len) const
+{
+    return compressBound(len);
+}
+
+long WldZlibCodec::compress(const char *src, size_t len, char *dst, size_t size) const
+{
+    uLongf dst_len = size;
+    if (compress2((Bytef *)dst, &dst_len, (const Bytef *)src, len, Z_BEST_SPEED) != Z_OK)
+        return -1;
+
+    return dst_len;
+}
+
+long WldZlibCodec::decompress(const char *src, size_t len, char *dst, size_t size) const
+{
+    uLongf dst_len = size;
+    if (uncompress((Bytef *)dst, &dst_len, (const Bytef *)src, len) != Z_OK)
+        return -1;
+
+    return dst_len;
+}
+#endif // HAVE_ZLIB
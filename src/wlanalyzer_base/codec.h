@@ -0,0 +1,102 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+enum WldCodecType
+{
+    WLD_CODEC_NONE,
+    WLD_CODEC_LZ,
+    WLD_CODEC_ZLIB,
+    WLD_CODEC_COUNT
+};
+
+// Codecs are stateless, the instances returned by get() can be shared
+// between threads.
+class WldCodec
+{
+public:
+    virtual ~WldCodec() {}
+
+    virtual WldCodecType getType() const = 0;
+    virtual const char *getName() const = 0;
+    virtual size_t getMaxCompressedSize(size_t len) const = 0;
+
+    // both return the number of bytes written to dst or -1 on error
+    virtual long compress(const char *src, size_t len, char *dst, size_t size) const = 0;
+    virtual long decompress(const char *src, size_t len, char *dst, size_t size) const = 0;
+
+    static const WldCodec *get(WldCodecType type);
+    static const WldCodec *get(const std::string &name);
+};
+
+class WldNullCodec : public WldCodec
+{
+public:
+    WldCodecType getType() const { return WLD_CODEC_NONE; }
+    const char *getName() const { return "none"; }
+    size_t getMaxCompressedSize(size_t len) const { return len; }
+
+    long compress(const char *src, size_t len, char *dst, size_t size) const;
+    long decompress(const char *src, size_t len, char *dst, size_t size) const;
+};
+
+// Byte oriented LZ77 using the LZ4 block layout: a token with 4-bit literal
+// and match lengths, the literals, a 16-bit offset and length extensions.
+class WldLzCodec : public WldCodec
+{
+public:
+    WldCodecType getType() const { return WLD_CODEC_LZ; }
+    const char *getName() const { return "lz"; }
+    size_t getMaxCompressedSize(size_t len) const { return len + len / 255 + 16; }
+
+    long compress(const char *src, size_t len, char *dst, size_t size) const;
+    long decompress(const char *src, size_t len, char *dst, size_t size) const;
+
+private:
+    static const int HASH_BITS = 12;
+    static const size_t MIN_MATCH = 4;
+    static const size_t LAST_LITERALS = 5;
+    static const size_t MAX_OFFSET = 65535;
+};
+
+#ifdef HAVE_ZLIB
+class WldZlibCodec : public WldCodec
+{
+public:
+    WldCodecType getType() const { return WLD_CODEC_ZLIB; }
+    const char *getName() const { return "zlib"; }
+    size_t getMaxCompressedSize(size_t len) const;
+
+    long compress(const char *src, size_t len, char *dst, size_t size) const;
+    long decompress(const char *src, size_t len, char *dst, size_t size) const;
+};
+#endif // HAVE_ZLIB
+
+#endif // CODEC_H
@@ -0,0 +1,614 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <string.h>
+#include "message.h"
+#include "columns.h"
+
+namespace {
+
+const size_t BLOCK_HEADER_FIELDS = 3 + WldColumnBlock::COLUMN_COUNT;
+const size_t BLOCK_HEADER_SIZE = BLOCK_HEADER_FIELDS * sizeof(uint32_t);
+const size_t WL_HEADER_SIZE = 2 * sizeof(uint32_t);
+const size_t RECORD_HEADER_SIZE = 6 * sizeof(uint32_t);
+const int64_t USEC_PER_SEC = 1000000;
+
+uint32_t get_nbo(const char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return ntohl(v);
+}
+
+void put_nbo(char *p, uint32_t v)
+{
+    v = htonl(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+// returns the number of bytes consumed, 0 on a truncated or overlong varint
+size_t get_varint(const char *p, size_t len, uint64_t *value)
+{
+    uint64_t v = 0;
+    for (size_t i = 0; i < len && i < 10; i++)
+    {
+        unsigned char b = p[i];
+        v |= (uint64_t)(b & 0x7f) << (7 * i);
+        if (!(b & 0x80))
+        {
+            *value = v;
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+} // namespace
+
+WldColumnBlock::WldColumnBlock() : records(0), messages(0), dict_count(0), decoded(0)
+{
+    memset(columns, 0, sizeof(columns));
+    memset(lengths, 0, sizeof(lengths));
+}
+
+int WldColumnBlock::decode(const char *data, size_t len)
+{
+    decoded = 0;
+    if (len < BLOCK_HEADER_SIZE)
+    {
+        DEBUG_LOG("column block too short");
+        return -1;
+    }
+
+    records = get_nbo(data);
+    messages = get_nbo(data + 4);
+    dict_count = get_nbo(data + 8);
+
+    size_t pos = BLOCK_HEADER_SIZE;
+    for (int i = 0; i < COLUMN_COUNT; i++)
+    {
+        lengths[i] = get_nbo(data + 12 + 4 * i);
+        if (lengths[i] > len - pos)
+        {
+            DEBUG_LOG("column %d exceeds the block", i);
+            return -1;
+        }
+        columns[i] = data + pos;
+        pos += lengths[i];
+    }
+
+    // every entry takes at least one byte, this also bounds the allocations
+    if (lengths[COLUMN_SEQS] < records || lengths[COLUMN_KEYS] < messages ||
+            lengths[COLUMN_DICT] < 2 * (size_t)dict_count)
+    {
+        DEBUG_LOG("invalid column block header");
+        return -1;
+    }
+
+    return 0;
+}
+
+const char *WldColumnBlock::getColumn(Column column, size_t *len) const
+{
+    *len = lengths[column];
+    return columns[column];
+}
+
+bool WldColumnBlock::decodeVarints(const char *p, size_t len, uint32_t *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t v;
+        size_t n = get_varint(p, len, &v);
+        if (!n || v > UINT32_MAX)
+            return false;
+        out[i] = v;
+        p += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+bool WldColumnBlock::decodeDeltas(const char *p, size_t len, int64_t *out, size_t count)
+{
+    int64_t prev = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t v;
+        size_t n = get_varint(p, len, &v);
+        if (!n)
+            return false;
+        prev += (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+        out[i] = prev;
+        p += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+#define DECODED(column) (1u << (column))
+
+const uint32_t *WldColumnBlock::getSeqs()
+{
+    if (!(decoded & DECODED(COLUMN_SEQS)))
+    {
+        std::vector<int64_t> deltas(records);
+        if (records && !decodeDeltas(columns[COLUMN_SEQS], lengths[COLUMN_SEQS],
+                                     &deltas[0], records))
+            return NULL;
+        seqs.assign(deltas.begin(), deltas.end());
+        decoded |= DECODED(COLUMN_SEQS);
+    }
+
+    return records ? &seqs[0] : NULL;
+}
+
+const int64_t *WldColumnBlock::getTimestamps()
+{
+    if (!(decoded & DECODED(COLUMN_TIMESTAMPS)))
+    {
+        timestamps.resize(records);
+        if (records && !decodeDeltas(columns[COLUMN_TIMESTAMPS], lengths[COLUMN_TIMESTAMPS],
+                                     &timestamps[0], records))
+            return NULL;
+        decoded |= DECODED(COLUMN_TIMESTAMPS);
+    }
+
+    return records ? &timestamps[0] : NULL;
+}
+
+const uint32_t *WldColumnBlock::getFlags()
+{
+    if (!(decoded & DECODED(COLUMN_FLAGS)))
+    {
+        flags.resize(records);
+        if (records && !decodeVarints(columns[COLUMN_FLAGS], lengths[COLUMN_FLAGS],
+                                      &flags[0], records))
+            return NULL;
+        decoded |= DECODED(COLUMN_FLAGS);
+    }
+
+    return records ? &flags[0] : NULL;
+}
+
+bool WldColumnBlock::decodeCounts()
+{
+    if (decoded & DECODED(COLUMN_COUNTS))
+        return true;
+
+    std::vector<uint32_t> counts(3 * (size_t)records);
+    if (records && !decodeVarints(columns[COLUMN_COUNTS], lengths[COLUMN_COUNTS],
+                                  &counts[0], counts.size()))
+        return false;
+
+    msg_counts.resize(records);
+    tail_lens.resize(records);
+    cmsg_lens.resize(records);
+    for (uint32_t i = 0; i < records; i++)
+    {
+        msg_counts[i] = counts[3 * i];
+        tail_lens[i] = counts[3 * i + 1];
+        cmsg_lens[i] = counts[3 * i + 2];
+    }
+
+    decoded |= DECODED(COLUMN_COUNTS);
+    return true;
+}
+
+const uint32_t *WldColumnBlock::getMessageCounts()
+{
+    if (!decodeCounts())
+        return NULL;
+
+    return records ? &msg_counts[0] : NULL;
+}
+
+const uint32_t *WldColumnBlock::getKeys()
+{
+    if (!(decoded & DECODED(COLUMN_KEYS)))
+    {
+        keys.resize(messages);
+        if (messages && !decodeVarints(columns[COLUMN_KEYS], lengths[COLUMN_KEYS],
+                                       &keys[0], messages))
+            return NULL;
+
+        for (uint32_t i = 0; i < messages; i++)
+        {
+            if (keys[i] >= dict_count)
+                return NULL;
+        }
+        decoded |= DECODED(COLUMN_KEYS);
+    }
+
+    return messages ? &keys[0] : NULL;
+}
+
+const uint32_t *WldColumnBlock::getSizes()
+{
+    if (!(decoded & DECODED(COLUMN_SIZES)))
+    {
+        sizes.resize(messages);
+        if (messages && !decodeVarints(columns[COLUMN_SIZES], lengths[COLUMN_SIZES],
+                                       &sizes[0], messages))
+            return NULL;
+        decoded |= DECODED(COLUMN_SIZES);
+    }
+
+    return messages ? &sizes[0] : NULL;
+}
+
+bool WldColumnBlock::decodeDict()
+{
+    if (decoded & DECODED(COLUMN_DICT))
+        return true;
+
+    std::vector<uint32_t> pairs(2 * (size_t)dict_count);
+    if (dict_count && !decodeVarints(columns[COLUMN_DICT], lengths[COLUMN_DICT],
+                                     &pairs[0], pairs.size()))
+        return false;
+
+    dict_objects.resize(dict_count);
+    dict_opcodes.resize(dict_count);
+    for (uint32_t i = 0; i < dict_count; i++)
+    {
+        dict_objects[i] = pairs[2 * i];
+        dict_opcodes[i] = pairs[2 * i + 1];
+    }
+
+    decoded |= DECODED(COLUMN_DICT);
+    return true;
+}
+
+const uint32_t *WldColumnBlock::getDictObjects()
+{
+    if (!decodeDict())
+        return NULL;
+
+    return dict_count ? &dict_objects[0] : NULL;
+}
+
+const uint32_t *WldColumnBlock::getDictOpcodes()
+{
+    if (!decodeDict())
+        return NULL;
+
+    return dict_count ? &dict_opcodes[0] : NULL;
+}
+
+int WldColumnBlock::countKeys(std::vector<uint32_t> &counts)
+{
+    const uint32_t *k = getKeys();
+    if (!k && messages)
+        return -1;
+
+    if (counts.size() < dict_count)
+        counts.resize(dict_count);
+
+    uint32_t *c = counts.empty() ? NULL : &counts[0];
+    for (uint32_t i = 0; i < messages; i++)
+        c[k[i]]++;
+
+    return 0;
+}
+
+int WldColumnBlock::toRecords(std::vector<char> &out)
+{
+    const uint32_t *s = getSeqs();
+    const int64_t *ts = getTimestamps();
+    const uint32_t *f = getFlags();
+    const uint32_t *k = getKeys();
+    const uint32_t *sz = getSizes();
+    if (!decodeCounts() || !decodeDict() ||
+            (records && (!s || !ts || !f)) || (messages && (!k || !sz)))
+    {
+        DEBUG_LOG("corrupted column block");
+        return -1;
+    }
+
+    out.clear();
+    out.reserve(records * RECORD_HEADER_SIZE + lengths[COLUMN_PAYLOAD] +
+                messages * WL_HEADER_SIZE + lengths[COLUMN_CONTROL]);
+
+    const char *payload = columns[COLUMN_PAYLOAD];
+    size_t payload_left = lengths[COLUMN_PAYLOAD];
+    const char *control = columns[COLUMN_CONTROL];
+    size_t control_left = lengths[COLUMN_CONTROL];
+    uint32_t msg = 0;
+
+    for (uint32_t i = 0; i < records; i++)
+    {
+        if (msg_counts[i] > messages - msg)
+            return -1;
+
+        size_t msg_len = tail_lens[i];
+        for (uint32_t j = 0; j < msg_counts[i]; j++)
+        {
+            if (sz[msg + j] < WL_HEADER_SIZE)
+                return -1;
+            msg_len += sz[msg + j];
+        }
+
+        if (msg_len - msg_counts[i] * WL_HEADER_SIZE > payload_left ||
+                cmsg_lens[i] > control_left)
+            return -1;
+
+        size_t pos = out.size();
+        out.resize(pos + RECORD_HEADER_SIZE + msg_len + cmsg_lens[i]);
+        char *p = &out[pos];
+
+        memcpy(p, &s[i], sizeof(uint32_t));
+        put_nbo(p + 4, f[i]);
+        put_nbo(p + 8, ts[i] / USEC_PER_SEC);
+        put_nbo(p + 12, ts[i] % USEC_PER_SEC);
+        put_nbo(p + 16, msg_len);
+        put_nbo(p + 20, cmsg_lens[i]);
+        p += RECORD_HEADER_SIZE;
+
+        for (uint32_t j = 0; j < msg_counts[i]; j++, msg++)
+        {
+            uint32_t words[2] = { dict_objects[k[msg]], (sz[msg] << 16) | dict_opcodes[k[msg]] };
+            memcpy(p, words, sizeof(words));
+            p += sizeof(words);
+
+            size_t body = sz[msg] - WL_HEADER_SIZE;
+            memcpy(p, payload, body);
+            p += body;
+            payload += body;
+            payload_left -= body;
+        }
+
+        memcpy(p, payload, tail_lens[i]);
+        p += tail_lens[i];
+        payload += tail_lens[i];
+        payload_left -= tail_lens[i];
+
+        memcpy(p, control, cmsg_lens[i]);
+        control += cmsg_lens[i];
+        control_left -= cmsg_lens[i];
+    }
+
+    return 0;
+}
+
+void WldColumnEncoder::clear()
+{
+    for (int i = 0; i < WldColumnBlock::COLUMN_COUNT; i++)
+        columns[i].clear();
+    dict.clear();
+    messages = 0;
+}
+
+void WldColumnEncoder::putVarint(std::vector<char> &column, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        column.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    column.push_back((char)value);
+}
+
+void WldColumnEncoder::putDelta(std::vector<char> &column, int64_t delta)
+{
+    putVarint(column, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+}
+
+uint32_t WldColumnEncoder::getKey(uint32_t object, uint32_t opcode)
+{
+    uint64_t pair = ((uint64_t)object << 16) | opcode;
+    dict_t::iterator it = dict.find(pair);
+    if (it != dict.end())
+        return it->second;
+
+    uint32_t key = dict.size();
+    dict[pair] = key;
+    putVarint(columns[WldColumnBlock::COLUMN_DICT], object);
+    putVarint(columns[WldColumnBlock::COLUMN_DICT], opcode);
+
+    return key;
+}
+
+int WldColumnEncoder::encode(const char *records, size_t len, uint32_t count,
+                             std::vector<char> &out)
+{
+    clear();
+
+    std::vector<char> *c = columns;
+    int64_t prev_seq = 0;
+    int64_t prev_ts = 0;
+    const char *p = records;
+    const char *end = records + len;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if ((size_t)(end - p) < RECORD_HEADER_SIZE)
+        {
+            DEBUG_LOG("truncated record");
+            return -1;
+        }
+
+        uint32_t seq;
+        memcpy(&seq, p, sizeof(seq));
+        uint32_t flags = get_nbo(p + 4);
+        int64_t ts = get_nbo(p + 8) * USEC_PER_SEC + get_nbo(p + 12);
+        uint32_t msg_len = get_nbo(p + 16);
+        uint32_t cmsg_len = get_nbo(p + 20);
+        p += RECORD_HEADER_SIZE;
+
+        if ((size_t)(end - p) < (size_t)msg_len + cmsg_len)
+        {
+            DEBUG_LOG("truncated record");
+            return -1;
+        }
+
+        putDelta(c[WldColumnBlock::COLUMN_SEQS], (int64_t)seq - prev_seq);
+        putDelta(c[WldColumnBlock::COLUMN_TIMESTAMPS], ts - prev_ts);
+        putVarint(c[WldColumnBlock::COLUMN_FLAGS], flags);
+        prev_seq = seq;
+        prev_ts = ts;
+
+        // the payload holds whole wayland messages, anything that doesn't
+        // parse as one is kept as trailing bytes
+        const char *msg = p;
+        uint32_t left = msg_len;
+        uint32_t msg_count = 0;
+        while (left >= WL_HEADER_SIZE)
+        {
+            uint32_t words[2];
+            memcpy(words, msg, sizeof(words));
+            uint32_t size = words[1] >> 16;
+            if (size < WL_HEADER_SIZE || size > left)
+                break;
+
+            putVarint(c[WldColumnBlock::COLUMN_KEYS], getKey(words[0], words[1] & 0xffff));
+            putVarint(c[WldColumnBlock::COLUMN_SIZES], size);
+            c[WldColumnBlock::COLUMN_PAYLOAD].insert(c[WldColumnBlock::COLUMN_PAYLOAD].end(),
+                                                     msg + WL_HEADER_SIZE, msg + size);
+            msg += size;
+            left -= size;
+            msg_count++;
+        }
+        c[WldColumnBlock::COLUMN_PAYLOAD].insert(c[WldColumnBlock::COLUMN_PAYLOAD].end(),
+                                                 msg, msg + left);
+        c[WldColumnBlock::COLUMN_CONTROL].insert(c[WldColumnBlock::COLUMN_CONTROL].end(),
+                                                 p + msg_len, p + msg_len + cmsg_len);
+        messages += msg_count;
+
+        putVarint(c[WldColumnBlock::COLUMN_COUNTS], msg_count);
+        putVarint(c[WldColumnBlock::COLUMN_COUNTS], left);
+        putVarint(c[WldColumnBlock::COLUMN_COUNTS], cmsg_len);
+
+        p += msg_len + cmsg_len;
+    }
+
+    size_t total = BLOCK_HEADER_SIZE;
+    for (int i = 0; i < WldColumnBlock::COLUMN_COUNT; i++)
+        total += c[i].size();
+
+    out.resize(total);
+    char *o = &out[0];
+    put_nbo(o, count);
+    put_nbo(o + 4, messages);
+    put_nbo(o + 8, dict.size());
+    o += 12;
+    for (int i = 0; i < WldColumnBlock::COLUMN_COUNT; i++, o += 4)
+        put_nbo(o, c[i].size());
+    for (int i = 0; i < WldColumnBlock::COLUMN_COUNT; i++)
+    {
+        if (!c[i].empty())
+            memcpy(o, &c[i][0], c[i].size());
+        o += c[i].size();
+    }
+
+    return 0;
+}
+
+bool WldColumnDumper::encodeBlock(const std::vector<char> &records, uint32_t count,
+                                  std::vector<char> &out)
+{
+    if (records.empty())
+        return false;
+
+    if (encoder.encode(&records[0], records.size(), count, out))
+    {
+        Logger::getInstance()->log("Failed to split a block into columns\n");
+        return false;
+    }
+
+    return true;
+}
+
+WldColumnReader::WldColumnReader() : file(-1)
+{
+}
+
+WldColumnReader::~WldColumnReader()
+{
+    if (file != -1)
+        close(file);
+}
+
+int WldColumnReader::open(const std::string &path)
+{
+    file = ::open(path.c_str(), O_RDONLY);
+    if (file == -1)
+    {
+        DEBUG_LOG("failed to open %s: %s", path.c_str(), strerror(errno));
+        return -1;
+    }
+
+    uint32_t hdr[2];
+    if (pread(file, hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+            ntohl(hdr[0]) != WLD_COLUMN_FILE_MAGIC)
+    {
+        Logger::getInstance()->log("%s is not a columnar capture\n", path.c_str());
+        return -1;
+    }
+
+    blocks.setFile(file, WLD_BLOCK_FILE_HEADER_SIZE);
+
+    return 0;
+}
+
+WldColumnBlock *WldColumnReader::nextBlock()
+{
+    size_t len;
+    const char *data = blocks.nextBlock(&len);
+    if (!data)
+        return NULL;
+
+    if (blocks.getBlockFlags() & WLD_BLOCK_RECORDS)
+    {
+        uint32_t count = 0;
+        for (size_t pos = 0; pos < len; count++)
+        {
+            size_t size = WlaMessageView::getRecordSize(data + pos, len - pos);
+            if (!size || pos + size > len)
+                break;
+            pos += size;
+        }
+
+        if (encoder.encode(data, len, count, encoded))
+        {
+            Logger::getInstance()->log("Failed to split a block of records into columns\n");
+            return NULL;
+        }
+
+        data = &encoded[0];
+        len = encoded.size();
+    }
+
+    if (block.decode(data, len))
+    {
+        Logger::getInstance()->log("Failed to decode a columnar block\n");
+        return NULL;
+    }
+
+    return &block;
+}
@@ -0,0 +1,183 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include <string>
+#include <vector>
+#include <tr1/unordered_map>
+#include "block.h"
+
+// Columnar capture files use the block container of block.h with the
+// WLD_COLUMN_FILE_MAGIC magic. Before compression each block of records is
+// split into columns so that a scan over message headers doesn't have to
+// touch the payloads:
+//
+//   SEQS        zigzag varint delta of the record sequence numbers
+//   TIMESTAMPS  zigzag varint delta of the record timestamps in usec
+//   FLAGS       varint record flags
+//   COUNTS      per record: message count, trailing bytes, control length
+//   KEYS        per message: varint index into DICT
+//   SIZES       per message: varint wire size, header included
+//   DICT        per block: varint (object id, opcode) pairs
+//   PAYLOAD     message bodies and trailing bytes of each record
+//   CONTROL     control messages of each record
+//
+// A block starts with the record, message and dictionary counts and the
+// length of every column, all uint32_t in network byte order.
+class WldColumnBlock
+{
+public:
+    enum Column
+    {
+        COLUMN_SEQS,
+        COLUMN_TIMESTAMPS,
+        COLUMN_FLAGS,
+        COLUMN_COUNTS,
+        COLUMN_KEYS,
+        COLUMN_SIZES,
+        COLUMN_DICT,
+        COLUMN_PAYLOAD,
+        COLUMN_CONTROL,
+        COLUMN_COUNT
+    };
+
+    WldColumnBlock();
+
+    // Only the block header is parsed here, columns are decoded the first
+    // time they are asked for. The data has to outlive the block.
+    int decode(const char *data, size_t len);
+
+    uint32_t getRecordCount() const { return records; }
+    uint32_t getMessageCount() const { return messages; }
+    uint32_t getDictCount() const { return dict_count; }
+
+    // Raw column bytes
+    const char *getColumn(Column column, size_t *len) const;
+
+    // Decoded columns, NULL if the column is corrupted. Per record spans
+    // have getRecordCount() entries, per message ones getMessageCount().
+    const uint32_t *getSeqs();
+    const int64_t *getTimestamps();
+    const uint32_t *getFlags();
+    const uint32_t *getMessageCounts();
+    const uint32_t *getKeys();
+    const uint32_t *getSizes();
+    const uint32_t *getDictObjects();
+    const uint32_t *getDictOpcodes();
+
+    // Add the number of messages of every dictionary entry to counts,
+    // which is resized to getDictCount() if needed.
+    int countKeys(std::vector<uint32_t> &counts);
+
+    // Rebuild the records the block was encoded from
+    int toRecords(std::vector<char> &out);
+
+private:
+    bool decodeCounts();
+    bool decodeDict();
+    static bool decodeVarints(const char *p, size_t len, uint32_t *out, size_t count);
+    static bool decodeDeltas(const char *p, size_t len, int64_t *out, size_t count);
+
+private:
+    const char *columns[COLUMN_COUNT];
+    size_t lengths[COLUMN_COUNT];
+    uint32_t records;
+    uint32_t messages;
+    uint32_t dict_count;
+    unsigned int decoded;
+
+    std::vector<uint32_t> seqs;
+    std::vector<int64_t> timestamps;
+    std::vector<uint32_t> flags;
+    std::vector<uint32_t> msg_counts;
+    std::vector<uint32_t> tail_lens;
+    std::vector<uint32_t> cmsg_lens;
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> sizes;
+    std::vector<uint32_t> dict_objects;
+    std::vector<uint32_t> dict_opcodes;
+};
+
+// Splits a run of dump records into the columns above. The column buffers
+// are kept between blocks.
+class WldColumnEncoder
+{
+public:
+    int encode(const char *records, size_t len, uint32_t count, std::vector<char> &out);
+
+private:
+    void clear();
+    uint32_t getKey(uint32_t object, uint32_t opcode);
+    static void putVarint(std::vector<char> &column, uint64_t value);
+    static void putDelta(std::vector<char> &column, int64_t delta);
+
+private:
+    typedef std::tr1::unordered_map<uint64_t, uint32_t> dict_t;
+
+    std::vector<char> columns[WldColumnBlock::COLUMN_COUNT];
+    dict_t dict;
+    uint32_t messages;
+};
+
+// A WldBlockDumper that stores the blocks in columnar form
+class WldColumnDumper : public WldBlockDumper
+{
+public:
+    WldColumnDumper(WldCodecType codec = WLD_CODEC_NONE) : WldBlockDumper(codec) {}
+    virtual ~WldColumnDumper() { close(); }
+
+protected:
+    virtual bool encodeBlock(const std::vector<char> &records, uint32_t count,
+                             std::vector<char> &out);
+    virtual uint32_t getFileMagic() const { return WLD_COLUMN_FILE_MAGIC; }
+
+private:
+    WldColumnEncoder encoder;
+};
+
+// Iterates over the blocks of a columnar capture file
+class WldColumnReader
+{
+public:
+    WldColumnReader();
+    ~WldColumnReader();
+
+    int open(const std::string &path);
+
+    // The block stays valid until the next call, NULL at the end of the file
+    // or at a block that can't be read
+    WldColumnBlock *nextBlock();
+
+private:
+    int file;
+    WldBlockReader blocks;
+    WldColumnBlock block;
+    // blocks stored as plain records are split into columns here
+    WldColumnEncoder encoder;
+    std::vector<char> encoded;
+};
+
+#endif // COLUMNS_H
@@ -26,6 +26,9 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/stat.h>
 #include "common.h"
 
 #ifndef DEBUG_BUILD
@@ -73,11 +76,133 @@ uint32_t byteArrToUInt32(const char byte[])
 {
     uint32_t ret = 0;
 
-    ret = byte[0] | (byte[1] << 8) | (byte[2] << 16) | (byte[3] << 24);
+    const unsigned char *b = reinterpret_cast<const unsigned char *>(byte);
+    ret = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
 
     return ret;
 }
 
+void putUInt32(std::vector<char> &out, uint32_t val)
+{
+    val = htonl(val);
+    out.insert(out.end(), (const char *)&val, (const char *)&val + sizeof(val));
+}
+
+void putUInt64(std::vector<char> &out, uint64_t val)
+{
+    putUInt32(out, val >> 32);
+    putUInt32(out, val & 0xffffffff);
+}
+
+void putString(std::vector<char> &out, const std::string &str)
+{
+    putUInt32(out, str.size());
+    out.insert(out.end(), str.begin(), str.end());
+}
+
+bool getUInt32(const char *&p, const char *end, uint32_t *val)
+{
+    if (end - p < (ssize_t)sizeof(*val))
+        return false;
+
+    memcpy(val, p, sizeof(*val));
+    *val = ntohl(*val);
+    p += sizeof(*val);
+
+    return true;
+}
+
+bool getUInt64(const char *&p, const char *end, uint64_t *val)
+{
+    uint32_t hi, lo;
+    if (!getUInt32(p, end, &hi) || !getUInt32(p, end, &lo))
+        return false;
+
+    *val = ((uint64_t)hi << 32) | lo;
+
+    return true;
+}
+
+bool getString(const char *&p, const char *end, std::string *str)
+{
+    uint32_t len;
+    if (!getUInt32(p, end, &len) || (size_t)(end - p) < len)
+        return false;
+
+    str->assign(p, len);
+    p += len;
+
+    return true;
+}
+
+bool getFileStamp(const std::string &path, uint32_t stamp[4])
+{
+    struct stat st;
+    if (stat(path.c_str(), &st))
+        return false;
+
+    stamp[0] = (uint64_t)st.st_size >> 32;
+    stamp[1] = st.st_size & 0xffffffff;
+    stamp[2] = st.st_mtim.tv_sec;
+    stamp[3] = st.st_mtim.tv_nsec;
+
+    return true;
+}
+
+int readFile(const std::string &path, std::vector<char> &data)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return -1;
+
+    data.clear();
+    char buf[64 * 1024];
+    ssize_t len;
+    while ((len = read(fd, buf, sizeof(buf))) > 0 || (len < 0 && errno == EINTR))
+    {
+        if (len > 0)
+            data.insert(data.end(), buf, buf + len);
+    }
+    close(fd);
+
+    return len < 0 ? -1 : 0;
+}
+
+int writeFile(const std::string &path, const std::vector<char> &data)
+{
+    // readers never see a half written file
+    std::string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd == -1)
+    {
+        DEBUG_LOG("failed to create %s", tmp.c_str());
+        return -1;
+    }
+
+    const char *p = data.empty() ? NULL : &data[0];
+    size_t left = data.size();
+    while (left > 0)
+    {
+        ssize_t len = write(fd, p, left);
+        if (len < 0 && errno == EINTR)
+            continue;
+        if (len <= 0)
+            break;
+
+        p += len;
+        left -= len;
+    }
+    close(fd);
+
+    if (left || rename(tmp.c_str(), path.c_str()))
+    {
+        unlink(tmp.c_str());
+        return -1;
+    }
+
+    return 0;
+}
+
 void set_bit(uint32_t *val, int num, bool bit)
 {
     *val = (*val & ~(1 << num)) | (bit << num);
@@ -93,7 +218,8 @@ uint16_t byteArrToUInt16(const char byte[])
 {
     uint16_t ret = 0;
 
-    ret = byte[0] | (byte[1] << 8);
+    const unsigned char *b = reinterpret_cast<const unsigned char *>(byte);
+    ret = b[0] | (b[1] << 8);
 
     return ret;
 }
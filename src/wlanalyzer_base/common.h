@@ -30,9 +30,12 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <string>
+#include <vector>
 #include "logger.h"
 
 #define WLA_SOCKETNAME "wayland-debug"
+#define WLA_RECORDER_SOCKETNAME "wayland-debug-recorder"
 
 void debug_print(const char *buf);
 int check_error(int error);
@@ -44,6 +47,21 @@ uint16_t byteArrToUInt16(const char byte[]);
 void UInt16ToByteArr(char arr, uint32_t val);
 void UInt32ToByteArr(char arr, uint16_t val);
 
+// Appending to and reading from serialized data in network byte order,
+// the getters advance p and fail when fewer than needed bytes are left
+void putUInt32(std::vector<char> &out, uint32_t val);
+void putUInt64(std::vector<char> &out, uint64_t val);
+void putString(std::vector<char> &out, const std::string &str);
+bool getUInt32(const char *&p, const char *end, uint32_t *val);
+bool getUInt64(const char *&p, const char *end, uint64_t *val);
+bool getString(const char *&p, const char *end, std::string *str);
+
+// Sidecar files kept next to a capture: the stamp (size and mtime) tells
+// whether the capture changed since, writes replace the file atomically
+bool getFileStamp(const std::string &path, uint32_t stamp[4]);
+int readFile(const std::string &path, std::vector<char> &data);
+int writeFile(const std::string &path, const std::vector<char> &data);
+
 void set_bit(uint32_t *val, int num, bool bit);
 bool bit_isset(const uint32_t &val, int num);
 
@@ -29,16 +29,21 @@
 
 using namespace std;
 
+uint32_t WlaConnection::next_id = 1;
+
 WlaConnection::WlaConnection(WlaProxyServer *parent, WldDumper *writer)
 {
     running = false;
     this->parent = parent;
+    id = next_id++;
     this->dumper = writer;
 }
 
 WlaConnection::~WlaConnection()
 {
     closeConnection();
+    if (dumper)
+        dumper->closeConnection(id);
     parent->closeConnection(this);
 }
 
@@ -85,6 +90,7 @@ void WlaConnection::handleConnection(ev::io &watcher, int revents)
             }
 
             msg->setType(WlaMessageBuffer::REQUEST_TYPE);
+            msg->setConnection(id);
             if (dumper)
                 dumper->dump(*msg);
             requests.push(msg);
@@ -100,6 +106,7 @@ void WlaConnection::handleConnection(ev::io &watcher, int revents)
             }
 
             msg->setType(WlaMessageBuffer::EVENT_TYPE);
+            msg->setConnection(id);
             if (dumper)
                 dumper->dump(*msg);
             events.push(msg);
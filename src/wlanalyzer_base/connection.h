@@ -58,6 +58,9 @@ private:
     bool running;
 
     WlaProxyServer *parent;
+    // tells the connections apart in the messages
+    uint32_t id;
+    static uint32_t next_id;
 //    WlaIODumper *writer;
     WldDumper *dumper;
 
@@ -0,0 +1,421 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <algorithm>
+#include <string.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "block.h"
+#include "checkpoint.h"
+#include "decoder.h"
+#include "message.h"
+#include "parser.h"
+
+// Parses one chunk of the records for a worker thread
+class WldChunkParser : public WldParser
+{
+public:
+    WldChunkParser() : records(NULL), blocks(true), pos(0), end(0), start_seq(0) {}
+
+    int openResource(const std::string &resource) { return 0; }
+
+    void setChunk(const char *records, size_t begin, size_t end)
+    {
+        this->records = records;
+        this->pos = begin;
+        this->end = end;
+    }
+
+    // the blocks from begin up to end, leaving out the records before start_seq
+    void setBlocks(int fd, bool columns, size_t begin, size_t end, uint32_t start_seq)
+    {
+        blocks.setFile(fd, begin, columns);
+        this->records = NULL;
+        this->end = end;
+        this->start_seq = start_seq;
+    }
+
+private:
+    bool nextMessage(WlaMessageView &msg)
+    {
+        if (!records)
+            return nextBlockMessage(msg);
+
+        if (pos >= end)
+            return false;
+
+        int len = msg.parseRecord(records + pos, end - pos);
+        if (len < 0)
+            return false;
+        pos += len;
+
+        return true;
+    }
+
+    bool nextBlockMessage(WlaMessageView &msg)
+    {
+        size_t len;
+        const char *record;
+        while ((record = blocks.nextRecord(&len)) != NULL && (size_t)blocks.getBlockOffset() < end)
+        {
+            if (msg.parseRecord(record, len) < 0)
+                return false;
+            if (msg.getSeq() >= start_seq)
+                return true;
+        }
+
+        return false;
+    }
+
+private:
+    const char *records;
+    WldBlockReader blocks;
+    size_t pos;
+    size_t end;
+    uint32_t start_seq;
+};
+
+WldParallelDecoder::WldParallelDecoder(WldProtocolAnalyzer *analyzer, unsigned int threads) :
+    analyzer(analyzer), threads(threads), start_seq(0), records(NULL), size(0), file(-1),
+    columns(false), next_chunk(0), written(0)
+{
+    if (!this->threads)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        this->threads = cpus > 0 ? cpus : 1;
+    }
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cond, NULL);
+}
+
+WldParallelDecoder::~WldParallelDecoder()
+{
+    if (records)
+        munmap((void *)records, size);
+    if (file != -1)
+        close(file);
+
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&lock);
+
+    delete analyzer;
+}
+
+int WldParallelDecoder::open(const std::string &path)
+{
+    this->path = path;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        DEBUG_LOG("failed to open file %s", path.c_str());
+        return -1;
+    }
+
+    uint32_t file_hdr[2] = { 0, 0 };
+    struct stat st;
+    if (fstat(fd, &st) || pread(fd, file_hdr, sizeof(file_hdr), 0) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    // blocks are decompressed as they are needed, by every thread on its own
+    uint32_t magic = ntohl(file_hdr[0]);
+    if (magic == WLD_BLOCK_FILE_MAGIC || magic == WLD_COLUMN_FILE_MAGIC)
+    {
+        if (ntohl(file_hdr[1]) != WLD_BLOCK_FILE_VERSION)
+        {
+            Logger::getInstance()->log("Unsupported capture file version %u\n", ntohl(file_hdr[1]));
+            close(fd);
+            return -1;
+        }
+
+        file = fd;
+        columns = magic == WLD_COLUMN_FILE_MAGIC;
+        size = st.st_size;
+
+        return 0;
+    }
+
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        DEBUG_LOG("failed to map %s", path.c_str());
+        return -1;
+    }
+
+    records = (const char *)map;
+    size = st.st_size;
+
+    return 0;
+}
+
+int WldParallelDecoder::buildTimeline()
+{
+    // without a usable sidecar the whole capture is scanned, take new ones
+    Timeline scan;
+    scan.take_checkpoints = scan.checkpoints.load(path) != 0;
+
+    size_t pos = file == -1 ? 0 : WLD_BLOCK_FILE_HEADER_SIZE;
+    if (start_seq && !scan.take_checkpoints)
+    {
+        const WldCheckpoints::Checkpoint *checkpoint = scan.checkpoints.find(start_seq);
+        if (checkpoint && checkpoint->offset <= size && (checkpoint->state.empty() ||
+                !analyzer->restoreState(&checkpoint->state[0], checkpoint->state.size())))
+        {
+            DEBUG_LOG("starting from the checkpoint at record %u", checkpoint->seq);
+            pos = checkpoint->offset;
+        }
+    }
+
+    scan.chunk.begin = pos;
+    scan.chunk.first_message = analyzer->getPosition();
+    scan.chunk.done = false;
+    scan.started = false;
+    scan.chunk_bytes = 0;
+    scan.checkpoint_message = analyzer->getPosition();
+    scan.checkpoint_time = 0;
+
+    analyzer->recordTimeline(&timeline);
+
+    size_t end;
+    int ret = file == -1 ? scanRecords(scan, pos, &end) : scanBlocks(scan, pos, &end);
+    if (scan.started && scan.chunk.begin < end)
+    {
+        scan.chunk.end = end;
+        chunks.push_back(scan.chunk);
+    }
+
+    analyzer->recordTimeline(NULL);
+
+    if (scan.take_checkpoints && scan.checkpoints.size() > 1 && scan.checkpoints.save(path))
+        DEBUG_LOG("failed to save the checkpoints of %s", path.c_str());
+
+    return ret;
+}
+
+int WldParallelDecoder::scanRecords(Timeline &scan, size_t pos, size_t *end)
+{
+    while (pos < size)
+    {
+        WlaMessageView msg;
+        int len = msg.parseRecord(records + pos, size - pos);
+        if (len < 0)
+        {
+            Logger::getInstance()->log("The capture is truncated after %lu bytes\n", pos);
+            *end = pos;
+            return -1;
+        }
+
+        scanRecord(scan, msg, len, pos);
+        pos += len;
+    }
+
+    *end = pos;
+    return 0;
+}
+
+int WldParallelDecoder::scanBlocks(Timeline &scan, size_t pos, size_t *end)
+{
+    WldBlockReader reader;
+    reader.setFile(file, pos, columns);
+
+    // chunks and checkpoints can only start with a block
+    off_t block = -1;
+    size_t len;
+    const char *record;
+    while ((record = reader.nextRecord(&len)) != NULL)
+    {
+        WlaMessageView msg;
+        if (reader.getFailedOffset() != -1 || msg.parseRecord(record, len) < 0)
+            break;
+
+        bool first = reader.getBlockOffset() != block;
+        block = reader.getBlockOffset();
+        scanRecord(scan, msg, len, first ? block : NO_CHUNK_START);
+    }
+
+    if (reader.getFailedOffset() != -1 || record)
+    {
+        *end = reader.getFailedOffset() != -1 ? reader.getFailedOffset() : reader.getBlockOffset();
+        Logger::getInstance()->log("The capture is corrupt, it is only decoded up to %lu bytes\n", *end);
+        return -1;
+    }
+
+    *end = reader.getOffset();
+    if (*end < size)
+    {
+        Logger::getInstance()->log("The capture is truncated after %lu bytes\n", *end);
+        return -1;
+    }
+
+    return 0;
+}
+
+void WldParallelDecoder::scanRecord(Timeline &scan, const WlaMessageView &msg, size_t len, size_t pos)
+{
+    if (pos != NO_CHUNK_START)
+    {
+        if (scan.take_checkpoints &&
+                (analyzer->getPosition() - scan.checkpoint_message >= CHECKPOINT_MESSAGES ||
+                 msg.getTimeStamp()->tv_sec - scan.checkpoint_time >= CHECKPOINT_SECONDS))
+        {
+            analyzer->saveState(scan.state);
+            scan.checkpoints.add(pos, msg.getSeq(), scan.state);
+            scan.checkpoint_message = analyzer->getPosition();
+            scan.checkpoint_time = msg.getTimeStamp()->tv_sec;
+        }
+
+        if (!scan.started)
+            scan.chunk.begin = pos;
+        else if (scan.chunk_bytes >= CHUNK_SIZE)
+        {
+            scan.chunk.end = pos;
+            chunks.push_back(scan.chunk);
+
+            scan.chunk.begin = pos;
+            scan.chunk.first_message = analyzer->getPosition();
+            scan.chunk_bytes = 0;
+        }
+    }
+
+    // records before the start are followed but not decoded
+    if (!scan.started)
+    {
+        scan.chunk.first_message = analyzer->getPosition();
+        scan.started = msg.getSeq() >= start_seq;
+    }
+    if (scan.started)
+        scan.chunk_bytes += len;
+
+    // only the headers, unless a message creates or destroys objects
+    analyzer->scanRecord(msg);
+}
+
+int WldParallelDecoder::decode()
+{
+    // what could be read is still decoded when the capture is cut short
+    int ret = buildTimeline();
+    DEBUG_LOG("%lu object changes, %lu chunks, %lu objects alive at the end, %lu at most",
+              timeline.getChangeCount(), chunks.size(), analyzer->getObjectCount(),
+              analyzer->getPeakObjectCount());
+
+    std::vector<pthread_t> workers;
+    for (unsigned int i = 0; i < threads && i < chunks.size(); i++)
+    {
+        pthread_t worker;
+        if (pthread_create(&worker, NULL, workerThread, this))
+        {
+            DEBUG_LOG("failed to start a decoder thread");
+            break;
+        }
+        workers.push_back(worker);
+    }
+
+    if (workers.empty() && !chunks.empty())
+    {
+        Logger::getInstance()->log("Failed to start the decoder threads\n");
+        return -1;
+    }
+
+    // the output goes out in capture order, whoever decoded it
+    pthread_mutex_lock(&lock);
+    while (written < chunks.size())
+    {
+        Chunk &chunk = chunks[written];
+        while (!chunk.done)
+            pthread_cond_wait(&cond, &lock);
+        pthread_mutex_unlock(&lock);
+
+        Logger::getInstance()->write(chunk.output);
+        std::string().swap(chunk.output);
+
+        pthread_mutex_lock(&lock);
+        written++;
+        pthread_cond_broadcast(&cond);
+    }
+    pthread_mutex_unlock(&lock);
+
+    for (size_t i = 0; i < workers.size(); i++)
+        pthread_join(workers[i], NULL);
+
+    return ret;
+}
+
+void *WldParallelDecoder::workerThread(void *arg)
+{
+    WldParallelDecoder *decoder = static_cast<WldParallelDecoder *>(arg);
+
+    WldProtocolAnalyzer *analyzer = new WldProtocolAnalyzer(*decoder->analyzer,
+                                                            &decoder->timeline);
+    WldChunkParser parser;
+    parser.attachAnalyzer(analyzer);
+
+    pthread_mutex_lock(&decoder->lock);
+    while (true)
+    {
+        // don't pile up output the main thread can't write out yet
+        size_t limit = decoder->written + decoder->threads * MAX_CHUNKS_AHEAD;
+        if (decoder->next_chunk < decoder->chunks.size() && decoder->next_chunk >= limit)
+        {
+            pthread_cond_wait(&decoder->cond, &decoder->lock);
+            continue;
+        }
+
+        if (decoder->next_chunk >= decoder->chunks.size())
+            break;
+
+        Chunk &chunk = decoder->chunks[decoder->next_chunk++];
+        pthread_mutex_unlock(&decoder->lock);
+
+        analyzer->setPosition(chunk.first_message);
+        if (decoder->file == -1)
+            parser.setChunk(decoder->records, chunk.begin, chunk.end);
+        else
+            parser.setBlocks(decoder->file, decoder->columns, chunk.begin, chunk.end,
+                             decoder->start_seq);
+
+        Logger::setThreadBuffer(&chunk.output);
+        parser.parse();
+        Logger::setThreadBuffer(NULL);
+
+        pthread_mutex_lock(&decoder->lock);
+        chunk.done = true;
+        pthread_cond_broadcast(&decoder->cond);
+    }
+    pthread_mutex_unlock(&decoder->lock);
+
+    return NULL;
+}
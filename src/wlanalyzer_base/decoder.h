@@ -0,0 +1,111 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "analyzer.h"
+#include "checkpoint.h"
+
+class WlaMessageView;
+
+// Decodes a finished capture on all cores. A first pass only follows the
+// objects being created and destroyed and records which interface each id
+// stood for when, chunks of the capture are then decoded in parallel
+// against that timeline and their output is written in order.
+class WldParallelDecoder
+{
+public:
+    // The analyzer must have its protocol loaded, the decoder owns it
+    WldParallelDecoder(WldProtocolAnalyzer *analyzer, unsigned int threads = 0);
+    ~WldParallelDecoder();
+
+    int open(const std::string &path);
+    // only decode from the record with this sequence number on
+    void setStart(uint32_t seq) { start_seq = seq; }
+    int decode();
+
+private:
+    // Byte offsets into the records, for block captures the file offsets of
+    // the first block and of the one after the last
+    struct Chunk
+    {
+        size_t begin;
+        size_t end;
+        uint64_t first_message;
+        std::string output;
+        bool done;
+    };
+
+    // what the first pass carries from one record to the next
+    struct Timeline
+    {
+        WldCheckpoints checkpoints;
+        bool take_checkpoints;
+        uint64_t checkpoint_message;
+        time_t checkpoint_time;
+        std::vector<char> state;
+        Chunk chunk;
+        bool started;
+        size_t chunk_bytes;
+    };
+
+    int buildTimeline();
+    int scanRecords(Timeline &scan, size_t pos, size_t *end);
+    int scanBlocks(Timeline &scan, size_t pos, size_t *end);
+    // pos is where the record starts if a chunk can start there
+    void scanRecord(Timeline &scan, const WlaMessageView &msg, size_t len, size_t pos);
+    static void *workerThread(void *arg);
+
+private:
+    static const size_t CHUNK_SIZE = 4 * 1024 * 1024; // of records
+    static const size_t NO_CHUNK_START = (size_t)-1;
+    static const size_t MAX_CHUNKS_AHEAD = 4; // per thread
+    // how often the analyzer state is checkpointed, whichever comes first
+    static const uint64_t CHECKPOINT_MESSAGES = 65536;
+    static const time_t CHECKPOINT_SECONDS = 10;
+
+    WldProtocolAnalyzer *analyzer;
+    WldObjectTimeline timeline;
+    unsigned int threads;
+    std::string path;
+    uint32_t start_seq;
+
+    // the mapped record capture, or a block capture read a block at a time
+    const char *records;
+    size_t size;
+    int file;
+    bool columns;
+
+    std::vector<Chunk> chunks;
+    size_t next_chunk;
+    size_t written;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+#endif // DECODER_H
@@ -24,12 +24,12 @@
 
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <poll.h>
 #include "message.h"
 #include "dumper.h"
 
 int WlaIODumper::seq = 0;
 int WldIODumper::seq = 0;
-int WldNetDumper::seq = 0;
 
 WlaIODumper::WlaIODumper()
 {
@@ -124,29 +124,62 @@ int WldIODumper::dump(WlaMessageBuffer &msg)
 }
 
 
-WldNetDumper::WldNetDumper()
+WldTeeDumper::~WldTeeDumper()
 {
-    socket_fd = -1;
-    client = -1;
+    for (size_t i = 0; i < dumpers.size(); i++)
+        delete dumpers[i];
+}
+
+int WldTeeDumper::dump(WlaMessageBuffer &msg)
+{
+    int ret = 0;
+    for (size_t i = 0; i < dumpers.size(); i++)
+    {
+        if (dumpers[i]->dump(msg))
+            ret = -1;
+    }
+
+    return ret;
+}
+
+void WldTeeDumper::flush()
+{
+    for (size_t i = 0; i < dumpers.size(); i++)
+        dumpers[i]->flush();
+}
+
+void WldTeeDumper::closeConnection(uint32_t connection)
+{
+    for (size_t i = 0; i < dumpers.size(); i++)
+        dumpers[i]->closeConnection(connection);
+}
+
+WldNetDumper::WldNetDumper(size_t capacity, DropPolicy policy) : policy(policy), seq(0),
+    keep(0), batch_size(DEFAULT_BATCH_SIZE), batch_delay(DEFAULT_BATCH_DELAY), corking(true),
+    flush_pos(0), dropped(0), dropped_from(0)
+{
+    ring.create(capacity);
+    flush_timer.set<WldNetDumper, &WldNetDumper::flushTimeout>(this);
+
+    // always a marker, so that its record size is known up front
+    gap = new WlaMessageBuffer;
+    gap->setGap(0);
 }
 
 WldNetDumper::~WldNetDumper()
 {
-    if (socket_fd != -1)
-        ::close(socket_fd);
+    while (!subscribers.empty())
+        disconnectClient(subscribers.front());
 
-    if (client != -1)
-        ::close(client);
+    flush_timer.stop();
+    socket_watcher.stop();
+    delete gap;
+}
 
-    if (!message_queue.empty())
-    {
-        std::vector<WlaMessageBuffer *>::iterator it = message_queue.begin();
-        while (it != message_queue.end())
-        {
-            delete (*it);
-            it = message_queue.erase(it);
-        }
-    }
+void WldNetDumper::setBatching(size_t bytes, unsigned int usec)
+{
+    batch_size = bytes < WLD_NET_MAX_FRAME_SIZE ? bytes : WLD_NET_MAX_FRAME_SIZE;
+    batch_delay = usec;
 }
 
 int WldNetDumper::open(const std::string &resource)
@@ -157,136 +190,129 @@ int WldNetDumper::open(const std::string &resource)
         return -1;
     }
 
-    if (!server_socket.listen(resource))
-        return false;
-
-//    socket_watcher.set<WldNetDumper, &WldNetDumper::acceptClient>(this);
-//    socket_watcher.start(server_socket.getFd(), EV_READ);
+    server_socket.setMaxPendingConnections(MAX_SUBSCRIBERS);
+    if (!ring.isValid() || !server_socket.listen(resource))
+        return -1;
 
-    bool timedout;
-    server_socket.waitForConnection(0, &timedout);
-    socket_watcher.fd = server_socket.getFd();
-    acceptClient(socket_watcher, EV_READ);
-
-//    socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-//    if (socket_fd < 0)
-//    {
-//        DEBUG_LOG("failed to create socket");
-//        return -1;
-//    }
-
-//    int val = 1;
-//    setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &val, sizeof val);
-
-//    sockaddr_in srv_addr;
-//    memset(&srv_addr, 0, sizeof(sockaddr_in));
-//    srv_addr.sin_family = AF_INET;
-//    srv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-//    srv_addr.sin_port = htons(atoi(resource.c_str()));
-
-//    if (bind(socket_fd, (sockaddr *)&srv_addr, sizeof(sockaddr_in)) < 0)
-//    {
-//        DEBUG_LOG("Failed to bind socket to port %s", resource.c_str());
-//        close(socket_fd);
-//        return -1;
-//    }
-
-//    if (listen(socket_fd, 5) < 0)
-//    {
-//        DEBUG_LOG("Failed to listen on server socket");
-//        close(socket_fd);
-//        return -1;
-//    }
-
-//    socket_watcher.set<WldNetDumper, &WldNetDumper::acceptClient>(this);
-//    socket_watcher.start(socket_fd, EV_READ);
+    socket_watcher.set<WldNetDumper, &WldNetDumper::acceptClient>(this);
+    socket_watcher.start(server_socket.getFd(), EV_READ);
 
     return 0;
 }
 
 int WldNetDumper::dump(WlaMessageBuffer &msg)
 {
-    DEBUG_LOG("");
+    uint32_t msg_seq = seq++;
+    size_t len = msg.getRecordSize();
+    if (len > ring.getCapacity())
+    {
+        DEBUG_LOG("record of %lu bytes doesn't fit in the ring", len);
+        return -1;
+    }
 
-    if (!client_socket->isConnected())
+    if (policy == DROP_NEWEST)
     {
-        DEBUG_LOG("No connection with client");
+        size_t gap_len = dropped ? gap->getRecordSize() : 0;
+        if (!ring.hasRoom(keep, gap_len + len))
+        {
+            if (!dropped++)
+                dropped_from = msg_seq;
+            return 0;
+        }
 
-        WlaMessageBuffer *new_msg = new WlaMessageBuffer;
-        *new_msg = msg;
-        message_queue.push_back(new_msg);
-        return 0;
+        if (dropped)
+        {
+            DEBUG_LOG("dropped %u messages", dropped);
+            gap->setGap(dropped);
+            pushRecord(dropped_from, *gap);
+            dropped = 0;
+        }
     }
 
-    int sequence_no = seq++;
-	if (!client_socket->write((const char *)&sequence_no, sizeof(sequence_no)))
-	{
-		DEBUG_LOG("Connection with client lost");
-		return 0;
-	}
+    pushRecord(msg_seq, msg);
 
-    char *buf = new char[WlaMessageBufferHeader::getSerializeSize()];
-    memset(buf, 0, WlaMessageBufferHeader::getSerializeSize());
-    int len = msg.getHeader()->serializeToBuf(buf, WlaMessageBufferHeader::getSerializeSize());
+    if (!batch_delay)
+        flush_pos = ring.getEnd();
+    else if (!subscribers.empty() && !flush_timer.is_active())
+        flush_timer.start(batch_delay / 1000000.0, 0);
 
-    if (!client_socket->write(buf, len))
-        return -1;
-
-    if (!client_socket->write(msg.getMsg(), msg.getMsgSize()))
-        return -1;
+    std::list<Subscriber *>::iterator it = subscribers.begin();
+    for (; it != subscribers.end(); it++)
+        updateEvents(*it);
 
-    if (msg.getControlMsgSize() > 0)
-    {
-        if (!client_socket->write(msg.getControlMsg(), msg.getControlMsgSize()))
-            return -1;
-    }
+    return 0;
+}
 
-//    if (client <= 0)
-//    {
-//        DEBUG_LOG("");
+void WldNetDumper::flushTimeout(ev::timer &timer, int revents)
+{
+    flush_pos = ring.getEnd();
 
-//        WlaMessageBuffer *new_msg = new WlaMessageBuffer;
-//        *new_msg = msg;
-//        message_queue.push_back(new_msg);
-//        return 0;
-//    }
+    std::list<Subscriber *>::iterator it = subscribers.begin();
+    for (; it != subscribers.end(); it++)
+        updateEvents(*it);
+}
 
-//    int sequence_no = seq++;
-//    if (!sendData((char *)&sequence_no, sizeof(seq)))
-//        return -1;
+void WldNetDumper::pushRecord(uint32_t seq, WlaMessageBuffer &msg)
+{
+    size_t len = msg.getRecordSize();
+    bool lost = false;
 
-//    char *buf = new char[WlaMessageBufferHeader::getSerializeSize()];
-//    memset(buf, 0, WlaMessageBufferHeader::getSerializeSize());
-//    int len = msg.getHeader()->serializeToBuf(buf, WlaMessageBufferHeader::getSerializeSize());
+    std::list<Subscriber *>::iterator it = subscribers.begin();
+    for (; it != subscribers.end(); it++)
+        lost |= prepareOverwrite(*it, len);
 
-//    if (!sendData(buf, len))
-//        return -1;
+    ring.push(seq, msg);
 
-//    if (!sendData(msg.getMsg(), msg.getMsgSize()))
-//        return -1;
+    if (!lost)
+        return;
 
-//    if (msg.getControlMsgSize() > 0)
-//    {
-//        if (!sendData(msg.getControlMsg(), msg.getControlMsgSize()))
-//            return -1;
-//    }
+    // subscribers that fell behind skip to the oldest record left
+    uint64_t start = ring.getStart();
+    uint32_t start_seq = ring.getSeqAt(start);
+    for (it = subscribers.begin(); it != subscribers.end(); it++)
+    {
+        Subscriber *sub = *it;
+        if (!sub->lost)
+            continue;
 
-//    int len;
-//    do
-//    {
-//        len = send(client, msg.getMsg(), msg.getMsgSize(), 0);
-//    } while (len < 0 && errno == EINTR || errno == EWOULDBLOCK);
+        queueGap(sub, sub->lost_from, start_seq - sub->lost_from);
+        sub->cursor = sub->frame_end = start;
+        sub->lost = false;
+    }
+}
 
-//    DEBUG_LOG("");
+void WldNetDumper::flush()
+{
+    // give the analyzers a chance to get the tail of the session
+    double deadline = ev_time() + FLUSH_TIMEOUT;
+    flush_pos = ring.getEnd();
+    while (true)
+    {
+        std::vector<pollfd> fds;
+        std::list<Subscriber *>::iterator it = subscribers.begin();
+        for (; it != subscribers.end(); it++)
+        {
+            if (!(*it)->streaming || !hasDataToSend(*it))
+                continue;
+
+            pollfd pfd;
+            pfd.fd = (*it)->socket->getSocketDescriptor();
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+            fds.push_back(pfd);
+        }
 
-//    if (len < 0 && errno == EPIPE)
-//    {
-//        Logger::getInstance()->log("Connection with analyzer broken, closing socket\n");
-//        ::close(client);
-//        client = -1;
-//    }
+        double left = deadline - ev_time();
+        if (fds.empty() || left <= 0 || poll(&fds[0], fds.size(), left * 1000) <= 0)
+            break;
 
-    return 0;
+        for (it = subscribers.begin(); it != subscribers.end();)
+        {
+            Subscriber *sub = *it++;
+            if (sub->streaming && hasDataToSend(sub))
+                sendData(sub);
+        }
+    }
 }
 
 bool WldNetDumper::validateIpAddress(const std::string &ipAddress)
@@ -302,151 +328,311 @@ void WldNetDumper::acceptClient(ev::io &watcher, int revents)
     if (revents & EV_ERROR)
         return;
 
-    DEBUG_LOG("");
+    bool timedout;
+    if (!server_socket.waitForConnection(0, &timedout))
+        return;
 
-//    bool timedout;
-//    server_socket.waitForConnection(1000, &timedout);
-    client_socket = server_socket.nextPendingConnection();
-    socket_watcher.stop();
+    WldSocket *socket = server_socket.nextPendingConnection();
+    if (!socket)
+        return;
 
-    if (message_queue.size() > 0)
+    if (subscribers.size() >= MAX_SUBSCRIBERS)
     {
-        DEBUG_LOG("");
+        Logger::getInstance()->log("Too many analyzers connected, refusing a new one\n");
+        delete socket;
+        return;
+    }
 
-        std::vector<WlaMessageBuffer *>::iterator it = message_queue.begin();
-        for (; it != message_queue.end();)
-        {
-            DEBUG_LOG("%d", message_queue.size());
-
-            int ret;
-
-            int sequence_no = seq++;
-            if (!client_socket->write((char *)&sequence_no, sizeof(seq)))
-            {
-                DEBUG_LOG("");
-                return;
-            }
-
-            char *buf = new char[WlaMessageBufferHeader::getSerializeSize()];
-            memset(buf, 0, WlaMessageBufferHeader::getSerializeSize());
-            int len = (*it)->getHeader()->serializeToBuf(buf, WlaMessageBufferHeader::getSerializeSize());
-
-            ret = client_socket->write(buf, len);
-            delete [] buf;
-
-            if (!ret)
-            {
-                DEBUG_LOG("");
-                return;
-            }
-
-            if (!client_socket->write((*it)->getMsg(), (*it)->getMsgSize()))
-            {
-                DEBUG_LOG("");
-                return;
-            }
-
-            if ((*it)->getControlMsgSize() > 0)
-            {
-                if (!client_socket->write((*it)->getControlMsg(), (*it)->getControlMsgSize()))
-                {
-                    DEBUG_LOG("");
-                    return;
-                }
-            }
-
-            delete *it;
-            it = message_queue.erase(it);
-        }
+    Subscriber *sub = new Subscriber;
+    sub->socket = socket;
+    sub->hello_len = 0;
+    sub->streaming = false;
+    sub->cursor = 0;
+    sub->frame_end = 0;
+    sub->pending_pos = 0;
+    sub->pending_gap = NO_GAP;
+    sub->lost = false;
+    sub->lost_from = 0;
+    subscribers.push_back(sub);
+
+    socket->set<WldNetDumper, &WldNetDumper::handleClientEvent>(this);
+    socket->start(EV_READ);
+}
+
+void WldNetDumper::handleClientEvent(ev::io &watcher, int revents)
+{
+    Subscriber *sub = NULL;
+    std::list<Subscriber *>::iterator it = subscribers.begin();
+    for (; it != subscribers.end(); it++)
+    {
+        if ((*it)->socket == &watcher)
+            sub = *it;
+    }
+
+    if (!sub)
+        return;
+
+    if (revents & EV_ERROR)
+    {
+        disconnectClient(sub);
+        return;
     }
 
-//    int fd = accept(socket_fd, (sockaddr *)NULL, NULL);
-//    if (fd < 0)
-//    {
-//        DEBUG_LOG("Failed to accept connection");
-//        return;
-//    }
+    if ((revents & EV_READ) && !readClient(sub))
+        return;
+
+    if (revents & EV_WRITE)
+        sendData(sub);
+}
+
+void WldNetDumper::disconnectClient(Subscriber *sub)
+{
+    sub->socket->stop();
+    delete sub->socket;
 
-//    socket_watcher.stop();
-//    client = fd;
+    subscribers.remove(sub);
+    delete sub;
+}
 
-//    if (message_queue.size() > 0)
-//    {
-//        DEBUG_LOG("");
+bool WldNetDumper::readClient(Subscriber *sub)
+{
+    // nothing but the hello is expected, anything after it is ignored
+    char buf[64];
+    char *dst = sub->streaming ? buf : sub->hello + sub->hello_len;
+    size_t size = sub->streaming ? sizeof(buf) : sizeof(sub->hello) - sub->hello_len;
+
+    ssize_t len = recv(sub->socket->getSocketDescriptor(), dst, size, MSG_DONTWAIT);
+    if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR))
+    {
+        Logger::getInstance()->log("Connection with analyzer lost\n");
+        disconnectClient(sub);
+        return false;
+    }
 
-//        std::vector<WlaMessageBuffer *>::iterator it = message_queue.begin();
-//        for (; it != message_queue.end(); it++)
-//        {
-//            DEBUG_LOG("%d", message_queue.size());
+    if (len < 0 || sub->streaming)
+        return true;
 
-//            int ret;
+    sub->hello_len += len;
+    if (sub->hello_len < sizeof(sub->hello))
+        return true;
 
-//            int sequence_no = seq++;
-//            if (!sendData((char *)&sequence_no, sizeof(seq)))
-//            {
-//                DEBUG_LOG("");
-//                return;
-//            }
+    uint32_t flags;
+    uint32_t from;
+    memcpy(&flags, sub->hello, sizeof(flags));
+    memcpy(&from, sub->hello + sizeof(flags), sizeof(from));
+    startStreaming(sub, ntohl(flags), ntohl(from));
 
-//            char *buf = new char[WlaMessageBufferHeader::getSerializeSize()];
-//            memset(buf, 0, WlaMessageBufferHeader::getSerializeSize());
-//            int len = (*it)->getHeader()->serializeToBuf(buf, WlaMessageBufferHeader::getSerializeSize());
+    return true;
+}
 
-//            ret = sendData(buf, len);
-//            delete [] buf;
+void WldNetDumper::startStreaming(Subscriber *sub, uint32_t flags, uint32_t from)
+{
+    uint64_t end = ring.getEnd();
+    sub->cursor = ring.getStart();
 
-//            if (!ret)
-//            {
-//                DEBUG_LOG("");
-//                return;
-//            }
+    if (flags & WLD_NET_RESUME)
+    {
+        sub->cursor = ring.find(from);
+        uint32_t first = sub->cursor < end ? ring.getSeqAt(sub->cursor) : seq;
+        if ((int32_t)(first - from) > 0)
+            queueGap(sub, from, first - from);
 
-//            if (!sendData((*it)->getMsg(), (*it)->getMsgSize()))
-//            {
-//                DEBUG_LOG("");
-//                return;
-//            }
+        Logger::getInstance()->log("Analyzer resumed from message %u\n", first);
+    }
 
-//            if ((*it)->getControlMsgSize() > 0)
-//            {
-//                if (!sendData((*it)->getControlMsg(), (*it)->getControlMsgSize()))
-//                {
-//                    DEBUG_LOG("");
-//                    return;
-//                }
-//            }
+    sub->frame_end = sub->cursor;
+    sub->streaming = true;
 
-//            delete *it;
-//        }
+    // the backlog goes out right away
+    flush_pos = ring.getEnd();
 
-//        message_queue.clear();
-//    }
+    updateEvents(sub);
 }
 
-int WldNetDumper::sendData(const char *data, size_t size)
+ssize_t WldNetDumper::sendChunks(Subscriber *sub, iovec *iov, int count, int flags)
 {
-    int len;
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
 
+    ssize_t len;
     do
     {
-        len = send(client, data, size, MSG_NOSIGNAL);
-    } while ((len < 0) && ((errno == EINTR) || (errno == EWOULDBLOCK)));
+        len = sendmsg(sub->socket->getSocketDescriptor(), &msg,
+                      flags | MSG_NOSIGNAL | MSG_DONTWAIT);
+    } while (len < 0 && errno == EINTR);
+
+    if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
 
     if (len < 0)
     {
-        if (errno == EPIPE)
+        Logger::getInstance()->log("Connection with analyzer lost\n");
+        disconnectClient(sub);
+    }
+
+    return len;
+}
+
+bool WldNetDumper::sendData(Subscriber *sub)
+{
+    while (true)
+    {
+        if (sub->cursor == sub->frame_end && isFrameReady(sub->cursor))
+            startFrame(sub);
+
+        // whatever is pending and the frame body, which may wrap around
+        // the end of the ring, in a single call
+        iovec iov[3];
+        int count = 0;
+        size_t pending_size = sub->pending.size() - sub->pending_pos;
+        if (pending_size)
         {
-            Logger::getInstance()->log("Lost connection with analyzer, closing socket\n");
-            ::close(client);
-            client = -1;
+            iov[count].iov_base = &sub->pending[sub->pending_pos];
+            iov[count++].iov_len = pending_size;
+        }
 
-            socket_watcher.start(socket_fd, EV_READ);
+        for (uint64_t pos = sub->cursor; pos < sub->frame_end;)
+        {
+            size_t size;
+            const char *data = ring.peek(pos, &size);
+            if (size > sub->frame_end - pos)
+                size = sub->frame_end - pos;
+
+            iov[count].iov_base = (void *)data;
+            iov[count++].iov_len = size;
+            pos += size;
+        }
 
-            return 0;
+        if (!count)
+            break;
+
+        int flags = corking && isFrameReady(sub->frame_end) ? MSG_MORE : 0;
+        ssize_t len = sendChunks(sub, iov, count, flags);
+        if (len < 0)
+            return false;
+        if (len == 0)
+            break;
+
+        if ((size_t)len < pending_size)
+        {
+            sub->pending_pos += len;
+            continue;
         }
-        else
-            return -1;
+
+        sub->pending.clear();
+        sub->pending_pos = 0;
+        sub->pending_gap = NO_GAP;
+        sub->cursor += len - pending_size;
     }
 
-    return len;
+    if (policy == DROP_NEWEST && sub->cursor > keep)
+        keep = sub->cursor;
+
+    updateEvents(sub);
+
+    return true;
+}
+
+bool WldNetDumper::isFrameReady(uint64_t pos) const
+{
+    uint64_t end = ring.getEnd();
+
+    return pos < end && (end - pos >= batch_size || pos < flush_pos);
+}
+
+void WldNetDumper::startFrame(Subscriber *sub)
+{
+    uint64_t end = ring.getEnd();
+    uint64_t pos = sub->cursor;
+    uint32_t count = 0;
+
+    while (pos < end)
+    {
+        size_t size = ring.getRecordSizeAt(pos);
+        if (count && pos + size - sub->cursor > WLD_NET_MAX_FRAME_SIZE)
+            break;
+
+        pos += size;
+        count++;
+    }
+
+    uint32_t header[] = { htonl(WLD_NET_FRAME_MAGIC), htonl(pos - sub->cursor), htonl(count) };
+    sub->pending.insert(sub->pending.end(), (char *)header, (char *)header + sizeof(header));
+    sub->frame_end = pos;
+}
+
+bool WldNetDumper::hasDataToSend(const Subscriber *sub) const
+{
+    return sub->pending_pos < sub->pending.size() || sub->cursor < sub->frame_end ||
+            (sub->streaming && isFrameReady(sub->cursor));
+}
+
+void WldNetDumper::updateEvents(Subscriber *sub)
+{
+    if (!sub->streaming)
+        return;
+
+    int events = EV_READ;
+    if (hasDataToSend(sub))
+        events |= EV_WRITE;
+
+    if (sub->socket->events != events)
+        sub->socket->set(events);
+}
+
+bool WldNetDumper::prepareOverwrite(Subscriber *sub, size_t len)
+{
+    if (!sub->streaming || sub->cursor >= ring.getEnd() || ring.hasRoom(sub->cursor, len))
+        return false;
+
+    // the frame header is already on its way, so the analyzer gets the
+    // rest of the frame before the gap marker
+    if (sub->cursor < sub->frame_end)
+    {
+        size_t size = sub->frame_end - sub->cursor;
+        size_t pos = sub->pending.size();
+        sub->pending.resize(pos + size);
+        ring.read(sub->cursor, &sub->pending[pos], size);
+        sub->cursor = sub->frame_end;
+
+        if (sub->cursor >= ring.getEnd() || ring.hasRoom(sub->cursor, len))
+            return false;
+    }
+
+    sub->lost = true;
+    sub->lost_from = ring.getSeqAt(sub->cursor);
+
+    return true;
+}
+
+void WldNetDumper::queueGap(Subscriber *sub, uint32_t first, uint32_t count)
+{
+    // a frame of its own, holding just the marker
+    size_t size = WLD_NET_FRAME_HEADER_SIZE + gap->getRecordSize();
+    size_t count_offset = WLD_NET_FRAME_HEADER_SIZE + sizeof(uint32_t) +
+            WlaMessageBufferHeader::getSerializeSize();
+    std::vector<char> &pending = sub->pending;
+
+    // merge with a marker that hasn't started going out yet
+    if (sub->pending_gap != NO_GAP && sub->pending_gap >= sub->pending_pos &&
+            sub->pending_gap + size == pending.size())
+    {
+        uint32_t nbo_count;
+        memcpy(&nbo_count, &pending[sub->pending_gap + count_offset], sizeof(nbo_count));
+        nbo_count = htonl(ntohl(nbo_count) + count);
+        memcpy(&pending[sub->pending_gap + count_offset], &nbo_count, sizeof(nbo_count));
+        return;
+    }
+
+    WlaMessageBuffer marker;
+    marker.setGap(count);
+    sub->pending_gap = pending.size();
+    pending.resize(sub->pending_gap + size);
+
+    uint32_t header[] = { htonl(WLD_NET_FRAME_MAGIC), htonl(gap->getRecordSize()), htonl(1) };
+    memcpy(&pending[sub->pending_gap], header, sizeof(header));
+    marker.serializeRecord(first, &pending[sub->pending_gap + sizeof(header)],
+                           gap->getRecordSize());
 }
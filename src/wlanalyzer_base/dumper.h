@@ -25,11 +25,14 @@
 #ifndef DUMPER_H
 #define DUMPER_H
 
+#include <list>
 #include <vector>
+#include <sys/uio.h>
 #include <ev++.h>
 #include "common.h"
 #include "socket.h"
 #include "server_socket.h"
+#include "ring.h"
 
 class WlaMessageBuffer;
 
@@ -40,6 +43,28 @@ public:
 
     virtual int open(const std::string &resource) = 0;
     virtual int dump(WlaMessageBuffer &msg) = 0;
+    virtual void flush() {}
+    // the proxied connection with this id is gone
+    virtual void closeConnection(uint32_t connection) {}
+};
+
+// Passes every message on to several dumpers, e.g. an analyzer and a file.
+// They are owned by the tee and have to be opened before they are added.
+class WldTeeDumper : public WldDumper
+{
+public:
+    virtual ~WldTeeDumper();
+
+    void addDumper(WldDumper *dumper) { dumpers.push_back(dumper); }
+    size_t getDumperCount() const { return dumpers.size(); }
+
+    virtual int open(const std::string &resource) { return 0; }
+    virtual int dump(WlaMessageBuffer &msg);
+    virtual void flush();
+    virtual void closeConnection(uint32_t connection);
+
+private:
+    std::vector<WldDumper *> dumpers;
 };
 
 class WldIODumper : public WldDumper
@@ -56,31 +81,114 @@ private:
     static int seq;
 };
 
+// Sent by an analyzer right after it connects: flags and the sequence
+// number to resume from, both uint32_t in network byte order.
+const uint32_t WLD_NET_RESUME = 0x01;
+const size_t WLD_NET_HELLO_SIZE = 2 * sizeof(uint32_t);
+
+// After the hello the records are sent in frames: magic, length of the
+// records that follow and their count, all uint32_t in network byte order.
+const uint32_t WLD_NET_FRAME_MAGIC = 0x574c4446; // "WLDF"
+const size_t WLD_NET_FRAME_HEADER_SIZE = 3 * sizeof(uint32_t);
+const size_t WLD_NET_MAX_FRAME_SIZE = 1024 * 1024;
+
+// Streams the dump records to any number of analyzers without ever
+// blocking the proxy. Records go to a bounded ring shared by all of them
+// and are sent from there whenever a socket is writable, each subscriber
+// only has its own read cursor. When the ring is full either the oldest
+// records are overwritten, or the new ones are dropped as long as the
+// fastest subscriber hasn't seen what would be overwritten, and a gap
+// marker takes their place once there is room again. A subscriber that
+// falls behind gets a gap marker for what was overwritten under it.
+// Records are batched into frames which go out once there are enough
+// bytes for one or the oldest unsent record has waited long enough.
 class WldNetDumper : public WldDumper
 {
 public:
-    WldNetDumper();
+    enum DropPolicy
+    {
+        DROP_OLDEST,
+        DROP_NEWEST
+    };
+
+    WldNetDumper(size_t capacity = DEFAULT_CAPACITY, DropPolicy policy = DROP_NEWEST);
     virtual ~WldNetDumper();
 
     virtual int open(const std::string &resource);
     virtual int dump(WlaMessageBuffer &msg);
+    virtual void flush();
+
+    // frame at least bytes of records, but don't hold any of them back
+    // longer than usec; 0 sends every record as soon as it comes
+    void setBatching(size_t bytes, unsigned int usec);
+    // let the kernel merge frames which are ready to go out back to back
+    void setCorking(bool enable) { corking = enable; }
 
 private:
+    struct Subscriber
+    {
+        WldSocket *socket;
+        char hello[WLD_NET_HELLO_SIZE];
+        size_t hello_len;
+        bool streaming;
+
+        uint64_t cursor;    // next byte of the ring to send
+        uint64_t frame_end; // end of the frame cursor points into
+
+        // bytes that have to go out before the ring: frame headers, the
+        // rest of a frame that got overwritten while being sent and gap
+        // markers
+        std::vector<char> pending;
+        size_t pending_pos;
+        size_t pending_gap;
+
+        bool lost;
+        uint32_t lost_from;
+    };
+
     bool validateIpAddress(const std::string &ipAddress);
     void acceptClient(ev::io &watcher, int revents);
-    int sendData(const char *data, size_t size);
+    void handleClientEvent(ev::io &watcher, int revents);
+    void disconnectClient(Subscriber *sub);
+    bool readClient(Subscriber *sub);
+    void startStreaming(Subscriber *sub, uint32_t flags, uint32_t from);
+    ssize_t sendChunks(Subscriber *sub, iovec *iov, int count, int flags);
+    bool sendData(Subscriber *sub);
+    bool isFrameReady(uint64_t pos) const;
+    void startFrame(Subscriber *sub);
+    void flushTimeout(ev::timer &timer, int revents);
+    bool hasDataToSend(const Subscriber *sub) const;
+    void updateEvents(Subscriber *sub);
+    void pushRecord(uint32_t seq, WlaMessageBuffer &msg);
+    bool prepareOverwrite(Subscriber *sub, size_t len);
+    void queueGap(Subscriber *sub, uint32_t first, uint32_t count);
 
 private:
-    int socket_fd;
-    int client;
-    ev::io socket_watcher;
+    static const size_t DEFAULT_CAPACITY = 16 * 1024 * 1024;
+    static const size_t MAX_SUBSCRIBERS = 16;
+    static const size_t NO_GAP = (size_t)-1;
+    static const int FLUSH_TIMEOUT = 5; // seconds
+    static const size_t DEFAULT_BATCH_SIZE = 64 * 1024;
+    static const unsigned int DEFAULT_BATCH_DELAY = 1000; // usec
+
+    WldRecordRing ring;
+    DropPolicy policy;
+    uint32_t seq;
+    uint64_t keep; // DROP_NEWEST never overwrites past this
+
+    size_t batch_size;
+    unsigned int batch_delay;
+    bool corking;
+    uint64_t flush_pos; // everything before it is sent regardless of batch_size
+    ev::timer flush_timer;
 
+    ev::io socket_watcher;
     WldNetServer server_socket;
-    WldSocket *client_socket;
-
-    static int seq;
+    std::list<Subscriber *> subscribers;
 
-    std::vector<WlaMessageBuffer *> message_queue;
+    uint32_t dropped;
+    uint32_t dropped_from;
+    WlaMessageBuffer *gap;
 };
 
 class WlaIODumper
@@ -0,0 +1,199 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "logger.h"
+#include "filter.h"
+
+WldArgFilter::WldArgFilter() : op(OP_EQ), number(0)
+{
+}
+
+int WldArgFilter::parse(const std::string &spec)
+{
+    std::string::size_type colon = spec.find(':');
+    std::string names = spec.substr(0, colon);
+
+    std::string::size_type dot = names.find('.');
+    intf_name = names.substr(0, dot);
+    msg_name = dot == std::string::npos ? "" : names.substr(dot + 1);
+    if (intf_name.empty())
+    {
+        Logger::getInstance()->log("No interface in the filter %s\n", spec.c_str());
+        return -1;
+    }
+
+    arg_name.clear();
+    if (colon == std::string::npos)
+        return 0;
+
+    std::string cond = spec.substr(colon + 1);
+    std::string::size_type pos = cond.find_first_of("!=<>");
+    if (pos == std::string::npos || pos == 0)
+    {
+        Logger::getInstance()->log("Invalid argument condition in the filter %s\n", spec.c_str());
+        return -1;
+    }
+
+    arg_name = cond.substr(0, pos);
+    size_t len = 1;
+    switch (cond[pos])
+    {
+    case '!':
+        if (cond.compare(pos, 2, "!=") != 0)
+        {
+            Logger::getInstance()->log("Invalid argument condition in the filter %s\n", spec.c_str());
+            return -1;
+        }
+        op = OP_NE;
+        len = 2;
+        break;
+    case '<':
+        op = OP_LT;
+        break;
+    case '>':
+        op = OP_GT;
+        break;
+    default:
+        op = OP_EQ;
+        break;
+    }
+
+    value = cond.substr(pos + len);
+    number = strtod(value.c_str(), NULL);
+
+    return 0;
+}
+
+int WldArgFilter::resolve(const WldProtocolDefinition &protocol)
+{
+    targets.clear();
+
+    const WldInterface *intf = protocol.getInterface(intf_name);
+    if (!intf)
+    {
+        Logger::getInstance()->log("Unknown interface %s in the filter\n", intf_name.c_str());
+        return -1;
+    }
+
+    char *end;
+    strtod(value.c_str(), &end);
+    bool numeric = !value.empty() && !*end;
+
+    const std::vector<WldMessage> *lists[] = { &intf->requests, &intf->events };
+    for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); i++)
+    {
+        std::vector<WldMessage>::const_iterator msg = lists[i]->begin();
+        for (; msg != lists[i]->end(); msg++)
+        {
+            if (!msg_name.empty() && msg->signature != msg_name)
+                continue;
+
+            if (arg_name.empty())
+            {
+                targets[&*msg] = -1;
+                continue;
+            }
+
+            for (size_t j = 0; j < msg->args.size(); j++)
+            {
+                const WldArg &arg = msg->args[j];
+                if (arg.name != arg_name)
+                    continue;
+
+                if (arg.type != WLD_ARG_STRING && !numeric)
+                {
+                    Logger::getInstance()->log("%s.%s takes a number\n", msg->signature.c_str(),
+                                               arg_name.c_str());
+                    return -1;
+                }
+                targets[&*msg] = j;
+                break;
+            }
+        }
+    }
+
+    if (targets.empty())
+    {
+        Logger::getInstance()->log("No message of %s matches the filter\n", intf_name.c_str());
+        return -1;
+    }
+
+    return 0;
+}
+
+bool WldArgFilter::matches(const WldMessage &msg, const WldArgVal *vals) const
+{
+    targets_t::const_iterator it = targets.find(&msg);
+    if (it == targets.end())
+        return false;
+
+    if (it->second < 0)
+        return true;
+
+    return compare(msg.args[it->second].type, vals[it->second]);
+}
+
+bool WldArgFilter::compare(WldArgType type, const WldArgVal &val) const
+{
+    switch (type)
+    {
+    case WLD_ARG_STRING:
+    {
+        std::string str;
+        if (val.s.data)
+            str.assign(val.s.data, strnlen(val.s.data, val.s.len));
+        return compare(str, value);
+    }
+    case WLD_ARG_INT:
+        return compare((double)val.i, number);
+    case WLD_ARG_FIXED:
+        return compare(val.f / 256.0, number);
+    case WLD_ARG_NEWID:
+        return compare((double)val.n.id, number);
+    case WLD_ARG_ARRAY:
+        return compare((double)val.a.size, number);
+    case WLD_ARG_FD:
+        return compare((double)val.h, number);
+    default:
+        return compare((double)val.u, number);
+    }
+}
+
+template <typename T>
+bool WldArgFilter::compare(const T &a, const T &b) const
+{
+    switch (op)
+    {
+    case OP_NE:
+        return a != b;
+    case OP_LT:
+        return a < b;
+    case OP_GT:
+        return b < a;
+    default:
+        return a == b;
+    }
+}
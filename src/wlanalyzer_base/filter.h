@@ -0,0 +1,74 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <string>
+#include <tr1/unordered_map>
+#include "xml/protocol_parser.h"
+
+// Picks messages by interface, name and the value of an argument:
+// <interface>[.<message>][:<argument><op><value>], op being one of = != < >
+// Strings are compared as they are, everything else as numbers, arrays by
+// size. Once resolved against a protocol it is only read, any number of
+// analyzers can share it.
+class WldArgFilter
+{
+public:
+    WldArgFilter();
+
+    int parse(const std::string &spec);
+    // finds the messages and arguments named by the spec
+    int resolve(const WldProtocolDefinition &protocol);
+
+    bool matches(const WldMessage &msg, const WldArgVal *vals) const;
+
+private:
+    enum Op
+    {
+        OP_EQ,
+        OP_NE,
+        OP_LT,
+        OP_GT
+    };
+
+    bool compare(WldArgType type, const WldArgVal &val) const;
+    template <typename T>
+    bool compare(const T &a, const T &b) const;
+
+private:
+    std::string intf_name;
+    std::string msg_name;
+    std::string arg_name;
+    Op op;
+    std::string value;
+    double number;
+
+    // the argument compared for every message of interest, -1 for none
+    typedef std::tr1::unordered_map<const WldMessage *, int> targets_t;
+    targets_t targets;
+};
+
+#endif // FILTER_H
@@ -0,0 +1,232 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "index.h"
+#include "message.h"
+
+int WldCaptureIndex::load(const std::string &capture)
+{
+    clear();
+
+    uint32_t stamp[4];
+    std::vector<char> data;
+    std::string path = capture + WLD_INDEX_SUFFIX;
+    if (!getFileStamp(capture, stamp) || readFile(path, data))
+        return -1;
+
+    const char *p = data.empty() ? NULL : &data[0];
+    const char *end = p + data.size();
+    uint32_t val[6];
+    for (int i = 0; i < 6; i++)
+    {
+        if (!getUInt32(p, end, &val[i]))
+            return -1;
+    }
+
+    if (val[0] != WLD_INDEX_MAGIC || val[1] != WLD_INDEX_VERSION ||
+            memcmp(&val[2], stamp, sizeof(stamp)))
+    {
+        DEBUG_LOG("%s is outdated", path.c_str());
+        return -1;
+    }
+
+    uint32_t entry_count, count_count;
+    if (!getUInt64(p, end, &size) || !getUInt64(p, end, &messages) ||
+            !getUInt32(p, end, &entry_count))
+    {
+        clear();
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < entry_count; i++)
+    {
+        Entry entry;
+        uint32_t time[4];
+        if (!getUInt64(p, end, &entry.offset) || !getUInt64(p, end, &entry.message) ||
+                !getUInt32(p, end, &entry.seq) || !getUInt32(p, end, &time[0]) ||
+                !getUInt32(p, end, &time[1]) || !getUInt32(p, end, &time[2]) ||
+                !getUInt32(p, end, &time[3]))
+        {
+            clear();
+            return -1;
+        }
+
+        entry.first.tv_sec = time[0];
+        entry.first.tv_usec = time[1];
+        entry.last.tv_sec = time[2];
+        entry.last.tv_usec = time[3];
+        entries.push_back(entry);
+    }
+
+    if (!getUInt32(p, end, &count_count))
+    {
+        clear();
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count_count; i++)
+    {
+        std::string name;
+        uint64_t count;
+        if (!getString(p, end, &name) || !getUInt64(p, end, &count))
+        {
+            clear();
+            return -1;
+        }
+
+        counts[name] = count;
+    }
+
+    return 0;
+}
+
+int WldCaptureIndex::save(const std::string &capture) const
+{
+    // only a capture indexed to its very end is worth keeping
+    uint32_t stamp[4];
+    if (!getFileStamp(capture, stamp) || (((uint64_t)stamp[0] << 32) | stamp[1]) != size)
+        return -1;
+
+    std::vector<char> data;
+    putUInt32(data, WLD_INDEX_MAGIC);
+    putUInt32(data, WLD_INDEX_VERSION);
+    for (int i = 0; i < 4; i++)
+        putUInt32(data, stamp[i]);
+
+    putUInt64(data, size);
+    putUInt64(data, messages);
+    putUInt32(data, entries.size());
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const Entry &entry = entries[i];
+        putUInt64(data, entry.offset);
+        putUInt64(data, entry.message);
+        putUInt32(data, entry.seq);
+        putUInt32(data, entry.first.tv_sec);
+        putUInt32(data, entry.first.tv_usec);
+        putUInt32(data, entry.last.tv_sec);
+        putUInt32(data, entry.last.tv_usec);
+    }
+
+    putUInt32(data, counts.size());
+    counts_t::const_iterator it = counts.begin();
+    for (; it != counts.end(); it++)
+    {
+        putString(data, it->first);
+        putUInt64(data, it->second);
+    }
+
+    return writeFile(capture + WLD_INDEX_SUFFIX, data);
+}
+
+void WldCaptureIndex::build(const char *records, size_t size, const WldProtocolAnalyzer *analyzer)
+{
+    clear();
+
+    // a scratch analyzer follows the objects from where the given one is
+    WldProtocolAnalyzer *scanner = NULL;
+    if (analyzer)
+    {
+        std::vector<char> state;
+        analyzer->saveState(state);
+
+        scanner = new WldProtocolAnalyzer(*analyzer, NULL);
+        if (scanner->restoreState(&state[0], state.size()))
+        {
+            delete scanner;
+            scanner = NULL;
+        }
+    }
+
+    size_t pos = 0;
+    uint32_t record_count = 0;
+    timeval latest = { 0, 0 };
+    while (pos < size)
+    {
+        WlaMessageView msg;
+        int len = msg.parseRecord(records + pos, size - pos);
+        if (len < 0)
+            break;
+
+        if (timercmp(&latest, msg.getTimeStamp(), <))
+            latest = *msg.getTimeStamp();
+
+        if (record_count++ % RECORDS_PER_ENTRY == 0)
+        {
+            Entry entry;
+            entry.offset = pos;
+            entry.message = messages;
+            entry.seq = msg.getSeq();
+            entry.first = *msg.getTimeStamp();
+            entries.push_back(entry);
+        }
+        entries.back().last = latest;
+        pos += len;
+
+        WLD_MESSAGE_TYPE type = msg.getType() == WlaMessageBuffer::EVENT_TYPE ?
+                    WLD_MSG_EVENT : WLD_MSG_REQUEST;
+        WlaMessageIterator it(msg);
+        while (it.next())
+        {
+            messages++;
+            if (scanner)
+            {
+                const WldInterface *intf = scanner->getObject(it.getObjectId());
+                counts[intf ? intf->name : "unknown"]++;
+                scanner->scan(it.getObjectId(), it.getOpcode(), type, it.getPayload(),
+                              it.getPayloadSize());
+            }
+        }
+    }
+
+    this->size = pos;
+    delete scanner;
+}
+
+void WldCaptureIndex::clear()
+{
+    entries.clear();
+    counts.clear();
+    size = 0;
+    messages = 0;
+}
+
+const WldCaptureIndex::Entry *WldCaptureIndex::findTime(const timeval &time) const
+{
+    // last only ever grows, so the entries can be bisected on it
+    size_t lo = 0;
+    size_t hi = entries.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (timercmp(&entries[mid].last, &time, <))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo < entries.size() ? &entries[lo] : NULL;
+}
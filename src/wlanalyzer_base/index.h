@@ -0,0 +1,81 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <sys/time.h>
+#include <tr1/unordered_map>
+#include <string>
+#include <vector>
+#include "analyzer.h"
+
+const uint32_t WLD_INDEX_MAGIC = 0x574c4449; // "WLDI"
+const uint32_t WLD_INDEX_VERSION = 1;
+const char WLD_INDEX_SUFFIX[] = ".idx";
+
+// Where every so many records of a record capture start and when they
+// were taken, plus how many messages each interface got. Kept in
+// <capture>.idx and only used while the capture keeps its size and mtime.
+class WldCaptureIndex
+{
+public:
+    struct Entry
+    {
+        uint64_t offset;
+        uint64_t message; // index of the first message
+        uint32_t seq;
+        timeval first;
+        timeval last; // the latest seen up to the end of the entry
+    };
+
+    typedef std::tr1::unordered_map<std::string, uint64_t> counts_t;
+
+    WldCaptureIndex() : size(0), messages(0) {}
+
+    int load(const std::string &capture);
+    int save(const std::string &capture) const;
+    // Indexes the records, the interfaces are only counted with an
+    // analyzer that has its protocol loaded
+    void build(const char *records, size_t size, const WldProtocolAnalyzer *analyzer);
+    void clear();
+
+    // the first entry with records taken at or after time, NULL if none
+    const Entry *findTime(const timeval &time) const;
+
+    const std::vector<Entry> &getEntries() const { return entries; }
+    const counts_t &getInterfaceCounts() const { return counts; }
+    uint64_t getSize() const { return size; }
+    uint64_t getMessageCount() const { return messages; }
+
+private:
+    static const uint32_t RECORDS_PER_ENTRY = 4096;
+
+    std::vector<Entry> entries;
+    counts_t counts;
+    uint64_t size; // of the records indexed
+    uint64_t messages;
+};
+
+#endif // INDEX_H
@@ -31,6 +31,7 @@
 #include "logger.h"
 
 Logger *Logger::_instance = NULL;
+__thread std::string *Logger::thread_buffer = NULL;
 
 Logger::~Logger()
 {
@@ -52,12 +53,40 @@ int Logger::log(const char *format, ...)
 
     va_list vargs;
     va_start(vargs, format);
-    l = vfprintf(_fd, format, vargs);
+    if (!thread_buffer)
+    {
+        l = vfprintf(_fd, format, vargs);
+        va_end(vargs);
+        return l;
+    }
+
+    char buf[256];
+    va_list copy;
+    va_copy(copy, vargs);
+    l = vsnprintf(buf, sizeof(buf), format, copy);
+    va_end(copy);
+
+    if (l >= (int)sizeof(buf))
+    {
+        size_t pos = thread_buffer->size();
+        thread_buffer->resize(pos + l + 1);
+        vsnprintf(&(*thread_buffer)[pos], l + 1, format, vargs);
+        thread_buffer->resize(pos + l);
+    }
+    else if (l > 0)
+    {
+        thread_buffer->append(buf, l);
+    }
     va_end(vargs);
 
     return l;
 }
 
+void Logger::write(const std::string &text)
+{
+    fwrite(text.data(), 1, text.size(), _fd);
+}
+
 Logger::Logger()
 {
     open();
@@ -27,6 +27,7 @@
 #define LOGGER_H
 
 #include <stdio.h>
+#include <string>
 
 #ifndef DEBUG_BUILD
 #define DEBUG_LOG(msg, ...)
@@ -43,6 +44,11 @@ public:
     static Logger *getInstance();
 
     int log(const char *format, ...);
+    void write(const std::string &text);
+
+    // What the calling thread logs is appended to buffer instead, until
+    // it is set back to NULL
+    static void setThreadBuffer(std::string *buffer) { thread_buffer = buffer; }
 
 private:
     Logger();
@@ -52,6 +58,7 @@ private:
 
 private:
     static Logger *_instance;
+    static __thread std::string *thread_buffer;
     FILE *_fd;
 };
 
@@ -41,6 +41,7 @@ WlaMessageBuffer::WlaMessageBuffer()
     hdr.cmsg_len = 0;
     hdr.timestamp.tv_sec = 0;
     hdr.timestamp.tv_usec = 0;
+    connection = 0;
 }
 
 WlaMessageBuffer::~WlaMessageBuffer()
@@ -125,3 +126,158 @@ void WlaMessageBuffer::setControlMsg(const char *cmsg, int size)
 {
     memcpy(this->cmsg, cmsg, size);
 }
+
+void WlaMessageBuffer::setGap(uint32_t count)
+{
+    hdr.flags = 0;
+    set_bit(&hdr.flags, MESSAGE_GAP_BIT, true);
+    gettimeofday(&hdr.timestamp, NULL);
+    hdr.msg_len = sizeof(count);
+    hdr.cmsg_len = 0;
+
+    uint32_t nbo_count = htonl(count);
+    memcpy(buf, &nbo_count, sizeof(nbo_count));
+}
+
+uint32_t WlaMessageBuffer::getGapCount() const
+{
+    if (!isGap() || hdr.msg_len < sizeof(uint32_t))
+        return 0;
+
+    uint32_t nbo_count;
+    memcpy(&nbo_count, buf, sizeof(nbo_count));
+
+    return ntohl(nbo_count);
+}
+
+size_t WlaMessageBuffer::getRecordSize() const
+{
+    return sizeof(uint32_t) + WlaMessageBufferHeader::getSerializeSize() +
+            hdr.msg_len + hdr.cmsg_len;
+}
+
+int WlaMessageBuffer::serializeRecord(uint32_t seq, char *record, size_t size)
+{
+    if (size < getRecordSize())
+    {
+        DEBUG_LOG("buffer too small");
+        return -1;
+    }
+
+    char *p = record;
+    memcpy(p, &seq, sizeof(seq));
+    p += sizeof(seq);
+
+    p += hdr.serializeToBuf(p, WlaMessageBufferHeader::getSerializeSize());
+
+    memcpy(p, buf, hdr.msg_len);
+    p += hdr.msg_len;
+
+    memcpy(p, cmsg, hdr.cmsg_len);
+    p += hdr.cmsg_len;
+
+    return p - record;
+}
+
+int WlaMessageBuffer::deserializeRecord(const char *record, size_t size, uint32_t *seq)
+{
+    size_t hdr_size = WlaMessageBufferHeader::getSerializeSize();
+    if (size < sizeof(uint32_t) + hdr_size)
+    {
+        DEBUG_LOG("record too short");
+        return -1;
+    }
+
+    const char *p = record;
+    if (seq)
+        memcpy(seq, p, sizeof(uint32_t));
+    p += sizeof(uint32_t);
+
+    hdr.deserializeFromBuf(p, hdr_size);
+    p += hdr_size;
+
+    if (hdr.msg_len > MAX_BUF_SIZE || hdr.cmsg_len > sizeof(cmsg) ||
+            size < (size_t)(p - record) + hdr.msg_len + hdr.cmsg_len)
+    {
+        DEBUG_LOG("invalid record");
+        return -1;
+    }
+
+    memcpy(buf, p, hdr.msg_len);
+    p += hdr.msg_len;
+
+    memcpy(cmsg, p, hdr.cmsg_len);
+    p += hdr.cmsg_len;
+
+    return p - record;
+}
+
+WlaMessageView::WlaMessageView() : seq(0), msg(NULL), cmsg(NULL)
+{
+    hdr.flags = 0;
+    hdr.msg_len = 0;
+    hdr.cmsg_len = 0;
+    hdr.timestamp.tv_sec = 0;
+    hdr.timestamp.tv_usec = 0;
+}
+
+WlaMessageView::WlaMessageView(const WlaMessageBuffer &buffer, uint32_t seq) :
+    hdr(*buffer.getHeader()), seq(seq), msg(buffer.getMsg()), cmsg(buffer.getControlMsg())
+{
+}
+
+int WlaMessageView::parseRecord(const char *record, size_t size)
+{
+    size_t hdr_size = WlaMessageBufferHeader::getSerializeSize();
+    if (size < sizeof(uint32_t) + hdr_size)
+    {
+        DEBUG_LOG("record too short");
+        return -1;
+    }
+
+    memcpy(&seq, record, sizeof(seq));
+    hdr.deserializeFromBuf(record + sizeof(uint32_t), hdr_size);
+
+    size_t len = sizeof(uint32_t) + hdr_size + hdr.msg_len + hdr.cmsg_len;
+    if (hdr.msg_len > size || hdr.cmsg_len > size || len > size)
+    {
+        DEBUG_LOG("invalid record");
+        return -1;
+    }
+
+    msg = record + sizeof(uint32_t) + hdr_size;
+    cmsg = msg + hdr.msg_len;
+
+    return len;
+}
+
+size_t WlaMessageView::getRecordSize(const char *record, size_t size)
+{
+    size_t hdr_size = WlaMessageBufferHeader::getSerializeSize();
+    if (size < sizeof(uint32_t) + hdr_size)
+        return 0;
+
+    WlaMessageBufferHeader hdr;
+    hdr.deserializeFromBuf(record + sizeof(uint32_t), hdr_size);
+
+    return sizeof(uint32_t) + hdr_size + (size_t)hdr.msg_len + hdr.cmsg_len;
+}
+
+WlaMessageBuffer::MESSAGE_TYPE WlaMessageView::getType() const
+{
+    if (bit_isset(hdr.flags, MESSAGE_EVENT_TYPE_BIT))
+        return WlaMessageBuffer::EVENT_TYPE;
+    else
+        return WlaMessageBuffer::REQUEST_TYPE;
+}
+
+uint32_t WlaMessageView::getGapCount() const
+{
+    if (!isGap() || hdr.msg_len < sizeof(uint32_t))
+        return 0;
+
+    uint32_t nbo_count;
+    memcpy(&nbo_count, msg, sizeof(nbo_count));
+
+    return ntohl(nbo_count);
+}
@@ -25,6 +25,7 @@
 #ifndef MESSAGE_H
 #define MESSAGE_H
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <sys/time.h>
 #include "common.h"
@@ -32,6 +33,7 @@
 
 const int MESSAGE_EVENT_TYPE_BIT = 0x00;
 const int CMESSAGE_PRESENT_BIT = 0x01;
+const int MESSAGE_GAP_BIT = 0x02;
 
 const int CLIENT_ID_OFFSET = 0;
 const int SIZE_OFFSET = 6;
@@ -125,6 +127,7 @@ public:
 
     void setHeader(const WlaMessageBufferHeader *hdr);
     WlaMessageBufferHeader *getHeader() { return &hdr; }
+    const WlaMessageBufferHeader *getHeader() const { return &hdr; }
 
     void setType(MESSAGE_TYPE type);
     MESSAGE_TYPE getType() const;
@@ -138,6 +141,20 @@ public:
     void setControlMsg(const char *cmsg, int size);
     const char *getControlMsg() const { return cmsg; }
 
+    // A gap marker stands in for count messages that were dropped
+    void setGap(uint32_t count);
+    bool isGap() const { return bit_isset(hdr.flags, MESSAGE_GAP_BIT); }
+    uint32_t getGapCount() const;
+
+    // A record is what the dumpers store: seq, header, payload and control message
+    size_t getRecordSize() const;
+    int serializeRecord(uint32_t seq, char *record, size_t size);
+    int deserializeRecord(const char *record, size_t size, uint32_t *seq = NULL);
+
+    // The proxied connection it came through, not part of the record
+    void setConnection(uint32_t id) { connection = id; }
+    uint32_t getConnection() const { return connection; }
+
 private:
     static const int MAX_BUF_SIZE = 4096;
     static const int MAX_FDS = 28;
@@ -149,6 +166,82 @@ private:
     msghdr msg;
     char cmsg[CMSG_LEN(MAX_FDS * sizeof(int))];
     iovec iov;
+    uint32_t connection;
+};
+
+// Read-only view of a message that doesn't own the data: either a
+// WlaMessageBuffer or a record stored somewhere else, e.g. in a block or
+// a shared memory ring. It is only valid as long as what it points to.
+class WlaMessageView
+{
+public:
+    WlaMessageView();
+    explicit WlaMessageView(const WlaMessageBuffer &buffer, uint32_t seq = 0);
+
+    // Returns the size of the record or -1 if it is invalid
+    int parseRecord(const char *record, size_t size);
+    // Size of the record starting at record, 0 if size doesn't cover its header yet
+    static size_t getRecordSize(const char *record, size_t size);
+
+    uint32_t getSeq() const { return seq; }
+    const WlaMessageBufferHeader *getHeader() const { return &hdr; }
+
+    WlaMessageBuffer::MESSAGE_TYPE getType() const;
+    const timeval *getTimeStamp() const { return &hdr.timestamp; }
+
+    uint32_t getMsgSize() const { return hdr.msg_len; }
+    const char *getMsg() const { return msg; }
+
+    uint32_t getControlMsgSize() const { return hdr.cmsg_len; }
+    const char *getControlMsg() const { return cmsg; }
+
+    bool isGap() const { return bit_isset(hdr.flags, MESSAGE_GAP_BIT); }
+    uint32_t getGapCount() const;
+
+private:
+    WlaMessageBufferHeader hdr;
+    uint32_t seq;
+    const char *msg;
+    const char *cmsg;
+};
+
+// Walks the wayland messages packed into one record. The last one may be
+// cut short by the end of the record, a message of size 0 ends the walk.
+class WlaMessageIterator
+{
+public:
+    explicit WlaMessageIterator(const WlaMessageView &view) :
+        msg(view.getMsg()), size(view.isGap() ? 0 : view.getMsgSize()), pos(0), next_pos(0)
+    {
+    }
+
+    bool next()
+    {
+        if (next_pos >= size || size - next_pos < (uint32_t)PAYLOAD_OFFSET)
+            return false;
+
+        pos = next_pos;
+        uint16_t msg_size = getSize();
+        next_pos = msg_size ? pos + msg_size : size;
+
+        return true;
+    }
+
+    uint32_t getObjectId() const { return byteArrToUInt32(&msg[pos + CLIENT_ID_OFFSET]); }
+    uint16_t getOpcode() const { return byteArrToUInt16(&msg[pos + OPCODE_OFFSET]); }
+    uint16_t getSize() const { return byteArrToUInt16(&msg[pos + SIZE_OFFSET]); }
+    const char *getPayload() const { return msg + pos + PAYLOAD_OFFSET; }
+    uint32_t getPayloadSize() const
+    {
+        uint32_t len = std::min<uint32_t>(getSize(), size - pos);
+        return len > (uint32_t)PAYLOAD_OFFSET ? len - PAYLOAD_OFFSET : 0;
+    }
+
+private:
+    const char *msg;
+    uint32_t size;
+    uint32_t pos;
+    uint32_t next_pos;
 };
 
 #endif // MESSAGE_H
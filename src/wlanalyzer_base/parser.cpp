@@ -23,8 +23,12 @@
  */
 
 #include <time.h>
+#include <algorithm>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/inotify.h>
 #include <fcntl.h>
+#include "checkpoint.h"
 #include "dumper.h"
 #include "parser.h"
 
@@ -48,66 +52,72 @@ void WldParser::attachAnalyzer(WldProtocolAnalyzer *analyzer)
 
 int WldParser::parse()
 {
-    WlaMessageBuffer *msg;
+    WlaMessageView msg;
 
-    while ((msg = nextMessage()) != NULL)
-    {
+    while (nextMessage(msg))
         parseMessage(msg);
 
-        delete msg;
-    }
-
     return 0;
 }
 
-void WldParser::parseMessage(WlaMessageBuffer *msg)
+void WldParser::parseMessage(const WlaMessageView &msg)
 {
-    const char *msg_buf = msg->getMsg();
-    uint32_t i = 0;
+    if (msg.isGap())
+    {
+        Logger::getInstance()->log("%u messages were dropped by the dumper\n", msg.getGapCount());
+        return;
+    }
 
     char timestr[64];
     time_t nowtime;
-    tm *nowtm;
-    nowtime = msg->getTimeStamp()->tv_sec;
-    nowtm = localtime(&nowtime);
-    strftime(timestr, sizeof(timestr), "%H:%M:%S", nowtm);
+    tm nowtm;
+    nowtime = msg.getTimeStamp()->tv_sec;
+    localtime_r(&nowtime, &nowtm);
+    strftime(timestr, sizeof(timestr), "%H:%M:%S", &nowtm);
 
-    while (i < msg->getMsgSize())
-    {
-        uint32_t client_id = byteArrToUInt32(&msg_buf[CLIENT_ID_OFFSET]);
-        uint16_t size = byteArrToUInt16(&msg_buf[SIZE_OFFSET]);
-        uint16_t opcode = byteArrToUInt16(&msg_buf[OPCODE_OFFSET]);
-
-		Logger::getInstance()->log("%s msg (%s.%03d), id %d, opcode %d, size %d\n",
-				  msg->getType() == WlaMessageBuffer::EVENT_TYPE ? "event" : "request",
-				  timestr, msg->getTimeStamp()->tv_usec / 1000,
-				  client_id, opcode, size);
+    if (analyzer)
+        analyzer->setTimeStamp(*msg.getTimeStamp());
 
-        if (analyzer)
-        {
-            WLD_MESSAGE_TYPE type;
-            if (msg->getType() == WlaMessageBuffer::EVENT_TYPE)
-                type = WLD_MSG_EVENT;
-            else
-                type = WLD_MSG_REQUEST;
-            analyzer->lookup(client_id, opcode, type, msg_buf + PAYLOAD_OFFSET);
-        }
+    WLD_MESSAGE_TYPE type = msg.getType() == WlaMessageBuffer::EVENT_TYPE ?
+                WLD_MSG_EVENT : WLD_MSG_REQUEST;
 
-        if (size == 0)
-            break;
+    WlaMessageIterator it(msg);
+    while (it.next())
+    {
+        // a filtering analyzer shows what matches on its own
+        if (!analyzer || !analyzer->getFilter())
+            Logger::getInstance()->log("%s msg (%s.%03d), id %d, opcode %d, size %d\n",
+                                       type == WLD_MSG_EVENT ? "event" : "request",
+                                       timestr, msg.getTimeStamp()->tv_usec / 1000,
+                                       it.getObjectId(), it.getOpcode(), it.getSize());
 
-        msg_buf += size;
-        i += size;
+        if (analyzer)
+            analyzer->lookup(it.getObjectId(), it.getOpcode(), type, it.getPayload(),
+                             it.getPayloadSize());
     }
 }
 
-WlaBinParser::WlaBinParser()
+void WldParser::scanMessage(const WlaMessageView &msg)
+{
+    if (analyzer && !msg.isGap())
+        analyzer->scanRecord(msg);
+}
+
+WlaBinParser::WlaBinParser() : mapped(false), records(NULL), map_size(0), read_pos(0),
+    read_len(0), indexed(false), has_end(false)
 {
     file = -1;
+    notify = -1;
+    format = FORMAT_UNKNOWN;
 }
 
 WlaBinParser::~WlaBinParser()
 {
+    notifywtch.stop();
+    if (notify != -1)
+        close(notify);
+
+    unmapFile();
     close(file);
 }
 
@@ -119,6 +129,12 @@ int WlaBinParser::openResource(const std::string &path)
         return -1;
     }
 
+    notifywtch.stop();
+    if (notify != -1)
+        close(notify);
+    notify = -1;
+
+    unmapFile();
     if (file != -1)
         close(file);
 
@@ -130,8 +146,40 @@ int WlaBinParser::openResource(const std::string &path)
         return -1;
     }
 
+    format = FORMAT_UNKNOWN;
+    read_pos = read_len = 0;
+    this->path = path;
+    index.clear();
+    indexed = false;
+
+    struct stat st;
+    mapped = !fstat(file, &st) && S_ISREG(st.st_mode);
+    if (!mapped)
+    {
+        read_buf.resize(READ_BUFFER_SIZE);
+        records = &read_buf[0];
+    }
+    else
+    {
+        // the watch is there from now on, so no write can slip between
+        // hitting the end of the file and waiting for more
+        notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (notify != -1 && inotify_add_watch(notify, path.c_str(), IN_MODIFY) == -1)
+        {
+            close(notify);
+            notify = -1;
+        }
+
+        if (notify == -1)
+            DEBUG_LOG("inotify unavailable, polling %s", path.c_str());
+    }
+
     timer.set<WlaBinParser, &WlaBinParser::timerEvent>(this);
     filewtch.set<WlaBinParser, &WlaBinParser::handleFileEvent>(this);
+    notifywtch.set<WlaBinParser, &WlaBinParser::handleNotifyEvent>(this);
+
+    // later opens only load the sidecar
+    getIndex();
 
     return 0;
 }
@@ -139,9 +187,15 @@ int WlaBinParser::openResource(const std::string &path)
 void WlaBinParser::enable(bool state)
 {
     if (state)
+    {
         filewtch.start(file, EV_READ);
+    }
     else
+    {
         filewtch.stop();
+        notifywtch.stop();
+        timer.stop();
+    }
 }
 
 void WlaBinParser::handleFileEvent(ev::io &watcher, int revents)
@@ -158,6 +212,21 @@ void WlaBinParser::handleFileEvent(ev::io &watcher, int revents)
     }
 }
 
+void WlaBinParser::handleNotifyEvent(ev::io &watcher, int revents)
+{
+    if (revents & EV_ERROR)
+    {
+        DEBUG_LOG("got error event");
+        return;
+    }
+
+    char buf[4096];
+    while (read(notify, buf, sizeof(buf)) > 0)
+        continue;
+
+    parse();
+}
+
 void WlaBinParser::timerEvent(ev::timer &timer, int revents)
 {
     if (revents & EV_ERROR)
@@ -172,86 +241,275 @@ void WlaBinParser::timerEvent(ev::timer &timer, int revents)
     timer.stop();
 }
 
-WlaMessageBuffer *WlaBinParser::nextMessage()
+bool WlaBinParser::detectFormat()
 {
-    uint32_t len;
-    WlaMessageBuffer *msg = new WlaMessageBuffer;
+    // block captures are read by offset, which pipes can't do
+    if (!mapped)
+    {
+        format = FORMAT_RECORDS;
+        return true;
+    }
+
+    uint32_t file_hdr[2];
+    ssize_t len = pread(file, file_hdr, sizeof(file_hdr), 0);
+    if (len < (ssize_t)sizeof(uint32_t))
+        return false;
 
-    uint32_t seq;
-    read(file, &seq, sizeof(uint32_t));
+    uint32_t magic = ntohl(file_hdr[0]);
+    if (magic != WLD_BLOCK_FILE_MAGIC && magic != WLD_COLUMN_FILE_MAGIC)
+    {
+        format = FORMAT_RECORDS;
+        return true;
+    }
 
-    uint32_t size = msg->getHeader()->getSerializeSize();
-    char *buf = new char[size];
+    if (len < (ssize_t)WLD_BLOCK_FILE_HEADER_SIZE)
+        return false;
 
-    while ((len = read(file, buf, size)) < 0 && errno == EAGAIN)
+    if (ntohl(file_hdr[1]) != WLD_BLOCK_FILE_VERSION)
     {
-        continue;
+        Logger::getInstance()->log("Unsupported capture file version %u\n", ntohl(file_hdr[1]));
+        return false;
     }
 
-    if (len < 0)
+    blocks.setFile(file, WLD_BLOCK_FILE_HEADER_SIZE, magic == WLD_COLUMN_FILE_MAGIC);
+    format = FORMAT_BLOCKS;
+
+    return true;
+}
+
+void WlaBinParser::waitForData()
+{
+    filewtch.stop();
+
+    if (notify == -1)
+        timer.start(0.2, 0.0);
+    else if (!notifywtch.is_active())
+        notifywtch.start(notify, EV_READ);
+}
+
+bool WlaBinParser::nextBlockMessage(WlaMessageView &msg)
+{
+    size_t len;
+    const char *record;
+
+    // records are parsed right where the block reader decoded them
+    while ((record = blocks.nextRecord(&len)) != NULL)
     {
-        delete msg;
-        return NULL;
+        if (msg.parseRecord(record, len) < 0)
+            continue;
+
+        DEBUG_LOG("seq %d flags %d size %d", msg.getSeq(), msg.getHeader()->flags, msg.getMsgSize());
+
+        return true;
     }
-    else if (len == 0)
+
+    waitForData();
+
+    return false;
+}
+
+bool WlaBinParser::nextMessage(WlaMessageView &view)
+{
+    if (format == FORMAT_UNKNOWN && !detectFormat())
     {
-        timer.start(0.2, 0.0);
-        filewtch.stop();
+        waitForData();
+        return false;
+    }
 
-        delete msg;
-        return NULL;
+    bool ok = format == FORMAT_BLOCKS ? nextBlockMessage(view) : nextRecordMessage(view);
+    if (ok && has_end && timercmp(view.getTimeStamp(), &end_time, >))
+    {
+        enable(false);
+        return false;
     }
 
-    if (len < size)
+    return ok;
+}
+
+bool WlaBinParser::nextRecordMessage(WlaMessageView &view)
+{
+    while (true)
     {
-        lseek(file, -len, SEEK_CUR);
-        delete [] buf;
-        delete msg;
+        const char *record = records + read_pos;
+        size_t avail = read_len - read_pos;
+        size_t need = WlaMessageView::getRecordSize(record, avail);
+
+        if (need > MAX_RECORD_SIZE)
+        {
+            Logger::getInstance()->log("Invalid record in the dump file, stopping\n");
+            enable(false);
+            return false;
+        }
+
+        if (need && avail >= need)
+        {
+            view.parseRecord(record, need);
+            read_pos += need;
+
+            DEBUG_LOG("seq %d flags %d size %d", view.getSeq(), view.getHeader()->flags,
+                      view.getMsgSize());
+
+            return true;
+        }
+
+        if (!need)
+            need = sizeof(uint32_t) + WlaMessageBufferHeader::getSerializeSize();
+
+        if (mapped ? !mapFile() : !readRecords(need))
+        {
+            waitForData();
+            return false;
+        }
+    }
+}
+
+const WldCaptureIndex *WlaBinParser::getIndex()
+{
+    if (!mapped || (format == FORMAT_UNKNOWN && !detectFormat()) || format != FORMAT_RECORDS)
         return NULL;
+
+    if (indexed)
+        return &index;
+
+    if (index.load(path))
+    {
+        mapFile();
+        index.build(records, read_len, analyzer);
+        if (index.save(path))
+            DEBUG_LOG("not saving the index of %s", path.c_str());
     }
+    indexed = true;
 
-    msg->getHeader()->deserializeFromBuf(buf, size);
-    delete [] buf;
+    return &index;
+}
+
+int WlaBinParser::seekTime(const timeval &time)
+{
+    const WldCaptureIndex *index = getIndex();
+    if (!index)
+        return -1;
+
+    mapFile();
 
-    lseek(file, 0, SEEK_CUR);
+    const WldCaptureIndex::Entry *entry = index->findTime(time);
+    size_t target = entry ? entry->offset : index->getSize();
+    if (target > read_len)
+        return -1;
 
-    char *msg_buf = new char[msg->getMsgSize()];
-    if ((len = read(file, msg_buf, msg->getMsgSize())) < 0)
+    // the objects have to be followed up to there, from the closest
+    // checkpoint if there is one
+    size_t pos = analyzer ? 0 : target;
+    bool restored = false;
+    WldCheckpoints checkpoints;
+    if (analyzer && entry && !checkpoints.load(path))
     {
-        DEBUG_LOG("failed to read from file");
-        delete [] msg_buf;
-        delete [] msg;
-        return NULL;
+        const WldCheckpoints::Checkpoint *checkpoint = checkpoints.find(entry->seq);
+        if (checkpoint && checkpoint->offset <= target && !checkpoint->state.empty() &&
+                !analyzer->restoreState(&checkpoint->state[0], checkpoint->state.size()))
+        {
+            pos = checkpoint->offset;
+            restored = true;
+        }
     }
-    else if (len < msg->getMsgSize())
+
+    // whatever was followed before doesn't hold for a replay from the start
+    if (analyzer && !restored)
+        analyzer->resetState();
+
+    while (pos < read_len)
     {
-        DEBUG_LOG("too short");
+        WlaMessageView msg;
+        int len = msg.parseRecord(records + pos, read_len - pos);
+        if (len < 0 || (pos >= target && !timercmp(msg.getTimeStamp(), &time, <)))
+            break;
+
+        scanMessage(msg);
+        pos += len;
     }
+    read_pos = pos;
 
-    msg->setMsg(msg_buf, msg->getMsgSize());
-    delete [] msg_buf;
+    return 0;
+}
 
-    if (bit_isset(msg->getHeader()->flags, CMESSAGE_PRESENT_BIT))
+void WlaBinParser::setEndTime(const timeval &time)
+{
+    end_time = time;
+    has_end = true;
+}
+
+// Maps the whole file again if it got longer, false if it didn't
+bool WlaBinParser::mapFile()
+{
+    struct stat st;
+    if (fstat(file, &st) || (size_t)st.st_size <= map_size)
+        return false;
+
+    unmapFile();
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (map == MAP_FAILED)
+    {
+        DEBUG_LOG("failed to map the dump file");
+        return false;
+    }
+
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(map, st.st_size, MADV_HUGEPAGE);
+#endif
+
+    records = (const char *)map;
+    map_size = read_len = st.st_size;
+
+    return true;
+}
+
+void WlaBinParser::unmapFile()
+{
+    if (mapped && records)
+        munmap((void *)records, map_size);
+
+    records = NULL;
+    map_size = 0;
+}
+
+// Reads more of the file into read_buf, false if nothing came
+bool WlaBinParser::readRecords(size_t need)
+{
+    if (read_buf.size() - read_pos < need || read_len == read_buf.size())
     {
-        char *cmsg_buf = new char[msg->getControlMsgSize()];
-        len = read(file, cmsg_buf, msg->getControlMsgSize());
-        if ( len < msg->getControlMsgSize())
-            DEBUG_LOG("too short");
-        msg->setControlMsg(cmsg_buf, msg->getControlMsgSize());
-        delete [] cmsg_buf;
+        memmove(&read_buf[0], &read_buf[0] + read_pos, read_len - read_pos);
+        read_len -= read_pos;
+        read_pos = 0;
+
+        if (read_buf.size() < need)
+            read_buf.resize(need);
+        records = &read_buf[0];
     }
 
-    DEBUG_LOG("seq %d flags %d size %d", seq, msg->getHeader()->flags, msg->getHeader()->msg_len);
+    ssize_t len;
+    do
+    {
+        len = read(file, &read_buf[read_len], read_buf.size() - read_len);
+    } while (len < 0 && errno == EINTR);
+
+    if (len <= 0)
+        return false;
+
+    read_len += len;
 
-    return msg;
+    return true;
 }
 
-WldNetParser::WldNetParser()
+WldNetParser::WldNetParser() : recv_buf(RECV_BUFFER_SIZE), recv_pos(0), recv_len(0),
+    frame_end(0), frame_left(0), read_budget(0), resume(false), next_seq(0)
 {
 }
 
 WldNetParser::~WldNetParser()
 {
+    timer.stop();
+    socketwtch.stop();
     socket.disconnectFromServer();
 }
 
@@ -263,22 +521,59 @@ int WldNetParser::openResource(const std::string &resource)
         return -1;
     }
 
+    address = resource;
+    resume = false;
+
+    return connectToDumper();
+}
+
+int WldNetParser::connectToDumper()
+{
     if (socket.isConnected())
         socket.disconnectFromServer();
 
-    int r = socket.connectToServer(resource);
+    int r = socket.connectToServer(address);
     if (r != NoError)
     {
-        DEBUG_LOG("Failed to connect to server %s %d", resource.c_str(), r);
+        DEBUG_LOG("Failed to connect to server %s %d", address.c_str(), r);
+        return -1;
+    }
+
+    uint32_t hello[] = { htonl(resume ? WLD_NET_RESUME : 0), htonl(next_seq) };
+    if (!socket.write((const char *)hello, sizeof(hello)))
+    {
+        socket.disconnectFromServer();
         return -1;
     }
 
+    recv_pos = recv_len = frame_end = 0;
+    frame_left = 0;
+
     socketwtch.set<WldNetParser, &WldNetParser::handleSocketEvent>(this);
     socketwtch.start(socket.getSocketDescriptor(), EV_READ);
 
     return 0;
 }
 
+void WldNetParser::connectionLost()
+{
+    Logger::getInstance()->log("Connection with the dumper lost, reconnecting\n");
+
+    socketwtch.stop();
+    socket.disconnectFromServer();
+
+    timer.set<WldNetParser, &WldNetParser::timerEvent>(this);
+    timer.start(RECONNECT_INTERVAL, RECONNECT_INTERVAL);
+}
+
+void WldNetParser::timerEvent(ev::timer &timer, int revents)
+{
+    if (connectToDumper())
+        return;
+
+    timer.stop();
+}
+
 void WldNetParser::handleSocketEvent(ev::io &watcher, int revents)
 {
     if (revents & EV_ERROR)
@@ -289,66 +584,99 @@ void WldNetParser::handleSocketEvent(ev::io &watcher, int revents)
 
     if (revents & EV_READ)
     {
+        read_budget = MAX_READ_PER_WAKEUP;
         parse();
     }
 }
 
-WlaMessageBuffer *WldNetParser::nextMessage()
+bool WldNetParser::nextFrame()
 {
-    WlaMessageBuffer *msg = new WlaMessageBuffer;
-
-    uint32_t seq;
-    if (!socket.readUntil((char *)&seq, sizeof(seq)))
+    while (true)
     {
-		DEBUG_LOG("stopping read");
-        socketwtch.stop();
-		delete msg;
-		return NULL;
-    }
+        size_t need = WLD_NET_FRAME_HEADER_SIZE;
+        if (recv_len - recv_pos >= need)
+        {
+            uint32_t header[3];
+            memcpy(header, &recv_buf[recv_pos], sizeof(header));
+            uint32_t len = ntohl(header[1]);
+            uint32_t count = ntohl(header[2]);
+
+            if (ntohl(header[0]) != WLD_NET_FRAME_MAGIC || len > WLD_NET_MAX_FRAME_SIZE ||
+                    !count != !len)
+            {
+                Logger::getInstance()->log("Invalid frame from the dumper\n");
+                connectionLost();
+                return false;
+            }
+
+            need += len;
+            if (recv_len - recv_pos >= need)
+            {
+                recv_pos += WLD_NET_FRAME_HEADER_SIZE;
+                frame_end = recv_pos + len;
+                frame_left = count;
+                return true;
+            }
+        }
 
-    uint32_t size = msg->getHeader()->getSerializeSize();
-    char *buf = new char[size];
-    memset(buf, 0, size);
+        if (!read_budget)
+            return false;
 
-    if (!socket.readUntil(buf, size))
-    {
-		DEBUG_LOG("stopping read");
-        socketwtch.stop();
-		delete msg;
-		return NULL;
-    }
-    msg->getHeader()->deserializeFromBuf(buf, size);
-    delete [] buf;
+        // keep the unparsed bytes at the front when the frame wouldn't fit
+        if (recv_buf.size() - recv_pos < need || recv_len == recv_buf.size())
+        {
+            memmove(&recv_buf[0], &recv_buf[recv_pos], recv_len - recv_pos);
+            recv_len -= recv_pos;
+            recv_pos = 0;
 
-    char *msg_buf = new char[msg->getMsgSize()];
-    if (!socket.readUntil(msg_buf, msg->getMsgSize()))
-    {
-		DEBUG_LOG("stopping read");
-        socketwtch.stop();
-		delete msg;
-		return NULL;
-    }
+            if (recv_buf.size() < need)
+                recv_buf.resize(need);
+        }
 
-    msg->setMsg(msg_buf, msg->getMsgSize());
-    delete [] msg_buf;
+        ssize_t len = recv(socket.getSocketDescriptor(), &recv_buf[recv_len],
+                           recv_buf.size() - recv_len, MSG_DONTWAIT);
+        if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR))
+        {
+            connectionLost();
+            return false;
+        }
 
-    if (bit_isset(msg->getHeader()->flags, CMESSAGE_PRESENT_BIT))
-    {
-        char *cmsg_buf = new char[msg->getControlMsgSize()];
-        if (!socket.readUntil(cmsg_buf, msg->getControlMsgSize()))
+        if (len < 0 && errno == EAGAIN)
+            return false;
+
+        if (len > 0)
         {
-			DEBUG_LOG("stopping read");
-            socketwtch.stop();
-			delete msg;
-			return NULL;
+            recv_len += len;
+            read_budget -= (size_t)len < read_budget ? len : read_budget;
         }
-        msg->setControlMsg(cmsg_buf, msg->getControlMsgSize());
-        delete [] cmsg_buf;
     }
+}
 
-    DEBUG_LOG("seq %d flags %d size %d", seq, msg->getHeader()->flags, msg->getHeader()->msg_len);
+bool WldNetParser::nextMessage(WlaMessageView &view)
+{
+    if (!socket.isConnected())
+        return false;
 
-    return msg;
-}
+    while (!frame_left)
+    {
+        if (!nextFrame())
+            return false;
+    }
 
+    int len = view.parseRecord(&recv_buf[recv_pos], frame_end - recv_pos);
+    if (len < 0 || (--frame_left == 0 && recv_pos + len != frame_end))
+    {
+        Logger::getInstance()->log("Invalid frame from the dumper\n");
+        connectionLost();
+        return false;
+    }
+    recv_pos += len;
+
+    DEBUG_LOG("seq %d flags %d size %d", view.getSeq(), view.getHeader()->flags,
+              view.getHeader()->msg_len);
 
+    resume = true;
+    next_seq = view.getSeq() + (view.isGap() ? view.getGapCount() : 1);
+
+    return true;
+}
@@ -26,9 +26,11 @@
 #define PARSER_H
 
 #include <ev++.h>
+#include "block.h"
 #include "message.h"
 #include "common.h"
 #include "analyzer.h"
+#include "index.h"
 
 class WldParser
 {
@@ -39,20 +41,23 @@ public:
     void attachAnalyzer(WldProtocolAnalyzer *analyzer);
     virtual int openResource(const std::string &resource) = 0;
     int parse();
+    // The capture is over, parse whatever is left of it
+    virtual void finish() { parse(); }
 	void enable(bool state = true)
 	{
 	}
 
 protected:
-    virtual WlaMessageBuffer *nextMessage() = 0;
-    void parseMessage(WlaMessageBuffer *msg);
+    // The view only has to stay valid until the next call
+    virtual bool nextMessage(WlaMessageView &msg) = 0;
+    void parseMessage(const WlaMessageView &msg);
+    // only follows the objects, for messages that aren't shown
+    void scanMessage(const WlaMessageView &msg);
 
 protected:
     WldProtocolAnalyzer *analyzer;
 };
 
-// TODO: Refactor WlaBinParser so that it holds an internal message queue.
-// Make nextMessage() generic!
 class WlaBinParser : public WldParser
 {
 public:
@@ -63,15 +68,65 @@ public:
 //    void attachAnalyzer(WldProtocolAnalyzer *analyzer);
     void enable(bool state = true);
 
+    // The index of a record capture, built when it is opened unless there
+    // is a valid <path>.idx already. NULL for other captures. Attach the
+    // analyzer before opening to have the messages counted by interface.
+    const WldCaptureIndex *getIndex();
+    // Time ranges of record captures: seeking skips to the first record
+    // taken at or after time, and must happen before parsing. The objects
+    // are followed from the nearest checkpoint, or from the start of the
+    // capture. Records taken after the end time aren't parsed.
+    int seekTime(const timeval &time);
+    void setEndTime(const timeval &time);
+
 private:
+    enum FileFormat
+    {
+        FORMAT_UNKNOWN,
+        FORMAT_RECORDS,
+        FORMAT_BLOCKS
+    };
+
     void handleFileEvent(ev::io &watcher, int revents);
+    void handleNotifyEvent(ev::io &watcher, int revents);
     void timerEvent(ev::timer &timer, int revents);
-    WlaMessageBuffer *nextMessage();
+    bool detectFormat();
+    void waitForData();
+    bool nextMessage(WlaMessageView &msg);
+    bool nextBlockMessage(WlaMessageView &msg);
+    bool nextRecordMessage(WlaMessageView &msg);
+    bool mapFile();
+    void unmapFile();
+    bool readRecords(size_t need);
 
 private:
+    static const size_t READ_BUFFER_SIZE = 256 * 1024;
+    static const size_t MAX_RECORD_SIZE = 16 * 1024 * 1024;
+
+    // Records are parsed in place: regular files are mapped and remapped
+    // as they grow, anything else is read in chunks into read_buf. One
+    // that was only partly written yet is retried once more shows up.
+    bool mapped;
+    const char *records;
+    size_t map_size;
+    std::vector<char> read_buf;
+    size_t read_pos;
+    size_t read_len;
+
     ev::timer timer;
     int file;
     ev::io filewtch;
+    // a regular file is always readable, inotify tells when it grows
+    int notify;
+    ev::io notifywtch;
+    FileFormat format;
+    WldBlockReader blocks;
+
+    std::string path;
+    WldCaptureIndex index;
+    bool indexed;
+    bool has_end;
+    timeval end_time;
 };
 
 class WldNetParser : public WldParser
@@ -83,12 +138,35 @@ public:
     int openResource(const std::string &resource);
 
 private:
+    int connectToDumper();
+    void connectionLost();
     void handleSocketEvent(ev::io &watcher, int revents);
-    WlaMessageBuffer *nextMessage();
+    void timerEvent(ev::timer &timer, int revents);
+    bool nextFrame();
+    bool nextMessage(WlaMessageView &msg);
 
 private:
+    static const int RECONNECT_INTERVAL = 1; // seconds
+    static const size_t RECV_BUFFER_SIZE = 256 * 1024;
+    // read at most that much per wakeup to let the other watchers run
+    static const size_t MAX_READ_PER_WAKEUP = 1024 * 1024;
+
+    // whole frames are received in here and parsed in place
+    std::vector<char> recv_buf;
+    size_t recv_pos;
+    size_t recv_len;
+    size_t frame_end;
+    uint32_t frame_left; // records left in the current frame
+    size_t read_budget;
+
     WldNetSocket socket;
     ev::io socketwtch;
+    ev::timer timer;
+    std::string address;
+
+    // where to resume after a reconnect
+    bool resume;
+    uint32_t next_seq;
 };
 
 #endif // PARSER_H
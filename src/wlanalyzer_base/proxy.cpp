@@ -77,8 +77,11 @@ void WlaProxyServer::stopServer()
     if (_serverSocket.isListening())
         _serverSocket.close();
 
+    if (dumper)
+        dumper->flush();
+
     if (parser)
-        parser->parse();
+        parser->finish();
 
     std::set<WlaConnection *>::const_iterator it = _connections.begin();
     for (; it != _connections.end(); it++)
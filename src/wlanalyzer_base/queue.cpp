@@ -0,0 +1,471 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include "logger.h"
+#include "message.h"
+#include "queue.h"
+
+WldQueueParser::WldQueueParser() : reading(NULL), threaded(false), running(false),
+    dropped(0), shard_base(NULL), connection(0)
+{
+    current = new Batch;
+    current->data.reserve(BATCH_SIZE);
+    current->pos = 0;
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cond, NULL);
+
+    prepare.set<WldQueueParser, &WldQueueParser::prepareEvent>(this);
+}
+
+WldQueueParser::~WldQueueParser()
+{
+    finish();
+
+    delete current;
+    delete reading;
+    for (size_t i = 0; i < pending.size(); i++)
+        delete pending[i];
+    for (size_t i = 0; i < spare.size(); i++)
+        delete spare[i];
+
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&lock);
+
+    if (dropped)
+        Logger::getInstance()->log("The analysis fell behind, %lu messages were dropped\n", dropped);
+
+    // the analyzer is one of the shards then
+    if (shard_base)
+        analyzer = NULL;
+    shards_t::iterator it = shards.begin();
+    for (; it != shards.end(); it++)
+        delete it->second;
+}
+
+int WldQueueParser::openResource(const std::string &resource)
+{
+    return 0;
+}
+
+int WldQueueParser::startThread()
+{
+    if (threaded)
+    {
+        DEBUG_LOG("analysis thread already running");
+        return -1;
+    }
+
+    threaded = running = true;
+    if (pthread_create(&thread, NULL, analysisThread, this))
+    {
+        DEBUG_LOG("failed to start the analysis thread");
+        threaded = running = false;
+        return -1;
+    }
+
+    return 0;
+}
+
+void WldQueueParser::shardConnections(const WldProtocolAnalyzer *base)
+{
+    attachAnalyzer(NULL);
+    shard_base = base;
+    base->saveState(shard_state);
+}
+
+void WldQueueParser::push(uint32_t seq, WlaMessageBuffer &msg)
+{
+    // markers for what was dropped go before anything newer
+    if ((!gaps.empty() || !closed.empty()) && current->data.empty())
+        queueGaps();
+
+    append(seq, msg);
+
+    if (threaded && current->data.size() >= BATCH_SIZE)
+        submitBatch();
+
+    if (!prepare.is_active())
+        prepare.start();
+}
+
+void WldQueueParser::closeConnection(uint32_t connection)
+{
+    if (!shard_base)
+        return;
+
+    if ((!gaps.empty() || !closed.empty()) && current->data.empty())
+        queueGaps();
+
+    appendClose(connection);
+
+    if (!prepare.is_active())
+        prepare.start();
+}
+
+void WldQueueParser::append(uint32_t seq, WlaMessageBuffer &msg)
+{
+    // the records are queued after the connection they came through
+    size_t len = msg.getRecordSize();
+    size_t pos = current->data.size();
+    current->data.resize(pos + sizeof(uint32_t) + len);
+
+    uint32_t id = msg.getConnection();
+    memcpy(&current->data[pos], &id, sizeof(id));
+    msg.serializeRecord(seq, &current->data[pos + sizeof(id)], len);
+}
+
+void WldQueueParser::appendClose(uint32_t connection)
+{
+    size_t pos = current->data.size();
+    current->data.resize(pos + sizeof(uint32_t));
+
+    uint32_t id = connection | CONNECTION_CLOSED;
+    memcpy(&current->data[pos], &id, sizeof(id));
+}
+
+void WldQueueParser::finish()
+{
+    prepare.stop();
+
+    if (!threaded)
+    {
+        parse();
+        return;
+    }
+
+    if ((!gaps.empty() || !closed.empty()) && current->data.empty())
+        queueGaps();
+    submitBatch(true);
+
+    pthread_mutex_lock(&lock);
+    running = false;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+
+    pthread_join(thread, NULL);
+    threaded = false;
+}
+
+void WldQueueParser::prepareEvent(ev::prepare &watcher, int revents)
+{
+    // whatever came during this loop iteration
+    prepare.stop();
+
+    if (threaded)
+        submitBatch();
+    else
+        parse();
+}
+
+void WldQueueParser::submitBatch(bool wait)
+{
+    if (current->data.empty())
+        return;
+
+    pthread_mutex_lock(&lock);
+    while (wait && pending.size() >= MAX_PENDING_BATCHES)
+        pthread_cond_wait(&cond, &lock);
+
+    if (pending.size() >= MAX_PENDING_BATCHES)
+    {
+        pthread_mutex_unlock(&lock);
+        dropBatch();
+        return;
+    }
+
+    pending.push_back(current);
+    if (!spare.empty())
+    {
+        current = spare.back();
+        spare.pop_back();
+    }
+    else
+    {
+        current = new Batch;
+        current->data.reserve(BATCH_SIZE);
+        current->pos = 0;
+    }
+
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+void WldQueueParser::dropBatch()
+{
+    if (gaps.empty())
+        DEBUG_LOG("the analysis thread can't keep up, dropping messages");
+
+    // gap markers queued before are dropped with the rest and merged
+    WlaMessageView view;
+    size_t pos = 0;
+    while (pos + sizeof(uint32_t) <= current->data.size())
+    {
+        uint32_t id;
+        memcpy(&id, &current->data[pos], sizeof(id));
+        pos += sizeof(id);
+
+        // the shard still has to go, after the gap
+        if (id & CONNECTION_CLOSED)
+        {
+            closed.push_back(id & ~CONNECTION_CLOSED);
+            continue;
+        }
+
+        int len = view.parseRecord(&current->data[pos], current->data.size() - pos);
+        if (len < 0)
+            break;
+        pos += len;
+
+        uint32_t count = view.isGap() ? view.getGapCount() : 1;
+        gaps_t::iterator it = gaps.find(id);
+        if (it == gaps.end())
+        {
+            Gap gap = { view.getSeq(), 0 };
+            it = gaps.insert(gaps_t::value_type(id, gap)).first;
+        }
+        it->second.count += count;
+        if (!view.isGap())
+            dropped++;
+    }
+
+    current->data.clear();
+    current->pos = 0;
+}
+
+void WldQueueParser::queueGaps()
+{
+    WlaMessageBuffer marker;
+    gaps_t::iterator it = gaps.begin();
+    for (; it != gaps.end(); it++)
+    {
+        marker.setGap(it->second.count);
+        marker.setConnection(it->first);
+        append(it->second.first, marker);
+    }
+
+    for (size_t i = 0; i < closed.size(); i++)
+        appendClose(closed[i]);
+
+    gaps.clear();
+    closed.clear();
+}
+
+// The batch to parse next, NULL once everything was parsed
+WldQueueParser::Batch *WldQueueParser::nextBatch()
+{
+    Batch *batch = threaded ? reading : current;
+
+    while (!batch || batch->pos == batch->data.size())
+    {
+        if (!threaded)
+        {
+            current->data.clear();
+            current->pos = 0;
+            return NULL;
+        }
+
+        pthread_mutex_lock(&lock);
+        if (reading)
+        {
+            reading->data.clear();
+            reading->pos = 0;
+            spare.push_back(reading);
+            reading = NULL;
+            pthread_cond_broadcast(&cond);
+        }
+
+        if (!pending.empty())
+        {
+            reading = pending.front();
+            pending.pop_front();
+        }
+        pthread_mutex_unlock(&lock);
+
+        if (!reading)
+            return NULL;
+        batch = reading;
+    }
+
+    return batch;
+}
+
+bool WldQueueParser::nextMessage(WlaMessageView &view)
+{
+    Batch *batch;
+    uint32_t id;
+    do
+    {
+        batch = nextBatch();
+        if (!batch)
+            return false;
+
+        memcpy(&id, &batch->data[batch->pos], sizeof(id));
+        batch->pos += sizeof(id);
+
+        if (id & CONNECTION_CLOSED)
+            closeShard(id & ~CONNECTION_CLOSED);
+    } while (id & CONNECTION_CLOSED);
+
+    int len = view.parseRecord(&batch->data[batch->pos], batch->data.size() - batch->pos);
+    if (len < 0)
+    {
+        DEBUG_LOG("invalid record in the queue");
+        batch->pos = batch->data.size();
+        return false;
+    }
+    batch->pos += len;
+
+    if (shard_base && (!analyzer || id != connection))
+    {
+        shards_t::iterator it = shards.find(id);
+        if (it == shards.end())
+        {
+            WldProtocolAnalyzer *shard = new WldProtocolAnalyzer(*shard_base, NULL);
+            if (shard->restoreState(&shard_state[0], shard_state.size()))
+                DEBUG_LOG("failed to set up the objects of connection %u", id);
+            it = shards.insert(shards_t::value_type(id, shard)).first;
+        }
+        analyzer = it->second;
+
+        Logger::getInstance()->log("connection %u\n", id);
+    }
+    connection = id;
+
+    return true;
+}
+
+void WldQueueParser::closeShard(uint32_t connection)
+{
+    shards_t::iterator it = shards.find(connection);
+    if (it == shards.end())
+        return;
+
+    if (analyzer == it->second)
+        analyzer = NULL;
+    delete it->second;
+    shards.erase(it);
+}
+
+void *WldQueueParser::analysisThread(void *arg)
+{
+    WldQueueParser *queue = (WldQueueParser *)arg;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->running || !queue->pending.empty())
+    {
+        if (queue->pending.empty())
+        {
+            pthread_cond_wait(&queue->cond, &queue->lock);
+            continue;
+        }
+
+        pthread_mutex_unlock(&queue->lock);
+        // written in one go, other threads may be logging too
+        std::string out;
+        Logger::setThreadBuffer(&out);
+        // and start with the connection they belong to
+        if (queue->shard_base)
+            queue->analyzer = NULL;
+        queue->parse();
+        Logger::setThreadBuffer(NULL);
+        Logger::getInstance()->write(out);
+        pthread_mutex_lock(&queue->lock);
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return NULL;
+}
+
+WldShardedParser::WldShardedParser(unsigned int threads)
+{
+    if (!threads)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? cpus : 1;
+    }
+
+    for (unsigned int i = 0; i < threads; i++)
+        queues.push_back(new WldQueueParser);
+}
+
+WldShardedParser::~WldShardedParser()
+{
+    for (size_t i = 0; i < queues.size(); i++)
+        delete queues[i];
+}
+
+int WldShardedParser::startThreads()
+{
+    if (!analyzer)
+    {
+        DEBUG_LOG("no analyzer attached");
+        return -1;
+    }
+
+    for (size_t i = 0; i < queues.size(); i++)
+    {
+        queues[i]->shardConnections(analyzer);
+        if (queues[i]->startThread())
+            return -1;
+    }
+
+    return 0;
+}
+
+void WldShardedParser::push(uint32_t seq, WlaMessageBuffer &msg)
+{
+    queues[msg.getConnection() % queues.size()]->push(seq, msg);
+}
+
+void WldShardedParser::closeConnection(uint32_t connection)
+{
+    queues[connection % queues.size()]->closeConnection(connection);
+}
+
+void WldShardedParser::finish()
+{
+    for (size_t i = 0; i < queues.size(); i++)
+        queues[i]->finish();
+}
+
+int WldQueueDumper::dump(WlaMessageBuffer &msg)
+{
+    if (sharded)
+        sharded->push(seq++, msg);
+    else
+        parser->push(seq++, msg);
+
+    return 0;
+}
+
+void WldQueueDumper::closeConnection(uint32_t connection)
+{
+    if (sharded)
+        sharded->closeConnection(connection);
+    else
+        parser->closeConnection(connection);
+}
@@ -0,0 +1,157 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <pthread.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include <tr1/unordered_map>
+#include <ev++.h>
+#include "dumper.h"
+#include "parser.h"
+
+// Hands the captured messages to an analyzer in the same process, without
+// the round trip through a dump file. Records are collected in batches
+// which are parsed right before the loop waits for events again, or by an
+// analysis thread if one was started. The proxy never waits for that
+// thread: once too many batches are pending the new ones are dropped and
+// every connection gets a gap marker for what it lost.
+class WldQueueParser : public WldParser
+{
+public:
+    WldQueueParser();
+    ~WldQueueParser();
+
+    int openResource(const std::string &resource);
+    int startThread();
+    // Analyzes every connection on its own copy of base instead of the
+    // attached analyzer, starting with the objects base has now. Base has
+    // to outlive the parser.
+    void shardConnections(const WldProtocolAnalyzer *base);
+    void push(uint32_t seq, WlaMessageBuffer &msg);
+    // the objects of a shard are freed once its messages are analyzed
+    void closeConnection(uint32_t connection);
+    void finish();
+
+private:
+    struct Batch
+    {
+        std::vector<char> data;
+        size_t pos;
+    };
+
+    struct Gap
+    {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    void append(uint32_t seq, WlaMessageBuffer &msg);
+    void appendClose(uint32_t connection);
+    void prepareEvent(ev::prepare &watcher, int revents);
+    void submitBatch(bool wait = false);
+    void dropBatch();
+    void queueGaps();
+    Batch *nextBatch();
+    bool nextMessage(WlaMessageView &msg);
+    void closeShard(uint32_t connection);
+    static void *analysisThread(void *arg);
+
+private:
+    static const size_t BATCH_SIZE = 64 * 1024;
+    static const size_t MAX_PENDING_BATCHES = 16;
+    // queued in place of a connection id, with no record after it
+    static const uint32_t CONNECTION_CLOSED = 0x80000000;
+
+    Batch *current;
+    Batch *reading;
+    std::deque<Batch *> pending;
+    std::vector<Batch *> spare;
+    ev::prepare prepare;
+
+    bool threaded;
+    bool running;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    // messages dropped per connection since there was room last
+    typedef std::tr1::unordered_map<uint32_t, Gap> gaps_t;
+    gaps_t gaps;
+    std::vector<uint32_t> closed; // in batches that were dropped
+    uint64_t dropped;
+
+    const WldProtocolAnalyzer *shard_base;
+    std::vector<char> shard_state; // new shards start from
+    typedef std::tr1::unordered_map<uint32_t, WldProtocolAnalyzer *> shards_t;
+    shards_t shards;
+    uint32_t connection; // of the message parsed last
+};
+
+// Analyzes the proxied connections on a pool of threads, each one with its
+// own object state. A connection always goes to the same thread, so its
+// messages are analyzed in order, and as many connections as threads are
+// analyzed at once.
+class WldShardedParser : public WldParser
+{
+public:
+    // as many threads as cores by default
+    WldShardedParser(unsigned int threads = 0);
+    ~WldShardedParser();
+
+    int openResource(const std::string &resource) { return 0; }
+    // the analyzer has to be attached first
+    int startThreads();
+    void push(uint32_t seq, WlaMessageBuffer &msg);
+    void closeConnection(uint32_t connection);
+    void finish();
+
+protected:
+    // the messages are parsed by the queues
+    bool nextMessage(WlaMessageView &msg) { return false; }
+
+private:
+    std::vector<WldQueueParser *> queues;
+};
+
+class WldQueueDumper : public WldDumper
+{
+public:
+    WldQueueDumper(WldQueueParser *parser) : parser(parser), sharded(NULL), seq(0) {}
+    WldQueueDumper(WldShardedParser *parser) : parser(NULL), sharded(parser), seq(0) {}
+
+    virtual int open(const std::string &resource) { return 0; }
+    virtual int dump(WlaMessageBuffer &msg);
+    virtual void closeConnection(uint32_t connection);
+
+private:
+    WldQueueParser *parser;
+    WldShardedParser *sharded;
+    uint32_t seq;
+};
+
+#endif // QUEUE_H
@@ -0,0 +1,324 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "reader.h"
+
+WldCaptureReader::WldCaptureReader() : source(SOURCE_NONE), file(-1), records(NULL), size(0),
+    pos(0), blocks(NULL), msg_pos(0), pending(false), started(false), finished(false), dropped(0),
+    requests(true), events(true), has_end(false)
+{
+}
+
+WldCaptureReader::~WldCaptureReader()
+{
+    close();
+}
+
+int WldCaptureReader::open(const std::string &path)
+{
+    close();
+
+    file = ::open(path.c_str(), O_RDONLY);
+    if (file == -1)
+    {
+        DEBUG_LOG("failed to open file %s", path.c_str());
+        return -1;
+    }
+    this->path = path;
+
+    struct stat st;
+    if (fstat(file, &st))
+    {
+        close();
+        return -1;
+    }
+
+    if (!S_ISREG(st.st_mode))
+    {
+        source = SOURCE_STREAM;
+        read_buf.resize(READ_BUFFER_SIZE);
+        records = &read_buf[0];
+
+        return 0;
+    }
+
+    uint32_t file_hdr[2] = { 0, 0 };
+    if (pread(file, file_hdr, sizeof(file_hdr), 0) < 0)
+    {
+        close();
+        return -1;
+    }
+
+    uint32_t magic = ntohl(file_hdr[0]);
+    if (magic == WLD_BLOCK_FILE_MAGIC || magic == WLD_COLUMN_FILE_MAGIC)
+    {
+        if (ntohl(file_hdr[1]) != WLD_BLOCK_FILE_VERSION)
+        {
+            Logger::getInstance()->log("Unsupported capture file version %u\n", ntohl(file_hdr[1]));
+            close();
+            return -1;
+        }
+
+        blocks = new WldBlockReader;
+        blocks->setFile(file, WLD_BLOCK_FILE_HEADER_SIZE, magic == WLD_COLUMN_FILE_MAGIC);
+        source = SOURCE_BLOCKS;
+
+        return 0;
+    }
+
+    source = SOURCE_MAP;
+    if (st.st_size == 0)
+        return 0;
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (map == MAP_FAILED)
+    {
+        DEBUG_LOG("failed to map %s", path.c_str());
+        close();
+        return -1;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    records = (const char *)map;
+    size = st.st_size;
+
+    return 0;
+}
+
+void WldCaptureReader::close()
+{
+    if (source == SOURCE_MAP && records)
+        munmap((void *)records, size);
+
+    delete blocks;
+    blocks = NULL;
+
+    if (file != -1)
+        ::close(file);
+    file = -1;
+
+    source = SOURCE_NONE;
+    records = NULL;
+    size = pos = 0;
+    message = WldCaptureMessage();
+    msg_pos = 0;
+    pending = started = finished = false;
+    dropped = 0;
+}
+
+void WldCaptureReader::setTypes(bool requests, bool events)
+{
+    this->requests = requests;
+    this->events = events;
+}
+
+void WldCaptureReader::addObject(uint32_t id)
+{
+    objects.insert(id);
+}
+
+void WldCaptureReader::setEndTime(const timeval &time)
+{
+    end_time = time;
+    has_end = true;
+}
+
+int WldCaptureReader::seekTime(const timeval &time)
+{
+    if (source == SOURCE_NONE)
+        return -1;
+
+    // mapped files jump straight to the right part of the index, an
+    // existing sidecar is only a shortcut since this doesn't need counts
+    if (source == SOURCE_MAP)
+    {
+        WldCaptureIndex index;
+        if (index.load(path))
+            index.build(records, size, NULL);
+
+        const WldCaptureIndex::Entry *entry = index.findTime(time);
+        pos = entry ? entry->offset : index.getSize();
+        finished = false;
+    }
+
+    // the rest of the way record by record, the one found is next
+    pending = started = false;
+    while (nextRecord())
+    {
+        if (!timercmp(message.record.getTimeStamp(), &time, <))
+        {
+            pending = true;
+            break;
+        }
+    }
+    msg_pos = message.record.getMsgSize();
+
+    return 0;
+}
+
+WldCaptureReader::iterator WldCaptureReader::begin()
+{
+    if (!started && !next())
+        return end();
+
+    return iterator(this);
+}
+
+bool WldCaptureReader::next()
+{
+    started = true;
+
+    while (true)
+    {
+        uint32_t msg_size = message.record.getMsgSize();
+        if (msg_pos + PAYLOAD_OFFSET <= msg_size)
+        {
+            message.data = message.record.getMsg() + msg_pos;
+            uint16_t size = message.getSize();
+            if (size < PAYLOAD_OFFSET || msg_pos + size > msg_size)
+            {
+                DEBUG_LOG("malformed message in record %u", message.getSeq());
+                msg_pos = msg_size;
+                continue;
+            }
+            msg_pos += size;
+
+            if (!objects.empty() && !objects.count(message.getObjectId()))
+                continue;
+
+            return true;
+        }
+
+        if (!pending && !nextRecord())
+            return false;
+        pending = false;
+
+        const WlaMessageView &record = message.record;
+        msg_pos = 0;
+
+        if (record.isGap())
+        {
+            dropped += record.getGapCount();
+            msg_pos = record.getMsgSize();
+            continue;
+        }
+
+        if (has_end && timercmp(record.getTimeStamp(), &end_time, >))
+        {
+            finished = true;
+            return false;
+        }
+
+        bool event = record.getType() == WlaMessageBuffer::EVENT_TYPE;
+        if (event ? !events : !requests)
+            msg_pos = record.getMsgSize();
+    }
+}
+
+// Moves on to the next record, false at the end of the capture
+bool WldCaptureReader::nextRecord()
+{
+    if (finished)
+        return false;
+
+    const char *record = NULL;
+    size_t len = 0;
+
+    switch (source)
+    {
+    case SOURCE_MAP:
+        record = records + pos;
+        len = size - pos;
+        break;
+    case SOURCE_BLOCKS:
+        record = blocks->nextRecord(&len);
+        break;
+    case SOURCE_STREAM:
+        len = WlaMessageView::getRecordSize(records + pos, size - pos);
+        if (!len || len > size - pos)
+        {
+            if (!readStream(len ? len : sizeof(uint32_t) + WlaMessageBufferHeader::getSerializeSize()))
+                break;
+            len = WlaMessageView::getRecordSize(records + pos, size - pos);
+            if (!len || len > size - pos)
+                return nextRecord();
+        }
+        record = records + pos;
+        break;
+    case SOURCE_NONE:
+        break;
+    }
+
+    int record_len = record && len ? message.record.parseRecord(record, len) : -1;
+    if (record_len < 0)
+    {
+        if (source == SOURCE_MAP && pos < size)
+            Logger::getInstance()->log("The capture is truncated after %lu bytes\n", pos);
+        message.record = WlaMessageView();
+        finished = true;
+        return false;
+    }
+
+    if (source != SOURCE_BLOCKS)
+        pos += record_len;
+
+    return true;
+}
+
+// Reads at least need bytes more of the stream behind pos, false at its end
+bool WldCaptureReader::readStream(size_t need)
+{
+    if (need > MAX_RECORD_SIZE)
+    {
+        Logger::getInstance()->log("Invalid record in the capture\n");
+        return false;
+    }
+
+    // whatever is left of the current chunk moves to the front
+    memmove(&read_buf[0], &read_buf[0] + pos, size - pos);
+    size -= pos;
+    pos = 0;
+
+    if (read_buf.size() < need)
+        read_buf.resize(need);
+    records = &read_buf[0];
+
+    while (size < need)
+    {
+        ssize_t len = read(file, &read_buf[size], read_buf.size() - size);
+        if (len < 0 && errno == EINTR)
+            continue;
+        if (len <= 0)
+            return false;
+
+        size += len;
+    }
+
+    return true;
+}
@@ -0,0 +1,177 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef READER_H
+#define READER_H
+
+#include <sys/time.h>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <tr1/unordered_set>
+#include "block.h"
+#include "index.h"
+#include "message.h"
+
+// One wayland message of a capture. It points into the reader's buffers
+// and is only valid until the reader moves on.
+class WldCaptureMessage
+{
+public:
+    WldCaptureMessage() : data(NULL) {}
+
+    uint32_t getSeq() const { return record.getSeq(); }
+    const timeval *getTimeStamp() const { return record.getTimeStamp(); }
+    WLD_MESSAGE_TYPE getType() const
+    {
+        return record.getType() == WlaMessageBuffer::EVENT_TYPE ? WLD_MSG_EVENT : WLD_MSG_REQUEST;
+    }
+
+    uint32_t getObjectId() const { return byteArrToUInt32(&data[CLIENT_ID_OFFSET]); }
+    uint16_t getOpcode() const { return byteArrToUInt16(&data[OPCODE_OFFSET]); }
+    uint16_t getSize() const { return byteArrToUInt16(&data[SIZE_OFFSET]); }
+    const char *getPayload() const { return data + PAYLOAD_OFFSET; }
+    uint32_t getPayloadSize() const { return getSize() - PAYLOAD_OFFSET; }
+
+    // the whole record the message came in, with its file descriptors
+    const WlaMessageView &getRecord() const { return record; }
+
+private:
+    friend class WldCaptureReader;
+
+    WlaMessageView record;
+    const char *data;
+};
+
+// Pulls the messages out of a capture file, record or block one, without
+// an analyzer or any output:
+//
+//     WldCaptureReader reader;
+//     reader.open(path);
+//     for (WldCaptureReader::iterator it = reader.begin(); it != reader.end(); ++it)
+//         use(it->getObjectId(), it->getPayload());
+//
+// Regular record files are mapped, blocks are decompressed a block ahead
+// and pipes are read in large chunks, messages are never copied.
+class WldCaptureReader
+{
+public:
+    class iterator
+    {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef const WldCaptureMessage value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const WldCaptureMessage *pointer;
+        typedef const WldCaptureMessage &reference;
+
+        iterator(WldCaptureReader *reader = NULL) : reader(reader) {}
+
+        const WldCaptureMessage &operator*() const { return reader->message; }
+        const WldCaptureMessage *operator->() const { return &reader->message; }
+        iterator &operator++()
+        {
+            if (!reader->next())
+                reader = NULL;
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const { return reader == other.reader; }
+        bool operator!=(const iterator &other) const { return reader != other.reader; }
+
+    private:
+        WldCaptureReader *reader;
+    };
+
+    WldCaptureReader();
+    ~WldCaptureReader();
+
+    int open(const std::string &path);
+    void close();
+
+    // Filters, everything passes unless set
+    void setTypes(bool requests, bool events);
+    // only the messages sent to the objects added
+    void addObject(uint32_t id);
+    // records taken after that aren't read anymore
+    void setEndTime(const timeval &time);
+
+    // Goes to the first record taken at or after time. Record files are
+    // looked up in their index and can go back too, the others are read
+    // up to there.
+    int seekTime(const timeval &time);
+
+    // Moves to the next message that passes the filters, false at the end
+    bool next();
+    const WldCaptureMessage &getMessage() const { return message; }
+
+    // the first message, the reader moves on as the iterators do
+    iterator begin();
+    iterator end() { return iterator(); }
+
+    // messages the dumper reported as dropped so far
+    uint64_t getDroppedCount() const { return dropped; }
+
+private:
+    bool nextRecord();
+    bool readStream(size_t need);
+
+private:
+    static const size_t READ_BUFFER_SIZE = 256 * 1024;
+    static const size_t MAX_RECORD_SIZE = 16 * 1024 * 1024;
+
+    enum Source
+    {
+        SOURCE_NONE,
+        SOURCE_MAP,
+        SOURCE_BLOCKS,
+        SOURCE_STREAM
+    };
+
+    Source source;
+    std::string path;
+    int file;
+
+    // a mapped record file, or what was read from a stream so far
+    const char *records;
+    size_t size;
+    size_t pos;
+    std::vector<char> read_buf;
+    WldBlockReader *blocks;
+
+    WldCaptureMessage message;
+    uint32_t msg_pos; // of the next message in the record
+    bool pending; // the record is read but not gone through yet
+    bool started;
+    bool finished;
+    uint64_t dropped;
+
+    bool requests;
+    bool events;
+    std::tr1::unordered_set<uint32_t> objects;
+    bool has_end;
+    timeval end_time;
+};
+
+#endif // READER_H
@@ -0,0 +1,364 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sstream>
+#include "message.h"
+#include "recorder.h"
+
+static const uint32_t WL_DISPLAY_ID = 1;
+static const uint16_t WL_DISPLAY_ERROR_OPCODE = 0;
+
+WldFlightRecorder::WldFlightRecorder(size_t capacity) : capacity(capacity),
+    seq(0), snapshots(0), latency_threshold(0.0), post_window(1.0), flushing(false)
+{
+}
+
+WldFlightRecorder::~WldFlightRecorder()
+{
+    if (timer.is_active())
+    {
+        timer.stop();
+        writeSnapshot();
+    }
+
+    waitForFlush();
+
+    sigwtch.stop();
+    controlwtch.stop();
+
+    pending_t::iterator request = pending.begin();
+    for (; request != pending.end(); request++)
+    {
+        request->second->stop();
+        delete request->second;
+    }
+
+    std::set<WldSocket *>::iterator it = control_clients.begin();
+    for (; it != control_clients.end(); it++)
+    {
+        (*it)->stop();
+        delete *it;
+    }
+
+    if (control.isListening())
+        control.close();
+}
+
+int WldFlightRecorder::open(const std::string &resource)
+{
+    if (resource.empty())
+    {
+        DEBUG_LOG("failed: empty path");
+        return -1;
+    }
+
+    if (ring.create(capacity))
+    {
+        Logger::getInstance()->log("Failed to allocate a %lu bytes recording buffer\n", capacity);
+        return -1;
+    }
+
+    prefix = resource;
+
+    timer.set<WldFlightRecorder, &WldFlightRecorder::timerEvent>(this);
+    sigwtch.set<WldFlightRecorder, &WldFlightRecorder::handleSignal>(this);
+    sigwtch.start(SIGUSR1);
+
+    return 0;
+}
+
+int WldFlightRecorder::setControlSocket(const std::string &path)
+{
+    if (control.isListening())
+    {
+        DEBUG_LOG("control socket already listening");
+        return -1;
+    }
+
+    unlink(path.c_str());
+    if (!control.listen(path))
+    {
+        DEBUG_LOG("Failed to listen on %s", path.c_str());
+        return -1;
+    }
+
+    controlwtch.set<WldFlightRecorder, &WldFlightRecorder::handleControlConnection>(this);
+    controlwtch.start(control.getFd(), EV_READ);
+
+    return 0;
+}
+
+int WldFlightRecorder::dump(WlaMessageBuffer &msg)
+{
+    if (!ring.isValid())
+        return -1;
+
+    ring.push(seq++, msg);
+    checkTriggers(msg);
+
+    return 0;
+}
+
+void WldFlightRecorder::trigger(const char *reason)
+{
+    if (!ring.isValid())
+        return;
+
+    if (timer.is_active())
+    {
+        DEBUG_LOG("already capturing, ignoring %s", reason);
+        return;
+    }
+
+    Logger::getInstance()->log("Flight recorder triggered by %s\n", reason);
+    timer.start(post_window, 0.0);
+}
+
+void WldFlightRecorder::closeConnection(uint32_t connection)
+{
+    pending_t::iterator it = pending.find(connection);
+    if (it == pending.end())
+        return;
+
+    it->second->stop();
+    delete it->second;
+    pending.erase(it);
+}
+
+void WldFlightRecorder::checkLatency(WlaMessageBuffer &msg)
+{
+    pending_t::iterator it = pending.find(msg.getConnection());
+
+    if (msg.getType() == WlaMessageBuffer::REQUEST_TYPE)
+    {
+        if (it != pending.end())
+            return;
+
+        PendingRequest *request = new PendingRequest;
+        request->time = *msg.getTimeStamp();
+        request->set<WldFlightRecorder, &WldFlightRecorder::latencyTimeout>(this);
+        request->start(latency_threshold, 0.0);
+        pending[msg.getConnection()] = request;
+        return;
+    }
+
+    if (it == pending.end())
+        return;
+
+    // the loop may have been too busy for the timer to fire in time
+    PendingRequest *request = it->second;
+    if (request->is_active())
+    {
+        const timeval *ts = msg.getTimeStamp();
+        double latency = (ts->tv_sec - request->time.tv_sec) +
+                (ts->tv_usec - request->time.tv_usec) / 1000000.0;
+        if (latency > latency_threshold)
+            trigger("latency threshold breach");
+        request->stop();
+    }
+
+    delete request;
+    pending.erase(it);
+}
+
+void WldFlightRecorder::latencyTimeout(ev::timer &timer, int revents)
+{
+    if (revents & EV_ERROR)
+    {
+        DEBUG_LOG("error");
+        return;
+    }
+
+    // stays pending, so a hung compositor triggers only once
+    trigger("latency threshold breach");
+}
+
+void WldFlightRecorder::checkTriggers(WlaMessageBuffer &msg)
+{
+    if (latency_threshold > 0.0)
+        checkLatency(msg);
+
+    if (msg.getType() == WlaMessageBuffer::REQUEST_TYPE)
+        return;
+
+    const char *msg_buf = msg.getMsg();
+    uint32_t i = 0;
+    while (i + PAYLOAD_OFFSET <= msg.getMsgSize())
+    {
+        uint32_t object_id = byteArrToUInt32(&msg_buf[i + CLIENT_ID_OFFSET]);
+        uint16_t opcode = byteArrToUInt16(&msg_buf[i + OPCODE_OFFSET]);
+        uint16_t size = byteArrToUInt16(&msg_buf[i + SIZE_OFFSET]);
+
+        if (object_id == WL_DISPLAY_ID && opcode == WL_DISPLAY_ERROR_OPCODE)
+        {
+            trigger("wl_display.error");
+            break;
+        }
+
+        if (size == 0)
+            break;
+
+        i += size;
+    }
+}
+
+void WldFlightRecorder::handleSignal(ev::sig &watcher, int revents)
+{
+    if (revents & EV_ERROR)
+    {
+        DEBUG_LOG("got error event");
+        return;
+    }
+
+    trigger("signal");
+}
+
+void WldFlightRecorder::handleControlConnection(ev::io &watcher, int revents)
+{
+    if (revents & EV_ERROR)
+    {
+        DEBUG_LOG("got error event");
+        return;
+    }
+
+    bool timedout;
+    if (!control.waitForConnection(0, &timedout))
+        return;
+
+    WldSocket *client = control.nextPendingConnection();
+    if (!client)
+        return;
+
+    client->set<WldFlightRecorder, &WldFlightRecorder::handleControlCommand>(this);
+    client->start(EV_READ);
+    control_clients.insert(client);
+}
+
+void WldFlightRecorder::handleControlCommand(ev::io &watcher, int revents)
+{
+    WldSocket *client = static_cast<WldSocket *>(&watcher);
+
+    char cmd[64];
+    int len = -1;
+    if (!(revents & EV_ERROR))
+        len = recv(client->getSocketDescriptor(), cmd, sizeof(cmd) - 1, MSG_DONTWAIT);
+
+    if (len < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+
+    if (len <= 0)
+    {
+        client->stop();
+        control_clients.erase(client);
+        delete client;
+        return;
+    }
+
+    cmd[len] = '\0';
+    if (!strncmp(cmd, "dump", 4))
+        trigger("control socket");
+    else
+        Logger::getInstance()->log("Unknown flight recorder command %s\n", cmd);
+}
+
+void WldFlightRecorder::timerEvent(ev::timer &timer, int revents)
+{
+    if (revents & EV_ERROR)
+    {
+        DEBUG_LOG("error");
+        return;
+    }
+
+    writeSnapshot();
+}
+
+void WldFlightRecorder::writeSnapshot()
+{
+    // only one snapshot is written at a time
+    waitForFlush();
+
+    std::ostringstream path;
+    path << prefix << "." << snapshots++;
+    flush_path = path.str();
+
+    if (pthread_create(&flusher, NULL, flushThread, this))
+    {
+        DEBUG_LOG("failed to start the flush thread");
+        flushThread(this);
+        return;
+    }
+
+    flushing = true;
+}
+
+void WldFlightRecorder::waitForFlush()
+{
+    if (!flushing)
+        return;
+
+    pthread_join(flusher, NULL);
+    flushing = false;
+}
+
+void *WldFlightRecorder::flushThread(void *arg)
+{
+    WldFlightRecorder *recorder = static_cast<WldFlightRecorder *>(arg);
+
+    std::vector<char> buf;
+    size_t len = recorder->ring.snapshot(buf);
+
+    int fd = ::open(recorder->flush_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                    S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd == -1)
+    {
+        Logger::getInstance()->log("Failed to create file %s\n", recorder->flush_path.c_str());
+        return NULL;
+    }
+
+    size_t written = 0;
+    while (written < len)
+    {
+        ssize_t ret = ::write(fd, &buf[written], len - written);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            perror(NULL);
+            break;
+        }
+
+        written += ret;
+    }
+
+    close(fd);
+
+    Logger::getInstance()->log("Flight recorder wrote %lu bytes to %s\n", written,
+                               recorder->flush_path.c_str());
+
+    return NULL;
+}
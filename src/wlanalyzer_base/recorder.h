@@ -0,0 +1,101 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <pthread.h>
+#include <sys/time.h>
+#include <set>
+#include <string>
+#include <vector>
+#include <tr1/unordered_map>
+#include <ev++.h>
+#include "dumper.h"
+#include "ring.h"
+#include "server_socket.h"
+
+// Keeps the most recent traffic in memory and writes it out only when
+// something interesting happens: SIGUSR1, a "dump" command on the control
+// socket, a wl_display.error event or a request that waited too long for
+// an event. Each trigger produces <resource>.<n> in the regular dump format.
+class WldFlightRecorder : public WldDumper
+{
+public:
+    WldFlightRecorder(size_t capacity);
+    virtual ~WldFlightRecorder();
+
+    virtual int open(const std::string &resource);
+    virtual int dump(WlaMessageBuffer &msg);
+    virtual void closeConnection(uint32_t connection);
+
+    int setControlSocket(const std::string &path);
+    void setLatencyThreshold(double seconds) { latency_threshold = seconds; }
+    void setPostTriggerWindow(double seconds) { post_window = seconds; }
+
+    void trigger(const char *reason);
+
+private:
+    // the oldest request of a connection still waiting for an event, the
+    // timer fires if none comes within the latency threshold
+    struct PendingRequest : public ev::timer
+    {
+        timeval time;
+    };
+    typedef std::tr1::unordered_map<uint32_t, PendingRequest *> pending_t;
+
+    void checkTriggers(WlaMessageBuffer &msg);
+    void checkLatency(WlaMessageBuffer &msg);
+    void latencyTimeout(ev::timer &timer, int revents);
+    void handleSignal(ev::sig &watcher, int revents);
+    void handleControlConnection(ev::io &watcher, int revents);
+    void handleControlCommand(ev::io &watcher, int revents);
+    void timerEvent(ev::timer &timer, int revents);
+    void writeSnapshot();
+    void waitForFlush();
+    static void *flushThread(void *arg);
+
+private:
+    WldRecordRing ring;
+    size_t capacity;
+    std::string prefix;
+    uint32_t seq;
+    int snapshots;
+
+    ev::sig sigwtch;
+    ev::timer timer;
+    ev::io controlwtch;
+    WldServer control;
+    std::set<WldSocket *> control_clients;
+
+    double latency_threshold;
+    double post_window;
+    pending_t pending;
+
+    pthread_t flusher;
+    bool flushing;
+    std::string flush_path;
+};
+
+#endif // RECORDER_H
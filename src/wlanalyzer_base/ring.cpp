@@ -0,0 +1,321 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "message.h"
+#include "ring.h"
+
+WldRecordRing::WldRecordRing() : hdr(NULL), data(NULL), memfd(-1), map_size(0)
+{
+}
+
+WldRecordRing::~WldRecordRing()
+{
+    release();
+}
+
+void WldRecordRing::release()
+{
+    if (map_size)
+        munmap(hdr, map_size);
+    else if (hdr)
+        delete [] (char *)hdr;
+
+    if (memfd != -1)
+        close(memfd);
+
+    hdr = NULL;
+    data = NULL;
+    memfd = -1;
+    map_size = 0;
+}
+
+int WldRecordRing::create(size_t capacity)
+{
+    if (capacity < getRecordSize(NULL))
+    {
+        DEBUG_LOG("ring capacity %lu is too small", capacity);
+        return -1;
+    }
+
+    release();
+
+    char *mem = new char[sizeof(WldRingHeader) + capacity];
+    hdr = (WldRingHeader *)mem;
+    data = mem + sizeof(WldRingHeader);
+
+    hdr->capacity = capacity;
+    hdr->start = 0;
+    hdr->end = 0;
+
+    return 0;
+}
+
+int WldRecordRing::createShared(size_t capacity)
+{
+    if (capacity < getRecordSize(NULL))
+    {
+        DEBUG_LOG("ring capacity %lu is too small", capacity);
+        return -1;
+    }
+
+    release();
+
+    memfd = memfd_create("wldump-ring", MFD_CLOEXEC);
+    if (memfd == -1)
+    {
+        DEBUG_LOG("memfd_create failed: %s", strerror(errno));
+        return -1;
+    }
+
+    size_t size = sizeof(WldRingHeader) + capacity;
+    void *mem = MAP_FAILED;
+    if (!ftruncate(memfd, size))
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (mem == MAP_FAILED)
+    {
+        DEBUG_LOG("failed to map the ring: %s", strerror(errno));
+        release();
+        return -1;
+    }
+
+    map_size = size;
+    hdr = (WldRingHeader *)mem;
+    data = (char *)mem + sizeof(WldRingHeader);
+
+    hdr->capacity = capacity;
+    hdr->start = 0;
+    hdr->end = 0;
+
+    return 0;
+}
+
+int WldRecordRing::attach(int fd)
+{
+    release();
+
+    struct stat st;
+    if (fstat(fd, &st) || (size_t)st.st_size <= sizeof(WldRingHeader))
+    {
+        DEBUG_LOG("invalid ring memory");
+        close(fd);
+        return -1;
+    }
+
+    void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED)
+    {
+        DEBUG_LOG("failed to map the ring: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    memfd = fd;
+    map_size = st.st_size;
+    hdr = (WldRingHeader *)mem;
+    data = (char *)mem + sizeof(WldRingHeader);
+
+    if (hdr->capacity != map_size - sizeof(WldRingHeader))
+    {
+        DEBUG_LOG("ring capacity doesn't match its memory");
+        release();
+        return -1;
+    }
+
+    return 0;
+}
+
+uint64_t WldRecordRing::getStart() const
+{
+    return __atomic_load_n(&hdr->start, __ATOMIC_ACQUIRE);
+}
+
+uint64_t WldRecordRing::getEnd() const
+{
+    return __atomic_load_n(&hdr->end, __ATOMIC_ACQUIRE);
+}
+
+bool WldRecordRing::push(uint32_t seq, WlaMessageBuffer &msg)
+{
+    if (!hdr)
+        return false;
+
+    size_t hdr_size = WlaMessageBufferHeader::getSerializeSize();
+    size_t len = sizeof(seq) + hdr_size + msg.getMsgSize() + msg.getControlMsgSize();
+    if (len > hdr->capacity)
+    {
+        DEBUG_LOG("record of %lu bytes doesn't fit in the ring", len);
+        return false;
+    }
+
+    // only the writer moves start and end, plain reads are fine here
+    uint64_t start = hdr->start;
+    uint64_t end = hdr->end;
+
+    if (end + len - start > hdr->capacity)
+    {
+        while (end + len - start > hdr->capacity)
+            start += recordSizeAt(start);
+
+        // readers must see the new start before any of the old bytes change
+        __atomic_store_n(&hdr->start, start, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+
+    char header[32];
+    msg.getHeader()->serializeToBuf(header, sizeof(header));
+
+    uint64_t pos = end;
+    copyIn(pos, (const char *)&seq, sizeof(seq));
+    pos += sizeof(seq);
+    copyIn(pos, header, hdr_size);
+    pos += hdr_size;
+    copyIn(pos, msg.getMsg(), msg.getMsgSize());
+    pos += msg.getMsgSize();
+    if (msg.getControlMsgSize() > 0)
+        copyIn(pos, msg.getControlMsg(), msg.getControlMsgSize());
+
+    __atomic_store_n(&hdr->end, end + len, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+size_t WldRecordRing::snapshot(std::vector<char> &out, uint64_t *from) const
+{
+    out.clear();
+    if (!hdr)
+        return 0;
+
+    uint64_t end = getEnd();
+    uint64_t start = getStart();
+    if (start >= end)
+        return 0;
+
+    out.resize(end - start);
+    copyOut(start, &out[0], end - start);
+
+    // anything the writer reclaimed while we were copying is garbage now
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint64_t valid = __atomic_load_n(&hdr->start, __ATOMIC_RELAXED);
+    if (valid >= end)
+    {
+        out.clear();
+        return 0;
+    }
+    else if (valid > start)
+    {
+        out.erase(out.begin(), out.begin() + (valid - start));
+        start = valid;
+    }
+
+    if (from)
+        *from = start;
+
+    return out.size();
+}
+
+size_t WldRecordRing::getRecordSize(const char *record)
+{
+    size_t size = sizeof(uint32_t) + WlaMessageBufferHeader::getSerializeSize();
+    if (!record)
+        return size;
+
+    WlaMessageBufferHeader hdr;
+    hdr.deserializeFromBuf(record + sizeof(uint32_t), WlaMessageBufferHeader::getSerializeSize());
+
+    return size + hdr.msg_len + hdr.cmsg_len;
+}
+
+bool WldRecordRing::hasRoom(uint64_t keep, size_t len) const
+{
+    return hdr && hdr->end + len - keep <= hdr->capacity;
+}
+
+uint32_t WldRecordRing::getSeqAt(uint64_t pos) const
+{
+    uint32_t seq;
+    copyOut(pos, (char *)&seq, sizeof(seq));
+
+    return seq;
+}
+
+const char *WldRecordRing::peek(uint64_t pos, size_t *len) const
+{
+    size_t offset = pos % hdr->capacity;
+    *len = hdr->end - pos;
+    if (*len > hdr->capacity - offset)
+        *len = hdr->capacity - offset;
+
+    return data + offset;
+}
+
+uint64_t WldRecordRing::find(uint32_t seq) const
+{
+    uint64_t pos = hdr->start;
+    while (pos < hdr->end && (int32_t)(getSeqAt(pos) - seq) < 0)
+        pos += recordSizeAt(pos);
+
+    return pos;
+}
+
+bool WldRecordRing::isOverwritten(uint64_t pos) const
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&hdr->start, __ATOMIC_RELAXED) > pos;
+}
+
+size_t WldRecordRing::recordSizeAt(uint64_t pos) const
+{
+    char record[64];
+    copyOut(pos, record, getRecordSize(NULL));
+
+    return getRecordSize(record);
+}
+
+void WldRecordRing::copyIn(uint64_t pos, const char *src, size_t len)
+{
+    size_t offset = pos % hdr->capacity;
+    size_t first = hdr->capacity - offset;
+    if (first > len)
+        first = len;
+
+    memcpy(data + offset, src, first);
+    if (len > first)
+        memcpy(data, src + first, len - first);
+}
+
+void WldRecordRing::copyOut(uint64_t pos, char *dst, size_t len) const
+{
+    size_t offset = pos % hdr->capacity;
+    size_t first = hdr->capacity - offset;
+    if (first > len)
+        first = len;
+
+    memcpy(dst, data + offset, first);
+    if (len > first)
+        memcpy(dst + first, data, len - first);
+}
@@ -0,0 +1,99 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class WlaMessageBuffer;
+
+// Positions are byte offsets that only ever grow, the place in the buffer
+// is the position modulo capacity.
+struct WldRingHeader
+{
+    uint64_t capacity;
+    uint64_t start; // oldest complete record
+    uint64_t end;   // one past the newest complete record
+};
+
+// Ring of dump records laid out exactly as WldIODumper writes them to disk
+// (seq, header, payload, control message). There is a single writer which
+// never waits: the oldest records are dropped to make room for new ones.
+// Readers on other threads copy the data out without taking any lock and
+// then recheck the start position to throw away what got overwritten.
+class WldRecordRing
+{
+public:
+    WldRecordRing();
+    ~WldRecordRing();
+
+    int create(size_t capacity);
+    bool isValid() const { return hdr != NULL; }
+
+    // The ring lives in a memfd that readers in other processes map with
+    // attach(), read-only. attach() takes over the descriptor.
+    int createShared(size_t capacity);
+    int attach(int fd);
+    int getFd() const { return memfd; }
+
+    size_t getCapacity() const { return hdr ? hdr->capacity : 0; }
+    uint64_t getStart() const;
+    uint64_t getEnd() const;
+
+    bool push(uint32_t seq, WlaMessageBuffer &msg);
+    size_t snapshot(std::vector<char> &out, uint64_t *from = NULL) const;
+
+    static size_t getRecordSize(const char *record);
+
+    // For consumers running on the writer's thread, nothing moves under them
+    // there. find() returns the first record that isn't older than seq, the
+    // end when there is none.
+    bool hasRoom(uint64_t keep, size_t len) const;
+    uint32_t getSeqAt(uint64_t pos) const;
+    size_t getRecordSizeAt(uint64_t pos) const { return recordSizeAt(pos); }
+    const char *peek(uint64_t pos, size_t *len) const;
+    uint64_t find(uint32_t seq) const;
+    void read(uint64_t pos, char *dst, size_t len) const { copyOut(pos, dst, len); }
+
+    // For readers that don't run on the writer's thread: tells whether what
+    // was just read at pos may have been changed by the writer meanwhile.
+    bool isOverwritten(uint64_t pos) const;
+
+private:
+    void release();
+    size_t recordSizeAt(uint64_t pos) const;
+    void copyIn(uint64_t pos, const char *src, size_t len);
+    void copyOut(uint64_t pos, char *dst, size_t len) const;
+
+private:
+    WldRingHeader *hdr;
+    char *data;
+    int memfd;
+    size_t map_size;
+};
+
+#endif // RING_H
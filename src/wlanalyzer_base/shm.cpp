@@ -0,0 +1,336 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <arpa/inet.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include "message.h"
+#include "shm.h"
+
+WldShmDumper::WldShmDumper(size_t capacity) : capacity(capacity), seq(0)
+{
+}
+
+WldShmDumper::~WldShmDumper()
+{
+    while (!readers.empty())
+        removeReader(readers.front());
+
+    notifier.stop();
+    serverwtch.stop();
+}
+
+int WldShmDumper::open(const std::string &resource)
+{
+    if (server.isListening())
+    {
+        DEBUG_LOG("Dumper already listening");
+        return -1;
+    }
+
+    if (ring.createShared(capacity))
+        return -1;
+
+    unlink(resource.c_str());
+    server.setMaxPendingConnections(8);
+    if (!server.listen(resource))
+        return -1;
+
+    serverwtch.set<WldShmDumper, &WldShmDumper::acceptReader>(this);
+    serverwtch.start(server.getFd(), EV_READ);
+    notifier.set<WldShmDumper, &WldShmDumper::notifyReaders>(this);
+
+    return 0;
+}
+
+int WldShmDumper::dump(WlaMessageBuffer &msg)
+{
+    if (!ring.push(seq++, msg))
+        return -1;
+
+    if (!readers.empty() && !notifier.is_active())
+        notifier.start();
+
+    return 0;
+}
+
+void WldShmDumper::notifyReaders(ev::prepare &watcher, int revents)
+{
+    uint64_t one = 1;
+    std::list<Reader *>::iterator it = readers.begin();
+    for (; it != readers.end(); it++)
+    {
+        if (write((*it)->eventfd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            DEBUG_LOG("failed to wake up a reader: %s", strerror(errno));
+    }
+
+    notifier.stop();
+}
+
+void WldShmDumper::acceptReader(ev::io &watcher, int revents)
+{
+    if (revents & EV_ERROR)
+        return;
+
+    bool timedout;
+    if (!server.waitForConnection(0, &timedout))
+        return;
+
+    WldSocket *socket = server.nextPendingConnection();
+    if (!socket)
+        return;
+
+    int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd == -1)
+    {
+        DEBUG_LOG("eventfd failed: %s", strerror(errno));
+        delete socket;
+        return;
+    }
+
+    uint32_t hello[] = { htonl(WLD_SHM_MAGIC), htonl(WLD_SHM_VERSION) };
+    iovec iov;
+    iov.iov_base = hello;
+    iov.iov_len = sizeof(hello);
+
+    int fds[] = { ring.getFd(), efd };
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    if (socket->writeMsg(&msg) != (int)sizeof(hello))
+    {
+        DEBUG_LOG("failed to send the ring to the reader");
+        close(efd);
+        delete socket;
+        return;
+    }
+
+    Reader *reader = new Reader;
+    reader->socket = socket;
+    reader->eventfd = efd;
+    readers.push_back(reader);
+
+    socket->set<WldShmDumper, &WldShmDumper::handleReaderEvent>(this);
+    socket->start(EV_READ);
+
+    Logger::getInstance()->log("Analyzer attached to the shared memory ring\n");
+}
+
+void WldShmDumper::handleReaderEvent(ev::io &watcher, int revents)
+{
+    std::list<Reader *>::iterator it = readers.begin();
+    for (; it != readers.end(); it++)
+    {
+        if ((*it)->socket != &watcher)
+            continue;
+
+        // readers never send anything, this is the end of the connection
+        char buf[16];
+        ssize_t len = recv((*it)->socket->getSocketDescriptor(), buf, sizeof(buf), MSG_DONTWAIT);
+        if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR))
+            removeReader(*it);
+        return;
+    }
+}
+
+void WldShmDumper::removeReader(Reader *reader)
+{
+    reader->socket->stop();
+    delete reader->socket;
+    close(reader->eventfd);
+
+    readers.remove(reader);
+    delete reader;
+}
+
+WldShmParser::WldShmParser() : eventfd(-1), cursor(0), next_seq(0)
+{
+}
+
+WldShmParser::~WldShmParser()
+{
+    wakeupwtch.stop();
+    socketwtch.stop();
+
+    if (eventfd != -1)
+        close(eventfd);
+}
+
+int WldShmParser::openResource(const std::string &resource)
+{
+    std::string path = resource;
+    if (!path.compare(0, sizeof(WLD_SHM_PREFIX) - 1, WLD_SHM_PREFIX))
+        path = path.substr(sizeof(WLD_SHM_PREFIX) - 1);
+
+    if (path.empty())
+    {
+        DEBUG_LOG("path is empty");
+        return -1;
+    }
+
+    if (socket.connectToServer(path) != NoError)
+        return -1;
+
+    uint32_t hello[2];
+    iovec iov;
+    iov.iov_base = hello;
+    iov.iov_len = sizeof(hello);
+
+    int fds[2];
+    char control[CMSG_SPACE(sizeof(fds))];
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsghdr *cmsg;
+    if (socket.readMsg(&msg) != (int)sizeof(hello) || !(cmsg = CMSG_FIRSTHDR(&msg)) ||
+            cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+    {
+        Logger::getInstance()->log("%s didn't send a ring\n", path.c_str());
+        return -1;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    if (ntohl(hello[0]) != WLD_SHM_MAGIC || ntohl(hello[1]) != WLD_SHM_VERSION)
+    {
+        Logger::getInstance()->log("Unsupported shared memory ring version\n");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    eventfd = fds[1];
+    if (ring.attach(fds[0]))
+        return -1;
+
+    cursor = ring.getStart();
+    next_seq = cursor < ring.getEnd() ? ring.getSeqAt(cursor) : 0;
+
+    wakeupwtch.set<WldShmParser, &WldShmParser::handleWakeup>(this);
+    wakeupwtch.start(eventfd, EV_READ);
+    socketwtch.set<WldShmParser, &WldShmParser::handleSocketEvent>(this);
+    socketwtch.start(socket.getSocketDescriptor(), EV_READ);
+
+    // whatever is in the ring already
+    wakeupwtch.feed_event(EV_READ);
+
+    return 0;
+}
+
+void WldShmParser::handleWakeup(ev::io &watcher, int revents)
+{
+    uint64_t count;
+    if (read(eventfd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        DEBUG_LOG("failed to read the eventfd: %s", strerror(errno));
+
+    parse();
+}
+
+void WldShmParser::handleSocketEvent(ev::io &watcher, int revents)
+{
+    Logger::getInstance()->log("The dumper is gone\n");
+
+    parse();
+
+    wakeupwtch.stop();
+    socketwtch.stop();
+    socket.disconnectFromServer();
+}
+
+void WldShmParser::makeGap(WlaMessageView &msg, uint32_t count)
+{
+    gap.setGap(count);
+    scratch.resize(gap.getRecordSize());
+    gap.serializeRecord(next_seq, &scratch[0], scratch.size());
+    msg.parseRecord(&scratch[0], scratch.size());
+}
+
+bool WldShmParser::nextMessage(WlaMessageView &msg)
+{
+    if (!ring.isValid())
+        return false;
+
+    size_t min_size = WldRecordRing::getRecordSize(NULL);
+    while (true)
+    {
+        uint64_t end = ring.getEnd();
+        if (cursor >= end)
+            return false;
+
+        size_t size = ring.getRecordSizeAt(cursor);
+        bool valid = size >= min_size && size <= end - cursor;
+
+        // The writer never waits, it may lap the reader at any point while
+        // the record is analyzed. Copy it out first, the copy is only good if
+        // the record is still in the ring once it is done.
+        if (valid)
+        {
+            scratch.resize(size);
+            ring.read(cursor, &scratch[0], size);
+        }
+
+        if (ring.isOverwritten(cursor))
+        {
+            uint64_t start = ring.getStart();
+            uint32_t first = ring.getSeqAt(start);
+            if (ring.isOverwritten(start))
+                continue;
+
+            cursor = start;
+            makeGap(msg, first - next_seq);
+            next_seq = first;
+            return true;
+        }
+
+        if (!valid || msg.parseRecord(&scratch[0], size) < 0)
+        {
+            Logger::getInstance()->log("Corrupted record in the shared memory ring\n");
+            wakeupwtch.stop();
+            socketwtch.stop();
+            return false;
+        }
+
+        cursor += size;
+        next_seq = msg.getSeq() + (msg.isGap() ? msg.getGapCount() : 1);
+
+        return true;
+    }
+}
@@ -0,0 +1,112 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SHM_H
+#define SHM_H
+
+#include <list>
+#include <string>
+#include <vector>
+#include <ev++.h>
+#include "dumper.h"
+#include "parser.h"
+#include "ring.h"
+#include "server_socket.h"
+
+// Analyzers on the same host connect to a Unix socket and get the memfd of
+// the ring plus an eventfd, along with the magic and version in network
+// byte order. The ring is written once by the dumper, analyzers copy the
+// records straight out of it.
+const uint32_t WLD_SHM_MAGIC = 0x574c4453; // "WLDS"
+const uint32_t WLD_SHM_VERSION = 1;
+const char WLD_SHM_PREFIX[] = "shm:";
+
+// The writer never waits for readers, a reader that falls behind by more
+// than the ring capacity loses the oldest records. Readers are woken up at
+// most once per event loop iteration.
+class WldShmDumper : public WldDumper
+{
+public:
+    WldShmDumper(size_t capacity = DEFAULT_CAPACITY);
+    virtual ~WldShmDumper();
+
+    virtual int open(const std::string &resource);
+    virtual int dump(WlaMessageBuffer &msg);
+
+    size_t getReaderCount() const { return readers.size(); }
+
+private:
+    struct Reader
+    {
+        WldSocket *socket;
+        int eventfd;
+    };
+
+    void acceptReader(ev::io &watcher, int revents);
+    void handleReaderEvent(ev::io &watcher, int revents);
+    void notifyReaders(ev::prepare &watcher, int revents);
+    void removeReader(Reader *reader);
+
+private:
+    static const size_t DEFAULT_CAPACITY = 16 * 1024 * 1024;
+
+    WldRecordRing ring;
+    size_t capacity;
+    uint32_t seq;
+
+    WldServer server;
+    ev::io serverwtch;
+    ev::prepare notifier;
+    std::list<Reader *> readers;
+};
+
+class WldShmParser : public WldParser
+{
+public:
+    WldShmParser();
+    ~WldShmParser();
+
+    // Takes the path of the dumper's socket, with or without WLD_SHM_PREFIX
+    int openResource(const std::string &resource);
+
+private:
+    void handleWakeup(ev::io &watcher, int revents);
+    void handleSocketEvent(ev::io &watcher, int revents);
+    bool nextMessage(WlaMessageView &msg);
+    void makeGap(WlaMessageView &msg, uint32_t count);
+
+private:
+    WldSocket socket;
+    WldRecordRing ring;
+    int eventfd;
+    ev::io wakeupwtch;
+    ev::io socketwtch;
+
+    uint64_t cursor;
+    uint32_t next_seq;
+    std::vector<char> scratch;
+    WlaMessageBuffer gap;
+};
+
+#endif // SHM_H
@@ -0,0 +1,464 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include "common.h"
+#include "logger.h"
+#include "stats.h"
+
+const uint32_t WldStats::windows[3] = { 1, 10, 60 };
+
+// Only the owning thread writes, a load and a store are enough
+static inline void bump(uint64_t &counter, uint64_t value)
+{
+    __atomic_store_n(&counter, __atomic_load_n(&counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+template <typename T>
+static inline T load(const T &value)
+{
+    return __atomic_load_n(&value, __ATOMIC_RELAXED);
+}
+
+WldStatsCounters::WldStatsCounters(size_t count) : last_object(0), latest(0)
+{
+    Message message;
+    memset(&message, 0, sizeof(message));
+    messages.resize(count, message);
+
+    Second second = { -1, 0, 0 };
+    seconds.resize(count * WINDOW_SECONDS, second);
+
+    memset(objects, 0, sizeof(objects));
+}
+
+void WldStatsCounters::add(const WldMessage &msg, const WldInterface &intf, uint32_t obj_id,
+                           uint32_t size, const timeval &time)
+{
+    if (msg.index >= messages.size())
+        return;
+
+    Message &message = messages[msg.index];
+    bump(message.count, 1);
+    bump(message.bytes, size);
+    bump(message.fds, msg.program.fds);
+
+    uint32_t bucket = 0;
+    for (uint32_t s = size >> 4; s && bucket < SIZE_BUCKETS - 1; s >>= 1)
+        bucket++;
+    bump(message.sizes[bucket], 1);
+
+    int64_t sec = time.tv_sec;
+    Second &second = seconds[msg.index * WINDOW_SECONDS + sec % WINDOW_SECONDS];
+    if (second.sec != sec)
+    {
+        __atomic_store_n(&second.count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&second.bytes, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&second.sec, sec, __ATOMIC_RELAXED);
+    }
+    bump(second.count, 1);
+    bump(second.bytes, size);
+    if (sec > latest)
+        __atomic_store_n(&latest, sec, __ATOMIC_RELAXED);
+
+    Object *obj = &objects[last_object];
+    if (obj->intf != &intf || obj->id != obj_id)
+    {
+        uint32_t least = 0;
+        uint32_t i = 0;
+        for (; i < TOP_OBJECTS; i++)
+        {
+            if (objects[i].intf == &intf && objects[i].id == obj_id)
+                break;
+            if (objects[i].bytes < objects[least].bytes)
+                least = i;
+        }
+
+        if (i == TOP_OBJECTS)
+        {
+            i = least;
+            __atomic_store_n(&objects[i].intf, &intf, __ATOMIC_RELAXED);
+            __atomic_store_n(&objects[i].id, obj_id, __ATOMIC_RELAXED);
+        }
+        last_object = i;
+        obj = &objects[i];
+    }
+    bump(obj->count, 1);
+    bump(obj->bytes, size);
+}
+
+void WldStatsCounters::fold(const WldStatsCounters &other)
+{
+    size_t count = std::min(messages.size(), other.messages.size());
+    for (size_t m = 0; m < count; m++)
+    {
+        Message &message = messages[m];
+        const Message &added = other.messages[m];
+        message.count += added.count;
+        message.bytes += added.bytes;
+        message.fds += added.fds;
+        for (uint32_t b = 0; b < SIZE_BUCKETS; b++)
+            message.sizes[b] += added.sizes[b];
+
+        // a second only adds up with the same one, the later wins otherwise
+        for (uint32_t s = 0; s < WINDOW_SECONDS; s++)
+        {
+            Second &second = seconds[m * WINDOW_SECONDS + s];
+            const Second &other_second = other.seconds[m * WINDOW_SECONDS + s];
+            if (other_second.sec == second.sec)
+            {
+                second.count += other_second.count;
+                second.bytes += other_second.bytes;
+            }
+            else if (other_second.sec > second.sec)
+            {
+                second = other_second;
+            }
+        }
+    }
+    latest = std::max(latest, other.latest);
+
+    // the busiest of both make it
+    for (uint32_t o = 0; o < TOP_OBJECTS; o++)
+    {
+        const Object &obj = other.objects[o];
+        if (!obj.intf)
+            continue;
+
+        uint32_t least = 0;
+        uint32_t i = 0;
+        for (; i < TOP_OBJECTS; i++)
+        {
+            if (objects[i].intf == obj.intf && objects[i].id == obj.id)
+                break;
+            if (objects[i].bytes < objects[least].bytes)
+                least = i;
+        }
+
+        if (i < TOP_OBJECTS)
+        {
+            objects[i].count += obj.count;
+            objects[i].bytes += obj.bytes;
+        }
+        else if (!objects[least].intf || objects[least].bytes < obj.bytes)
+        {
+            objects[least] = obj;
+        }
+    }
+}
+
+WldStats::WldStats(const WldProtocolDefinition *protocol) : protocol(protocol), retired(NULL)
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+WldStats::~WldStats()
+{
+    for (size_t i = 0; i < counters.size(); i++)
+        delete counters[i];
+
+    pthread_mutex_destroy(&lock);
+}
+
+WldStatsCounters *WldStats::addCounters()
+{
+    WldStatsCounters *added = new WldStatsCounters(protocol->getMessageCount());
+
+    pthread_mutex_lock(&lock);
+    counters.push_back(added);
+    pthread_mutex_unlock(&lock);
+
+    return added;
+}
+
+void WldStats::removeCounters(WldStatsCounters *removed)
+{
+    pthread_mutex_lock(&lock);
+    std::vector<WldStatsCounters *>::iterator it = std::find(counters.begin(), counters.end(), removed);
+    if (it != counters.end())
+    {
+        counters.erase(it);
+        if (!retired)
+        {
+            retired = new WldStatsCounters(protocol->getMessageCount());
+            counters.push_back(retired);
+        }
+        retired->fold(*removed);
+    }
+    pthread_mutex_unlock(&lock);
+
+    delete removed;
+}
+
+bool WldStats::busier(const WldStatsCounters::Object &a, const WldStatsCounters::Object &b)
+{
+    return a.bytes > b.bytes;
+}
+
+void WldStats::collect(std::vector<Totals> &totals, std::vector<WldStatsCounters::Object> &top) const
+{
+    Totals empty;
+    memset(&empty, 0, sizeof(empty));
+    totals.assign(protocol->getMessageCount(), empty);
+
+    typedef std::map<std::pair<const WldInterface *, uint32_t>, WldStatsCounters::Object> objects_t;
+    objects_t objects;
+
+    pthread_mutex_lock(&lock);
+
+    int64_t now = 0;
+    for (size_t i = 0; i < counters.size(); i++)
+        now = std::max(now, load(counters[i]->latest));
+
+    for (size_t i = 0; i < counters.size(); i++)
+    {
+        const WldStatsCounters &c = *counters[i];
+        size_t count = std::min(c.messages.size(), totals.size());
+
+        for (size_t m = 0; m < count; m++)
+        {
+            const WldStatsCounters::Message &message = c.messages[m];
+            Totals &total = totals[m];
+            total.count += load(message.count);
+            total.bytes += load(message.bytes);
+            total.fds += load(message.fds);
+            for (uint32_t b = 0; b < WldStatsCounters::SIZE_BUCKETS; b++)
+                total.sizes[b] += load(message.sizes[b]);
+
+            for (uint32_t s = 0; s < WldStatsCounters::WINDOW_SECONDS; s++)
+            {
+                const WldStatsCounters::Second &second = c.seconds[m * WldStatsCounters::WINDOW_SECONDS + s];
+                int64_t sec = load(second.sec);
+                for (uint32_t w = 0; w < 3; w++)
+                {
+                    if (sec <= now && sec > now - windows[w])
+                    {
+                        total.window_count[w] += load(second.count);
+                        total.window_bytes[w] += load(second.bytes);
+                    }
+                }
+            }
+        }
+
+        for (uint32_t o = 0; o < WldStatsCounters::TOP_OBJECTS; o++)
+        {
+            const WldInterface *intf = load(c.objects[o].intf);
+            if (!intf)
+                continue;
+
+            WldStatsCounters::Object &obj = objects[std::make_pair(intf, load(c.objects[o].id))];
+            obj.intf = intf;
+            obj.id = load(c.objects[o].id);
+            obj.count += load(c.objects[o].count);
+            obj.bytes += load(c.objects[o].bytes);
+        }
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    top.clear();
+    objects_t::const_iterator it = objects.begin();
+    for (; it != objects.end(); it++)
+        top.push_back(it->second);
+    std::sort(top.begin(), top.end(), WldStats::busier);
+    if (top.size() > TOP_OUTPUT)
+        top.resize(TOP_OUTPUT);
+}
+
+static void append(std::string &out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void append(std::string &out, const char *format, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+
+    if (len > 0)
+        out.append(buf, std::min<size_t>(len, sizeof(buf) - 1));
+}
+
+void WldStats::write(Format format, std::string &out) const
+{
+    std::vector<Totals> totals;
+    std::vector<WldStatsCounters::Object> top;
+    collect(totals, top);
+
+    out.clear();
+    if (format == FORMAT_JSON)
+        writeJson(totals, top, out);
+    else
+        writePrometheus(totals, top, out);
+}
+
+int WldStats::save(const std::string &path, Format format) const
+{
+    std::string out;
+    write(format, out);
+
+    return writeFile(path, std::vector<char>(out.begin(), out.end()));
+}
+
+void WldStats::writeJson(const std::vector<Totals> &totals, const std::vector<WldStatsCounters::Object> &top,
+                         std::string &out) const
+{
+    out += "{\n  \"messages\": [";
+
+    bool first = true;
+    for (size_t m = 0; m < totals.size(); m++)
+    {
+        const Totals &total = totals[m];
+        if (!total.count)
+            continue;
+
+        const WldMessage *msg = protocol->getMessage(m);
+        append(out, "%s\n    { \"interface\": \"%s\", \"message\": \"%s\", \"type\": \"%s\", \"opcode\": %u,",
+               first ? "" : ",", msg->intf_name.c_str(), msg->signature.c_str(),
+               msg->type == WLD_MSG_EVENT ? "event" : "request", msg->opcode);
+        append(out, " \"count\": %llu, \"bytes\": %llu, \"fds\": %llu,\n",
+               (unsigned long long)total.count, (unsigned long long)total.bytes,
+               (unsigned long long)total.fds);
+        first = false;
+
+        out += "      \"rate\": {";
+        for (uint32_t w = 0; w < 3; w++)
+            append(out, "%s \"%us\": %.3f", w ? "," : "", windows[w],
+                   (double)total.window_count[w] / windows[w]);
+        out += " },\n      \"byte_rate\": {";
+        for (uint32_t w = 0; w < 3; w++)
+            append(out, "%s \"%us\": %.3f", w ? "," : "", windows[w],
+                   (double)total.window_bytes[w] / windows[w]);
+
+        // sizes from min to max bytes, the last bucket takes the rest
+        out += " },\n      \"sizes\": [";
+        bool first_bucket = true;
+        for (uint32_t b = 0; b < WldStatsCounters::SIZE_BUCKETS; b++)
+        {
+            if (!total.sizes[b])
+                continue;
+            append(out, "%s { \"min\": %u, \"count\": %llu }", first_bucket ? "" : ",",
+                   b ? 8u << b : 0, (unsigned long long)total.sizes[b]);
+            first_bucket = false;
+        }
+        out += " ] }";
+    }
+
+    out += "\n  ],\n  \"top_objects\": [";
+    for (size_t i = 0; i < top.size(); i++)
+    {
+        append(out, "%s\n    { \"interface\": \"%s\", \"id\": %u, \"count\": %llu, \"bytes\": %llu }",
+               i ? "," : "", top[i].intf->name.c_str(), top[i].id,
+               (unsigned long long)top[i].count, (unsigned long long)top[i].bytes);
+    }
+    out += "\n  ]\n}\n";
+}
+
+void WldStats::writePrometheus(const std::vector<Totals> &totals,
+                               const std::vector<WldStatsCounters::Object> &top, std::string &out) const
+{
+    static const struct
+    {
+        const char *name;
+        const char *type;
+        const char *help;
+    } metrics[] =
+    {
+        { "wld_messages_total", "counter", "Messages analyzed" },
+        { "wld_message_bytes_total", "counter", "Bytes of the messages analyzed, headers included" },
+        { "wld_message_fds_total", "counter", "File descriptors sent with the messages" },
+        { "wld_message_rate", "gauge", "Messages per second over the last window of capture time" },
+        { "wld_message_byte_rate", "gauge", "Bytes per second over the last window of capture time" },
+        { "wld_message_size_bytes", "histogram", "Message sizes, headers included" }
+    };
+
+    for (size_t i = 0; i < sizeof(metrics) / sizeof(metrics[0]); i++)
+    {
+        append(out, "# HELP %s %s\n# TYPE %s %s\n", metrics[i].name, metrics[i].help,
+               metrics[i].name, metrics[i].type);
+
+        for (size_t m = 0; m < totals.size(); m++)
+        {
+            const Totals &total = totals[m];
+            if (!total.count)
+                continue;
+
+            const WldMessage *msg = protocol->getMessage(m);
+            char labels[192];
+            snprintf(labels, sizeof(labels), "interface=\"%s\",message=\"%s\",type=\"%s\"",
+                     msg->intf_name.c_str(), msg->signature.c_str(),
+                     msg->type == WLD_MSG_EVENT ? "event" : "request");
+
+            switch (i)
+            {
+            case 0:
+                append(out, "%s{%s} %llu\n", metrics[i].name, labels, (unsigned long long)total.count);
+                break;
+            case 1:
+                append(out, "%s{%s} %llu\n", metrics[i].name, labels, (unsigned long long)total.bytes);
+                break;
+            case 2:
+                append(out, "%s{%s} %llu\n", metrics[i].name, labels, (unsigned long long)total.fds);
+                break;
+            case 3:
+            case 4:
+                for (uint32_t w = 0; w < 3; w++)
+                    append(out, "%s{%s,window=\"%us\"} %.3f\n", metrics[i].name, labels, windows[w],
+                           (double)(i == 3 ? total.window_count[w] : total.window_bytes[w]) / windows[w]);
+                break;
+            default:
+            {
+                uint64_t cumulative = 0;
+                for (uint32_t b = 0; b < WldStatsCounters::SIZE_BUCKETS - 1; b++)
+                {
+                    cumulative += total.sizes[b];
+                    append(out, "%s_bucket{%s,le=\"%u\"} %llu\n", metrics[i].name, labels,
+                           (16u << b) - 1, (unsigned long long)cumulative);
+                }
+                append(out, "%s_bucket{%s,le=\"+Inf\"} %llu\n", metrics[i].name, labels,
+                       (unsigned long long)total.count);
+                append(out, "%s_sum{%s} %llu\n", metrics[i].name, labels, (unsigned long long)total.bytes);
+                append(out, "%s_count{%s} %llu\n", metrics[i].name, labels, (unsigned long long)total.count);
+                break;
+            }
+            }
+        }
+    }
+
+    out += "# HELP wld_object_messages_total Messages of the objects with the most traffic\n"
+           "# TYPE wld_object_messages_total counter\n";
+    for (size_t i = 0; i < top.size(); i++)
+        append(out, "wld_object_messages_total{interface=\"%s\",id=\"%u\"} %llu\n",
+               top[i].intf->name.c_str(), top[i].id, (unsigned long long)top[i].count);
+
+    out += "# HELP wld_object_bytes_total Bytes of the objects with the most traffic\n"
+           "# TYPE wld_object_bytes_total counter\n";
+    for (size_t i = 0; i < top.size(); i++)
+        append(out, "wld_object_bytes_total{interface=\"%s\",id=\"%u\"} %llu\n",
+               top[i].intf->name.c_str(), top[i].id, (unsigned long long)top[i].bytes);
+}
@@ -0,0 +1,147 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Samsung Electronics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <pthread.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+#include "xml/protocol_parser.h"
+
+// What one analyzer counted, written only by the thread it runs on. The
+// counters are read with relaxed atomics, so neither side ever locks.
+class WldStatsCounters
+{
+public:
+    static const uint32_t SIZE_BUCKETS = 10;   // powers of two from 8 bytes up
+    static const uint32_t WINDOW_SECONDS = 60; // longest rate window
+    static const uint32_t TOP_OBJECTS = 32;    // tracked per thread
+
+    explicit WldStatsCounters(size_t messages);
+
+    void add(const WldMessage &msg, const WldInterface &intf, uint32_t obj_id, uint32_t size,
+             const timeval &time);
+
+private:
+    friend class WldStats;
+
+    // adds what a removed analyzer counted, only ever called with the lock
+    // of WldStats held and other not counting anymore
+    void fold(const WldStatsCounters &other);
+
+    struct Message
+    {
+        uint64_t count;
+        uint64_t bytes;
+        uint64_t fds;
+        uint64_t sizes[SIZE_BUCKETS];
+    };
+
+    // one of the last WINDOW_SECONDS of a message
+    struct Second
+    {
+        int64_t sec;
+        uint64_t count;
+        uint64_t bytes;
+    };
+
+    // The objects with the most traffic, kept with the space saving
+    // algorithm: one that isn't tracked takes over the least busy entry,
+    // counts included, so they are an upper bound once entries got reused
+    struct Object
+    {
+        const WldInterface *intf; // NULL if unused
+        uint32_t id;
+        uint64_t count;
+        uint64_t bytes;
+    };
+
+    std::vector<Message> messages;
+    std::vector<Second> seconds; // WINDOW_SECONDS per message
+    Object objects[TOP_OBJECTS];
+    uint32_t last_object;        // hit last, traffic comes in bursts
+    int64_t latest;              // second of the latest message
+};
+
+// Message counts, byte volumes, fds, rates over the last 1, 10 and 60
+// seconds of capture time and size distributions per message, and the
+// objects with the most traffic. Every analyzer decoding with it, the
+// copies running on other threads included, counts on its own and it
+// all gets summed up when written. What an analyzer counted is kept once
+// it goes away. It has to outlive the analyzers.
+class WldStats
+{
+public:
+    enum Format
+    {
+        FORMAT_JSON,
+        FORMAT_PROMETHEUS
+    };
+
+    // the protocol has to be complete, messages added later aren't counted
+    explicit WldStats(const WldProtocolDefinition *protocol);
+    ~WldStats();
+
+    WldStatsCounters *addCounters();
+    // folds the counts into those of the analyzers gone before and frees them
+    void removeCounters(WldStatsCounters *removed);
+
+    void write(Format format, std::string &out) const;
+    int save(const std::string &path, Format format) const;
+
+private:
+    static const uint32_t TOP_OUTPUT = 10;
+
+    struct Totals
+    {
+        uint64_t count;
+        uint64_t bytes;
+        uint64_t fds;
+        uint64_t sizes[WldStatsCounters::SIZE_BUCKETS];
+        uint64_t window_count[3];
+        uint64_t window_bytes[3];
+    };
+
+    static bool busier(const WldStatsCounters::Object &a, const WldStatsCounters::Object &b);
+    void collect(std::vector<Totals> &totals, std::vector<WldStatsCounters::Object> &top) const;
+    void writeJson(const std::vector<Totals> &totals, const std::vector<WldStatsCounters::Object> &top,
+                   std::string &out) const;
+    void writePrometheus(const std::vector<Totals> &totals,
+                         const std::vector<WldStatsCounters::Object> &top, std::string &out) const;
+
+private:
+    static const uint32_t windows[3];
+
+    const WldProtocolDefinition *protocol;
+    mutable pthread_mutex_t lock;
+    std::vector<WldStatsCounters *> counters;
+    WldStatsCounters *retired; // in counters too, NULL until one is removed
+
+    WldStats(const WldStats &);
+    WldStats &operator=(const WldStats &);
+};
+
+#endif // STATS_H
@@ -0,0 +1,217 @@
+#! /usr/bin/env python
+#
+# The MIT License (MIT)
+#
+# Copyright (c) 2014 Samsung Electronics
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+# Turns protocol specifications into the tables WldProtocolScanner loads
+# built in protocols from, along with opcode and enum constants.
+#
+# Usage: protocol_codegen.py <header> <source> <protocol.xml>...
+
+import os
+import sys
+import xml.etree.ElementTree as ET
+
+ARG_TYPES = {
+    'int': 'WLD_ARG_INT',
+    'uint': 'WLD_ARG_UINT',
+    'fixed': 'WLD_ARG_FIXED',
+    'string': 'WLD_ARG_STRING',
+    'object': 'WLD_ARG_OBJECT',
+    'new_id': 'WLD_ARG_NEWID',
+    'array': 'WLD_ARG_ARRAY',
+    'fd': 'WLD_ARG_FD',
+}
+
+LICENSE = '''/*
+ * Generated by protocol_codegen.py from
+%s
+ * Do not edit.
+ */
+'''
+
+
+def c_string(s):
+    if s is None:
+        return 'NULL'
+    return '"%s"' % s.replace('\\', '\\\\').replace('"', '\\"')
+
+
+def c_name(*parts):
+    return '_'.join(parts).upper().replace('-', '_')
+
+
+# Mirrors WldProtocolScanner::compileProgram
+def compile_program(args):
+    ops = []
+    fds = 0
+    min_size = 0
+    for i, arg in enumerate(args):
+        arg_type = arg.get('type')
+        op = 'WLD_OP_WORDS'
+        if arg_type == 'string':
+            op = 'WLD_OP_STRING'
+            min_size += 4
+        elif arg_type == 'array':
+            op = 'WLD_OP_ARRAY'
+            min_size += 4
+        elif arg_type == 'new_id':
+            if arg.get('interface'):
+                op = 'WLD_OP_NEW_ID'
+                min_size += 4
+            else:
+                op = 'WLD_OP_DYNAMIC_NEW_ID'
+                min_size += 12
+        elif arg_type == 'fd':
+            op = 'WLD_OP_FD'
+            fds += 1
+        else:
+            min_size += 4
+
+        if op == 'WLD_OP_WORDS' and ops and ops[-1][0] == 'WLD_OP_WORDS':
+            ops[-1][1] += 1
+        else:
+            ops.append([op, 1, i])
+
+    return ops, fds, min_size
+
+
+class Generator:
+    def __init__(self):
+        self.header = []
+        self.source = []
+        self.protocols = []
+
+    def message(self, prefix, node):
+        name = node.get('name')
+        symbol = '%s_%s' % (prefix, name)
+        args = node.findall('arg')
+
+        arg_table = 'NULL'
+        if args:
+            arg_table = 'args_%s' % symbol
+            self.source.append('static const WldBuiltinArg %s[] =\n{' % arg_table)
+            for arg in args:
+                intf = None
+                if arg.get('type') == 'new_id':
+                    intf = arg.get('interface')
+                self.source.append('    { %s, %s, %s },' % (c_string(arg.get('name')),
+                                   ARG_TYPES.get(arg.get('type'), 'WLD_ARG_UNKNOWN'),
+                                   c_string(intf)))
+            self.source.append('};\n')
+
+        ops, fds, min_size = compile_program(args)
+        op_table = 'NULL'
+        if ops:
+            op_table = 'ops_%s' % symbol
+            self.source.append('static const WldDecodeOp %s[] =\n{' % op_table)
+            for op in ops:
+                self.source.append('    { %s, %d, %d },' % tuple(op))
+            self.source.append('};\n')
+
+        destructor = 'true' if node.get('type') == 'destructor' else 'false'
+        return '    { %s, %s, %d, %s, %d, %d, %d, %s },' % (c_string(name), arg_table, len(args),
+                                                           op_table, len(ops), fds, min_size, destructor)
+
+    def messages(self, intf, kind):
+        nodes = intf.findall(kind)
+        if not nodes:
+            return 'NULL', 0
+
+        prefix = intf.get('name')
+        entries = []
+        for opcode, node in enumerate(nodes):
+            entries.append(self.message('%s_%s' % (prefix, kind), node))
+            self.header.append('static const uint32_t %s = %d;' %
+                               (c_name('wld', prefix, kind, node.get('name')), opcode))
+
+        table = '%ss_%s' % (kind, prefix)
+        self.source.append('static const WldBuiltinMessage %s[] =\n{' % table)
+        self.source.extend(entries)
+        self.source.append('};\n')
+        return table, len(nodes)
+
+    def enums(self, intf):
+        for enum in intf.findall('enum'):
+            for entry in enum.findall('entry'):
+                self.header.append('static const uint32_t %s = %s;' %
+                                   (c_name('wld', intf.get('name'), enum.get('name'), entry.get('name')),
+                                    entry.get('value')))
+
+    def protocol(self, path):
+        root = ET.parse(path).getroot()
+        name = root.get('name')
+
+        self.header.append('\n// %s' % name)
+        entries = []
+        for intf in root.findall('interface'):
+            requests, request_count = self.messages(intf, 'request')
+            events, event_count = self.messages(intf, 'event')
+            self.enums(intf)
+            entries.append('    { %s, %s, %s, %d, %s, %d },' %
+                           (c_string(intf.get('name')), intf.get('version', '0'),
+                            requests, request_count, events, event_count))
+
+        table = 'interfaces_%s' % name
+        self.source.append('static const WldBuiltinInterface %s[] =\n{' % table)
+        self.source.extend(entries)
+        self.source.append('};\n')
+        self.protocols.append('    { %s, %s, %d },' % (c_string(name), table, len(entries)))
+
+    def write(self, header, source, paths):
+        files = '\n'.join([' * %s' % os.path.basename(p) for p in paths])
+        guard = 'WLD_PROTOCOLS_H'
+
+        out = open(header, 'w')
+        out.write(LICENSE % files)
+        out.write('\n#ifndef %s\n#define %s\n\n' % (guard, guard))
+        out.write('#include "xml/protocol_parser.h"\n\n')
+        out.write('extern const WldBuiltinProtocol wld_builtin_protocols[];\n')
+        out.write('extern const uint32_t wld_builtin_protocol_count;\n')
+        out.write('\n'.join(self.header))
+        out.write('\n\n#endif // %s\n' % guard)
+        out.close()
+
+        out = open(source, 'w')
+        out.write(LICENSE % files)
+        out.write('\n#include "%s"\n\n' % os.path.basename(header))
+        out.write('\n'.join(self.source))
+        out.write('\nconst WldBuiltinProtocol wld_builtin_protocols[] =\n{\n')
+        out.write('\n'.join(self.protocols))
+        out.write('\n};\n\nconst uint32_t wld_builtin_protocol_count = %d;\n' % len(self.protocols))
+        out.close()
+
+
+def main(argv):
+    if len(argv) < 4:
+        sys.stderr.write('Usage: %s <header> <source> <protocol.xml>...\n' % argv[0])
+        return 1
+
+    generator = Generator()
+    for path in argv[3:]:
+        generator.protocol(path)
+    generator.write(argv[1], argv[2], argv[3:])
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
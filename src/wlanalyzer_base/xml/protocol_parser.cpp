@@ -23,8 +23,12 @@
  */
 
 
+#include <string.h>
 #include "../common.h"
 #include "protocol_parser.h"
+#ifdef WLD_BUILTIN_PROTOCOLS
+#include "wld_protocols.h"
+#endif
 
 using namespace pugi;
 
@@ -33,7 +37,7 @@ WldProtocolDefinition::type_size_t WldProtocolDefinition::type_size;
 bool WldProtocolDefinition::initialized = false;
 bool WldProtocolScanner::initialized = false;
 
-WldProtocolScanner::WldProtocolScanner()
+WldProtocolScanner::WldProtocolScanner() : builtin(NULL)
 {
      init();
 }
@@ -66,6 +70,23 @@ bool WldProtocolScanner::openProtocolFile(const std::string &path)
     return result;
 }
 
+bool WldProtocolScanner::openBuiltinProtocol(const std::string &name)
+{
+#ifdef WLD_BUILTIN_PROTOCOLS
+    for (uint32_t i = 0; i < wld_builtin_protocol_count; i++)
+    {
+        if (name == wld_builtin_protocols[i].name)
+        {
+            builtin = &wld_builtin_protocols[i];
+            Logger::getInstance()->log("built in protocol: %s\n", builtin->name);
+            return true;
+        }
+    }
+#endif
+
+    return false;
+}
+
 WldProtocolDefinition *WldProtocolScanner::getProtocolDefinition(WldProtocolDefinition *protocolDef)
 {
     WldProtocolDefinition *prot;
@@ -75,6 +96,19 @@ WldProtocolDefinition *WldProtocolScanner::getProtocolDefinition(WldProtocolDefi
     else
         prot = new WldProtocolDefinition;
 
+    if (builtin)
+    {
+        for (uint32_t i = 0; i < builtin->interface_count; i++)
+        {
+            WldInterface interface;
+            getBuiltinInterface(builtin->interfaces[i], interface);
+            prot->addInterface(interface);
+        }
+        prot->linkInterfaces();
+
+        return prot;
+    }
+
     xml_node protocol = doc.child("protocol");
     xml_attribute attr = protocol.first_attribute();
 
@@ -98,6 +132,7 @@ WldProtocolDefinition *WldProtocolScanner::getProtocolDefinition(WldProtocolDefi
 
         prot->addInterface(interface);
     }
+    prot->linkInterfaces();
 
     return prot;
 }
@@ -113,6 +148,47 @@ bool WldProtocolScanner::scanInterface(const xml_node &node, WldInterface &inter
     return true;
 }
 
+void WldProtocolScanner::getBuiltinInterface(const WldBuiltinInterface &builtinIntf, WldInterface &interface)
+{
+    interface.name = builtinIntf.name;
+    interface.version = builtinIntf.version;
+
+    getBuiltinMessages(builtinIntf.requests, builtinIntf.request_count, interface, WLD_MSG_REQUEST);
+    getBuiltinMessages(builtinIntf.events, builtinIntf.event_count, interface, WLD_MSG_EVENT);
+}
+
+void WldProtocolScanner::getBuiltinMessages(const WldBuiltinMessage *builtinMsgs, uint32_t count,
+                                            WldInterface &interface, WLD_MESSAGE_TYPE type)
+{
+    std::vector<WldMessage> &messages = type == WLD_MSG_REQUEST ? interface.requests : interface.events;
+    messages.resize(count);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const WldBuiltinMessage &builtinMsg = builtinMsgs[i];
+        WldMessage &msg = messages[i];
+        msg.type = type;
+        msg.signature = builtinMsg.name;
+        msg.intf_name = interface.name;
+        msg.destructor = builtinMsg.destructor;
+
+        msg.args.resize(builtinMsg.arg_count);
+        for (uint32_t j = 0; j < builtinMsg.arg_count; j++)
+        {
+            msg.args[j].name = builtinMsg.args[j].name;
+            msg.args[j].type = builtinMsg.args[j].type;
+            if (builtinMsg.args[j].interface)
+                msg.args[j].interface = builtinMsg.args[j].interface;
+        }
+
+        // the program was compiled by the generator already
+        msg.program.ops.assign(builtinMsg.ops, builtinMsg.ops + builtinMsg.op_count);
+        msg.program.fds = builtinMsg.fds;
+        msg.program.min_size = builtinMsg.min_size;
+        msg.action = getAction(msg);
+    }
+}
+
 bool WldProtocolScanner::getMessages(const xml_node &node, WldInterface &interface, WLD_MESSAGE_TYPE type)
 {
     std::string typeStr;
@@ -128,11 +204,14 @@ bool WldProtocolScanner::getMessages(const xml_node &node, WldInterface &interfa
         msg.type = type;
         msg.signature = eventNode.attribute("name").value();
         msg.intf_name = interface.name;
+        msg.destructor = !strcmp(eventNode.attribute("type").value(), "destructor");
 
 //        Logger::getInstance()->log("\t%s: %s\n", type == WLD_MSG_REQUEST ? "request" : "event", msg.signature.c_str());
 
         if (!scanArgs(eventNode, msg))
             return false;
+        msg.action = getAction(msg);
+        compileProgram(msg);
 
         if (type == WLD_MSG_REQUEST)
             interface.requests.push_back(msg);
@@ -143,6 +222,149 @@ bool WldProtocolScanner::getMessages(const xml_node &node, WldInterface &interfa
     return true;
 }
 
+WldMessageAction WldProtocolScanner::getAction(const WldMessage &msg)
+{
+    if (msg.intf_name == "wl_registry")
+    {
+        if (msg.type == WLD_MSG_EVENT && msg.signature == "global")
+            return WLD_ACTION_GLOBAL;
+        if (msg.type == WLD_MSG_REQUEST && msg.signature == "bind")
+            return WLD_ACTION_BIND;
+    }
+
+    if (msg.intf_name == "wl_display" && msg.type == WLD_MSG_EVENT && msg.signature == "delete_id")
+        return WLD_ACTION_DELETE_ID;
+
+    if (msg.destructor || msg.signature == "destroy")
+        return WLD_ACTION_DESTROY;
+
+    std::vector<WldArg>::const_iterator it = msg.args.begin();
+    for (; it != msg.args.end(); it++)
+    {
+        if (it->type == WLD_ARG_NEWID)
+            return WLD_ACTION_NEW_ID;
+    }
+
+    return WLD_ACTION_NONE;
+}
+
+void WldProtocolScanner::compileProgram(WldMessage &msg)
+{
+    WldDecodeProgram &program = msg.program;
+
+    for (uint32_t i = 0; i < msg.args.size(); i++)
+    {
+        const WldArg &arg = msg.args[i];
+        WldDecodeOp op = { WLD_OP_WORDS, 1, i };
+
+        switch (arg.type)
+        {
+        case WLD_ARG_STRING:
+            op.type = WLD_OP_STRING;
+            program.min_size += 4;
+            break;
+        case WLD_ARG_ARRAY:
+            op.type = WLD_OP_ARRAY;
+            program.min_size += 4;
+            break;
+        case WLD_ARG_NEWID:
+            if (arg.interface.empty())
+            {
+                op.type = WLD_OP_DYNAMIC_NEW_ID;
+                program.min_size += 12;
+            }
+            else
+            {
+                op.type = WLD_OP_NEW_ID;
+                program.min_size += 4;
+            }
+            break;
+        case WLD_ARG_FD:
+            op.type = WLD_OP_FD;
+            program.fds++;
+            break;
+        default:
+            program.min_size += 4;
+            break;
+        }
+
+        // consecutive words are read in one go
+        if (op.type == WLD_OP_WORDS && !program.ops.empty() &&
+                program.ops.back().type == WLD_OP_WORDS)
+            program.ops.back().count++;
+        else
+            program.ops.push_back(op);
+    }
+}
+
+int WldMessage::decodeArgs(const char *payload, uint32_t size, WldArgVal *vals) const
+{
+    if (size < program.min_size)
+        return -1;
+
+    const char *p = payload;
+    const char *end = payload + size;
+    int32_t fd = 0;
+
+    std::vector<WldDecodeOp>::const_iterator op = program.ops.begin();
+    for (; op != program.ops.end(); op++)
+    {
+        WldArgVal *val = &vals[op->arg];
+
+        switch (op->type)
+        {
+        case WLD_OP_WORDS:
+            if ((size_t)(end - p) < op->count * 4u)
+                return -1;
+            for (uint32_t i = 0; i < op->count; i++, p += 4)
+                val[i].u = byteArrToUInt32(p);
+            break;
+        case WLD_OP_STRING:
+        case WLD_OP_ARRAY:
+        case WLD_OP_DYNAMIC_NEW_ID:
+        {
+            // both are padded to 32 bits
+            if (end - p < 4)
+                return -1;
+            uint32_t len = byteArrToUInt32(p);
+            p += 4;
+            if ((size_t)(end - p) < ((len + 3) & ~3u))
+                return -1;
+
+            val->s.len = len;
+            val->s.data = len ? p : NULL;
+            p += (len + 3) & ~3u;
+
+            if (op->type == WLD_OP_DYNAMIC_NEW_ID)
+            {
+                if (end - p < 8)
+                    return -1;
+                // the name is looked up as it is, so it has to be terminated
+                const char *interface = len && !val->s.data[len - 1] ? val->s.data : NULL;
+                val->n.version = byteArrToUInt32(p);
+                val->n.id = byteArrToUInt32(p + 4);
+                val->n.interface = interface;
+                p += 8;
+            }
+            break;
+        }
+        case WLD_OP_NEW_ID:
+            if (end - p < 4)
+                return -1;
+            val->n.id = byteArrToUInt32(p);
+            val->n.interface = args[op->arg].interface.c_str();
+            val->n.version = 0;
+            p += 4;
+            break;
+        case WLD_OP_FD:
+            val->h = fd++;
+            break;
+        }
+    }
+
+    return 0;
+}
+
 bool WldProtocolScanner::scanArgs(const xml_node &node, WldMessage &msg)
 {
     for (xml_node argNode = node.child("arg"); argNode; argNode = argNode.next_sibling())
@@ -179,17 +401,56 @@ WldProtocolDefinition::WldProtocolDefinition()
     init();
 }
 
-const WldInterface *WldProtocolDefinition::getInterface(const std::string &name) const
+void WldProtocolDefinition::addInterface(const WldInterface &interface)
 {
-    std::vector<WldInterface>::const_iterator it;
+    interfaceList.push_back(interface);
+    WldInterface &added = interfaceList.back();
+
+    // the first definition wins, as with the list it replaces
+    interfaceNames.insert(names_t::value_type(added.name, &added));
+
+    std::vector<WldMessage> *lists[] = { &added.requests, &added.events };
+    for (int i = 0; i < 2; i++)
+    {
+        for (size_t j = 0; j < lists[i]->size(); j++)
+        {
+            WldMessage &msg = (*lists[i])[j];
+            msg.opcode = j;
+            msg.index = messages.size();
+            messages.push_back(&msg);
+        }
+    }
+}
 
+void WldProtocolDefinition::linkInterfaces()
+{
+    std::deque<WldInterface>::iterator it;
     for (it = interfaceList.begin(); it != interfaceList.end(); it++)
     {
-        if ((*it).name == name)
-            return &(*it);
+        std::vector<WldMessage> *lists[] = { &it->requests, &it->events };
+        for (int i = 0; i < 2; i++)
+        {
+            std::vector<WldMessage>::iterator msg = lists[i]->begin();
+            for (; msg != lists[i]->end(); msg++)
+            {
+                std::vector<WldArg>::iterator arg = msg->args.begin();
+                for (; arg != msg->args.end(); arg++)
+                {
+                    if (arg->type == WLD_ARG_NEWID && !arg->new_intf)
+                        arg->new_intf = getInterface(arg->interface);
+                }
+            }
+        }
     }
+}
+
+const WldInterface *WldProtocolDefinition::getInterface(const std::string &name) const
+{
+    names_t::const_iterator it = interfaceNames.find(name);
+    if (it == interfaceNames.end())
+        return NULL;
 
-    return NULL;
+    return it->second;
 }
 
 size_t WldProtocolDefinition::getArgSize(WldArgType type)
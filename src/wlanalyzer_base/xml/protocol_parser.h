@@ -26,6 +26,7 @@
 #define PROTOCOL_PARSER_H
 
 #include <tr1/unordered_map>
+#include <deque>
 #include <vector>
 #include <pugixml.hpp>
 
@@ -60,34 +61,74 @@ enum WLD_MESSAGE_TYPE
     WLD_MSG_EVENT
 };
 
+// What the analyzer does with a message besides showing it, worked out
+// once when the protocol is loaded
+enum WldMessageAction
+{
+    WLD_ACTION_NONE,
+    WLD_ACTION_GLOBAL,    // wl_registry.global
+    WLD_ACTION_BIND,      // wl_registry.bind
+    WLD_ACTION_DESTROY,   // destructors, or messages named destroy
+    WLD_ACTION_DELETE_ID, // wl_display.delete_id
+    WLD_ACTION_NEW_ID     // has new_id arguments
+};
+
+// A decoded argument, strings and arrays point into the payload
 union WldArgVal
 {
     int32_t i;
     uint32_t u;
     fixed_t f;
-    struct s
+    struct
     {
-        uint32_t len;
+        uint32_t len; // with the terminating 0
         const char *data;
-    };
-//    const char *s;
+    } s;
     uint32_t o;
     struct
     {
         uint32_t id;
         const char *interface;
-//        std::string interface;
+        uint32_t version; // only sent when the interface isn't known upfront
     } n;
-//    uint32_t n;
     struct
     {
         uint32_t size;
         const char *data;
     } a;
-//    const void *a;
-    int32_t h;
+    int32_t h; // index of the fd among those sent with the message
+};
+
+// Steps decoding the arguments of a message, compiled from its signature
+// when the protocol is loaded
+enum WldDecodeOpType
+{
+    WLD_OP_WORDS,       // a run of 32 bit arguments
+    WLD_OP_STRING,
+    WLD_OP_ARRAY,
+    WLD_OP_NEW_ID,
+    WLD_OP_DYNAMIC_NEW_ID, // interface, version and id, as in wl_registry.bind
+    WLD_OP_FD           // not in the payload, sent alongside
+};
+
+struct WldDecodeOp
+{
+    uint16_t type;
+    uint16_t count; // of arguments in a run of words
+    uint32_t arg;   // index of the first argument
+};
+
+struct WldDecodeProgram
+{
+    WldDecodeProgram() : fds(0), min_size(0) {}
+
+    std::vector<WldDecodeOp> ops;
+    uint32_t fds;      // sent with the message
+    uint32_t min_size; // of the payload, with all strings and arrays empty
 };
 
+struct WldInterface;
+
 struct WldArg
 {
     WldArg()
@@ -95,27 +136,78 @@ struct WldArg
         name = "";
         type = WLD_ARG_UNKNOWN;
         interface = "";
+        new_intf = NULL;
     }
 
     std::string name;
     WldArgType type;
     std::string interface;
+    // what a new_id creates, once the protocol defining it is loaded
+    const WldInterface *new_intf;
 };
 
-struct WldInterface;
-
 struct WldMessage
 {
     WldMessage()
     {
         type = WLD_MSG_UNKNOWN;
         signature = "";
+        destructor = false;
+        action = WLD_ACTION_NONE;
+        opcode = 0;
+        index = 0;
     }
 
     std::string intf_name;
     WLD_MESSAGE_TYPE type;
     std::string signature;
+    bool destructor; // type="destructor" in the specification
     std::vector<WldArg> args;
+    WldMessageAction action;
+    WldDecodeProgram program;
+    uint32_t opcode;
+    // among all messages of the protocol definition, for per message tables
+    uint32_t index;
+
+    // Fills vals, one per argument, returns -1 if the payload is too short
+    int decodeArgs(const char *payload, uint32_t size, WldArgVal *vals) const;
+};
+
+// Protocols compiled in at build time by protocol_codegen.py
+struct WldBuiltinArg
+{
+    const char *name;
+    WldArgType type;
+    const char *interface; // of a new_id, NULL if not known upfront
+};
+
+struct WldBuiltinMessage
+{
+    const char *name;
+    const WldBuiltinArg *args;
+    uint32_t arg_count;
+    const WldDecodeOp *ops;
+    uint32_t op_count;
+    uint32_t fds;
+    uint32_t min_size;
+    bool destructor;
+};
+
+struct WldBuiltinInterface
+{
+    const char *name;
+    uint32_t version;
+    const WldBuiltinMessage *requests;
+    uint32_t request_count;
+    const WldBuiltinMessage *events;
+    uint32_t event_count;
+};
+
+struct WldBuiltinProtocol
+{
+    const char *name;
+    const WldBuiltinInterface *interfaces;
+    uint32_t interface_count;
 };
 
 struct WldInterface
@@ -126,24 +218,30 @@ struct WldInterface
     std::vector<WldMessage> events;
 };
 
+// Interfaces are only ever added, and stay where they are: analyzers keep
+// pointers to them rather than copies for every object.
 class WldProtocolDefinition
 {
 public:
     WldProtocolDefinition();
 
-    void addInterface(const WldInterface &interface)
-    {
-        interfaceList.push_back(interface);
-    }
+    void addInterface(const WldInterface &interface);
+    // points the new_id arguments to the interfaces they create
+    void linkInterfaces();
 
     const WldInterface *getInterface(const std::string &name) const;
+    size_t getMessageCount() const { return messages.size(); }
+    const WldMessage *getMessage(size_t index) const { return messages[index]; }
     size_t getArgSize(WldArgType type);
 
 private:
     static void init();
 
 private:
-    std::vector<WldInterface> interfaceList;
+    std::deque<WldInterface> interfaceList;
+    typedef std::tr1::unordered_map<std::string, const WldInterface *> names_t;
+    names_t interfaceNames;
+    std::vector<const WldMessage *> messages;
     typedef std::tr1::unordered_map<WldArgType, size_t, WldArgTypeHasher> type_size_t;
     static type_size_t type_size;
     static bool initialized;
@@ -155,17 +253,25 @@ public:
     WldProtocolScanner();
 
     bool openProtocolFile(const std::string &path);
+    // picks a protocol compiled in by name, returns false if there's none
+    bool openBuiltinProtocol(const std::string &name);
     WldProtocolDefinition *getProtocolDefinition(WldProtocolDefinition *protocolDef = NULL);
 
 private:
     static void init();
 
     bool scanInterface(const pugi::xml_node &node, WldInterface &interface);
+    static void getBuiltinInterface(const WldBuiltinInterface &builtinIntf, WldInterface &interface);
+    static void getBuiltinMessages(const WldBuiltinMessage *builtinMsgs, uint32_t count,
+                                   WldInterface &interface, WLD_MESSAGE_TYPE type);
     bool getMessages(const pugi::xml_node &node, WldInterface &interface, WLD_MESSAGE_TYPE type);
     bool scanArgs(const pugi::xml_node &node, WldMessage &msg);
+    static WldMessageAction getAction(const WldMessage &msg);
+    static void compileProgram(WldMessage &msg);
 
 private:
     pugi::xml_document doc;
+    const WldBuiltinProtocol *builtin;
     typedef std::tr1::unordered_map<std::string, WldArgType> types_t;
     static types_t types;
     static bool initialized;